@@ -0,0 +1,113 @@
+#version 450
+
+layout (location = 0) in vec2 fragNdc;
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invView;
+	vec4 ambientLightColor; // w is intensity
+	uvec4 clusterCount; // xyz light clusters, w point lights
+	vec4 clusterScale;  // xy clusters per pixel, zw scale and bias from log view depth to cluster slice
+} ubo;
+
+struct PointLight
+{
+	vec4 position; // w is the range
+	vec4 color;    // w is intensity
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer
+{
+	PointLight lights[];
+};
+
+// offset into lightIndices and light count of each cluster, written by light_cluster.comp
+layout(std430, set = 0, binding = 2) readonly buffer ClusterBuffer
+{
+	uvec2 clusters[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndexBuffer
+{
+	uint lightIndices[];
+};
+
+// written by gbuffer.frag in the previous subpass
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gBufferAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gBufferNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gBufferDepth;
+
+// set per pipeline variant by LveLightingOptions
+// a nonzero bound gives the light loop a fixed trip count the compiler can unroll, it is only picked while no
+// cluster can hold more lights
+layout(constant_id = 0) const uint LIGHT_LOOP_BOUND = 0;
+layout(constant_id = 1) const bool SPECULAR = true;
+layout(constant_id = 2) const float SPECULAR_EXPONENT = 512.0; // higher value -> sharper highlight
+
+
+void main()
+{
+	float depth = subpassLoad(gBufferDepth).r;
+	if (depth >= 1.0) {
+		discard; // nothing was drawn here, keep the clear color
+	}
+
+	vec3 fragColor = subpassLoad(gBufferAlbedo).rgb;
+	vec3 surfaceNormal = normalize(subpassLoad(gBufferNormal).xyz);
+
+	// view position from depth, the projection is perspective without skew
+	float viewDepth = ubo.projection[3][2] / (depth - ubo.projection[2][2]);
+	vec3 positionView = vec3(
+		fragNdc.x * viewDepth / ubo.projection[0][0],
+		fragNdc.y * viewDepth / ubo.projection[1][1],
+		viewDepth);
+	vec3 fragPosWorld = (ubo.invView * vec4(positionView, 1.0)).xyz;
+
+	vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+	vec3 specularLight = vec3(0.0);
+
+	vec3 cameraPosWorld = ubo.invView[3].xyz;
+	vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
+
+	// the same clusters as the forward path
+	uvec3 cluster = uvec3(
+		uvec2(gl_FragCoord.xy * ubo.clusterScale.xy),
+		uint(max(log(viewDepth) * ubo.clusterScale.z + ubo.clusterScale.w, 0.0)));
+	cluster = min(cluster, ubo.clusterCount.xyz - 1u);
+	uvec2 lightRange = clusters[cluster.x + ubo.clusterCount.x * (cluster.y + ubo.clusterCount.y * cluster.z)];
+
+	uint loopCount = LIGHT_LOOP_BOUND == 0 ? lightRange.y : LIGHT_LOOP_BOUND;
+	for (uint i = 0; i < loopCount; i++)
+	{
+		if (i >= lightRange.y) {
+			break;
+		}
+		PointLight light = lights[lightIndices[lightRange.x + i]];
+		vec3 directionToLight = light.position.xyz - fragPosWorld;
+		float distanceSquared = dot(directionToLight, directionToLight);
+		// distance squared falloff, windowed to reach zero at the light's range
+		float rangeFraction = distanceSquared / (light.position.w * light.position.w);
+		float window = clamp(1.0 - rangeFraction * rangeFraction, 0.0, 1.0);
+		float attenuation = window * window / distanceSquared;
+		directionToLight = normalize(directionToLight);
+		float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
+		vec3 intensity = light.color.xyz * light.color.w * attenuation;
+
+		diffuseLight += intensity * cosAngIncidence;
+
+		// specular lighting
+		if (SPECULAR) {
+			vec3 halfAngle = normalize(directionToLight + viewDirection);
+			float blinnTerm = dot(surfaceNormal, halfAngle);
+			blinnTerm = clamp(blinnTerm, 0, 1);
+			blinnTerm = pow(blinnTerm, SPECULAR_EXPONENT);
+			specularLight += intensity * blinnTerm;
+		}
+	}
+
+	outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 450
+
+// one triangle covering the screen
+const vec2 POSITIONS[3] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2( 3.0, -1.0),
+	vec2(-1.0,  3.0)
+);
+
+layout (location = 0) out vec2 fragNdc;
+
+
+void main()
+{
+	fragNdc = POSITIONS[gl_VertexIndex];
+	gl_Position = vec4(fragNdc, 0.0, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 450
+
+// G-buffer subpass of the deferred path, lighting happens in deferred_lighting.frag
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragPosWorld;
+layout (location = 2) in vec3 fragNormalWorld;
+
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal; // world space, the position is rebuilt from depth
+
+
+void main()
+{
+	outAlbedo = vec4(fragColor, 1.0);
+	outNormal = vec4(normalize(fragNormalWorld), 0.0);
+}
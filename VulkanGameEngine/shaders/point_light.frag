@@ -1,33 +1,20 @@
 #version 450
 
 layout (location = 0) in vec2 fragOffset;
+layout (location = 1) flat in vec4 fragColor;
 
 layout (location = 0) out vec4 outColor;
 
-struct PointLight
-{
-	vec4 position; // ignore w
-	vec4 color;    // w is intensity
-};
-
-const uint MAX_LIGHTS = 10;
-
 layout(set = 0, binding = 0) uniform GlobalUbo
 {
 	mat4 projection;
 	mat4 view;
 	mat4 invView;
 	vec4 ambientLightColor; // w is intensity
-	PointLight pointLights[MAX_LIGHTS];
-	int numLights;
+	uvec4 clusterCount; // xyz light clusters, w point lights
+	vec4 clusterScale;  // xy clusters per pixel, zw scale and bias from log view depth to cluster slice
 } ubo;
 
-layout (push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-} push;
-
 const float M_PI = 3.1415926538;
 
 void main()
@@ -37,7 +24,7 @@ void main()
 	{
 		discard;
 	}
-	// outColor = vec4(push.color.xyz, 1.0);
+	// outColor = vec4(fragColor.xyz, 1.0);
 	float cosDis = 0.5 * (cos(dis * M_PI) + 1.0); // ranges from 1 -> 0
-	outColor = vec4(push.color.xyz + cosDis, cosDis);
+	outColor = vec4(fragColor.xyz + cosDis, cosDis);
 }
@@ -10,14 +10,7 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout (location = 0) out vec2 fragOffset;
-
-struct PointLight
-{
-	vec4 position; // ignore w
-	vec4 color;    // w is intensity
-};
-
-const uint MAX_LIGHTS = 10;
+layout (location = 1) flat out vec4 fragColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo
 {
@@ -25,25 +18,33 @@ layout(set = 0, binding = 0) uniform GlobalUbo
 	mat4 view;
 	mat4 invView;
 	vec4 ambientLightColor; // w is intensity
-	PointLight pointLights[MAX_LIGHTS];
-	int numLights;
+	uvec4 clusterCount; // xyz light clusters, w point lights
+	vec4 clusterScale;  // xy clusters per pixel, zw scale and bias from log view depth to cluster slice
 } ubo;
 
-layout (push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-} push;
+struct Instance
+{
+	vec4 position; // w is the billboard radius
+	vec4 color;    // w is intensity
+};
+
+// written per frame by PointLightSystem, back to front
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer
+{
+	Instance instances[];
+};
 
 
 void main() {
+	Instance instance = instances[gl_InstanceIndex];
 	fragOffset = OFFSETS[gl_VertexIndex];
+	fragColor = instance.color;
 	vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
 	vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-	vec3 positionWorld = push.position.xyz
-		+ push.radius * fragOffset.x * cameraRightWorld
-		+ push.radius * fragOffset.y * cameraUpWorld;
+	vec3 positionWorld = instance.position.xyz
+		+ instance.position.w * fragOffset.x * cameraRightWorld
+		+ instance.position.w * fragOffset.y * cameraUpWorld;
 
 	gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
@@ -6,29 +6,45 @@ layout (location = 2) in vec3 fragNormalWorld;
 
 layout (location = 0) out vec4 outColor;
 
-struct PointLight
-{
-	vec4 position; // ignore w
-	vec4 color;    // w is intensity
-};
-
-const uint MAX_LIGHTS = 10;
-
 layout(set = 0, binding = 0) uniform GlobalUbo
 {
 	mat4 projection;
 	mat4 view;
 	mat4 invView;
 	vec4 ambientLightColor; // w is intensity
-	PointLight pointLights[MAX_LIGHTS];
-	int numLights;
+	uvec4 clusterCount; // xyz light clusters, w point lights
+	vec4 clusterScale;  // xy clusters per pixel, zw scale and bias from log view depth to cluster slice
 } ubo;
 
-layout (push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
-    
+struct PointLight
+{
+	vec4 position; // w is the range
+	vec4 color;    // w is intensity
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer
+{
+	PointLight lights[];
+};
+
+// offset into lightIndices and light count of each cluster, written by light_cluster.comp
+layout(std430, set = 0, binding = 2) readonly buffer ClusterBuffer
+{
+	uvec2 clusters[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndexBuffer
+{
+	uint lightIndices[];
+};
+
+// set per pipeline variant by LveLightingOptions
+// a nonzero bound gives the light loop a fixed trip count the compiler can unroll, it is only picked while no
+// cluster can hold more lights
+layout(constant_id = 0) const uint LIGHT_LOOP_BOUND = 0;
+layout(constant_id = 1) const bool SPECULAR = true;
+layout(constant_id = 2) const float SPECULAR_EXPONENT = 512.0; // higher value -> sharper highlight
+
 
 void main()
 {
@@ -39,23 +55,41 @@ void main()
 	vec3 cameraPosWorld = ubo.invView[3].xyz; // extract camera position in world space from inverse view matrix
 	vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-	for (int i = 0; i < ubo.numLights; i++)
+	// only the lights reaching this fragment's cluster
+	float viewDepth = (ubo.view * vec4(fragPosWorld, 1.0)).z;
+	uvec3 cluster = uvec3(
+		uvec2(gl_FragCoord.xy * ubo.clusterScale.xy),
+		uint(max(log(viewDepth) * ubo.clusterScale.z + ubo.clusterScale.w, 0.0)));
+	cluster = min(cluster, ubo.clusterCount.xyz - 1u);
+	uvec2 lightRange = clusters[cluster.x + ubo.clusterCount.x * (cluster.y + ubo.clusterCount.y * cluster.z)];
+
+	uint loopCount = LIGHT_LOOP_BOUND == 0 ? lightRange.y : LIGHT_LOOP_BOUND;
+	for (uint i = 0; i < loopCount; i++)
 	{
-		PointLight light = ubo.pointLights[i];
+		if (i >= lightRange.y) {
+			break;
+		}
+		PointLight light = lights[lightIndices[lightRange.x + i]];
 		vec3 directionToLight = light.position.xyz - fragPosWorld;
-		float attenuation = 1.0 / dot(directionToLight, directionToLight); // distance squared
+		float distanceSquared = dot(directionToLight, directionToLight);
+		// distance squared falloff, windowed to reach zero at the light's range
+		float rangeFraction = distanceSquared / (light.position.w * light.position.w);
+		float window = clamp(1.0 - rangeFraction * rangeFraction, 0.0, 1.0);
+		float attenuation = window * window / distanceSquared;
 		directionToLight = normalize(directionToLight);
-		float cosAngIncidence = max(dot(surfaceNormal, normalize(directionToLight)), 0);
+		float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
 		vec3 intensity = light.color.xyz * light.color.w * attenuation;
 
 		diffuseLight += intensity * cosAngIncidence;
 
 		// specular lighting
-		vec3 halfAngle = normalize(directionToLight + viewDirection);
-		float blinnTerm = dot(surfaceNormal, halfAngle);
-		blinnTerm = clamp(blinnTerm, 0, 1);
-		blinnTerm = pow(blinnTerm, 512.0); // higher value -> sharper highlight
-		specularLight += intensity * blinnTerm;
+		if (SPECULAR) {
+			vec3 halfAngle = normalize(directionToLight + viewDirection);
+			float blinnTerm = dot(surfaceNormal, halfAngle);
+			blinnTerm = clamp(blinnTerm, 0, 1);
+			blinnTerm = pow(blinnTerm, SPECULAR_EXPONENT);
+			specularLight += intensity * blinnTerm;
+		}
 	}
 
 	outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0);
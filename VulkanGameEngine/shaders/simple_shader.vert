@@ -9,36 +9,44 @@ layout (location = 0) out vec3 fragColor;
 layout (location = 1) out vec3 fragPosWorld;
 layout (location = 2) out vec3 fragNormalWorld;
 
-struct PointLight
-{
-	vec4 position; // ignore w
-	vec4 color;    // w is intensity
-};
-
-const uint MAX_LIGHTS = 10;
-
 layout(set = 0, binding = 0) uniform GlobalUbo
 {
 	mat4 projection;
 	mat4 view;
 	mat4 invView;
 	vec4 ambientLightColor; // w is intensity
-	PointLight pointLights[MAX_LIGHTS];
-	int numLights;
+	uvec4 clusterCount; // xyz light clusters, w point lights
+	vec4 clusterScale;  // xy clusters per pixel, zw scale and bias from log view depth to cluster slice
 } ubo;
 
-layout (push_constant) uniform Push {
+struct Instance
+{
 	mat4 modelMatrix;
 	mat4 normalMatrix;
-} push;
+	vec4 color; // w selects color over the vertex color
+};
+
+// written per frame by SimpleRenderSystem in object order
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer
+{
+	Instance instances[];
+};
+
+// instance indices grouped per draw, firstInstance of each draw points into it
+layout(std430, set = 1, binding = 1) readonly buffer InstanceIndexBuffer
+{
+	uint instanceIndices[];
+};
 
 
 void main()
 {
-	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	Instance instance = instances[instanceIndices[gl_InstanceIndex]];
+
+	vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);
 	gl_Position = ubo.projection * ubo.view * positionWorld;
 
-	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	fragNormalWorld = normalize(mat3(instance.normalMatrix) * normal);
 	fragPosWorld = positionWorld.xyz;
-	fragColor = color;
+	fragColor = mix(color, instance.color.rgb, instance.color.w);
 }
@@ -0,0 +1,61 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+layout (location = 2) in vec2 normalOctahedral;
+layout (location = 3) in vec2 uv;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec3 fragPosWorld;
+layout (location = 2) out vec3 fragNormalWorld;
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invView;
+	vec4 ambientLightColor; // w is intensity
+	uvec4 clusterCount; // xyz light clusters, w point lights
+	vec4 clusterScale;  // xy clusters per pixel, zw scale and bias from log view depth to cluster slice
+} ubo;
+
+struct Instance
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+	vec4 color; // w selects color over the vertex color
+};
+
+// written per frame by SimpleRenderSystem in object order
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer
+{
+	Instance instances[];
+};
+
+// instance indices grouped per draw, firstInstance of each draw points into it
+layout(std430, set = 1, binding = 1) readonly buffer InstanceIndexBuffer
+{
+	uint instanceIndices[];
+};
+
+// Inverse of the octahedral encoding in LveModel::Builder::packVertices
+vec3 octahedralDecode(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+	return normalize(normal);
+}
+
+void main()
+{
+	// position is normalized to the mesh bounds, the model matrix includes LveModel::getPositionDecode()
+	Instance instance = instances[instanceIndices[gl_InstanceIndex]];
+
+	vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
+
+	fragNormalWorld = normalize(mat3(instance.normalMatrix) * octahedralDecode(normalOctahedral));
+	fragPosWorld = positionWorld.xyz;
+	fragColor = mix(color, instance.color.rgb, instance.color.w);
+}
@@ -4,6 +4,10 @@
 #include "lve_camera.hpp"
 #include "lve_buffer.hpp"
 #include "lve_game_object.hpp"
+#include "lve_light_clusters.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_task_graph.hpp"
+#include "systems/deferred_lighting_system.hpp"
 #include "systems/simple_render_system.hpp"
 #include "systems/point_light_system.hpp"
 
@@ -19,15 +23,20 @@
 #include <chrono>
 
 
+// camera movement per frame, the simulation caps its catch up steps instead
 const float MAX_FRAME_TIME = 0.33f;
+const float SIMULATION_STEP = 1.0f / 60.0f;
+const uint32_t MAX_SIMULATION_STEPS = 8;
 
 namespace lve {
 
-	FirstApp::FirstApp()
+	FirstApp::FirstApp(LveRenderPath renderPath)
+		: lveRenderer{ lveWindow, lveDevice, renderPath }
 	{
 		globalPool = LveDescriptorPool::Builder(lveDevice)
 			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
 			.build();
 		loadGameObjects();
 	}
@@ -51,20 +60,54 @@ namespace lve {
 		std::unique_ptr<LveDescriptorSetLayout> globalSetLayout =
 			LveDescriptorSetLayout::Builder(lveDevice)
 			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
 			.build();
 
+		LveLightClusters lightClusters{ lveDevice };
+
 		std::vector<VkDescriptorSet> globalDescriptorSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
 		for (int i = 0; i < globalDescriptorSets.size(); i++)
 		{
 			VkDescriptorBufferInfo bufferInfo = uboBuffers[i]->descriptorInfo();
+			VkDescriptorBufferInfo lightInfo = lightClusters.lightBufferInfo(i);
+			VkDescriptorBufferInfo clusterInfo = lightClusters.clusterBufferInfo(i);
+			VkDescriptorBufferInfo lightIndexInfo = lightClusters.lightIndexBufferInfo(i);
 			LveDescriptorWriter(*globalSetLayout, *globalPool)
 				.writeBuffer(0, &bufferInfo)
+				.writeBuffer(1, &lightInfo)
+				.writeBuffer(2, &clusterInfo)
+				.writeBuffer(3, &lightIndexInfo)
 				.build(globalDescriptorSets[i]);
 		}
 
-		SimpleRenderSystem simpleRenderSystem{ lveDevice, lveRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() };
+		bool deferred = lveRenderer.getRenderPath() == LveRenderPath::Deferred;
+
+		SimpleRenderSystem simpleRenderSystem{
+			lveDevice,
+			lveRenderer.getSwapChainRenderPass(),
+			globalSetLayout->getDescriptorSetLayout(),
+			lveRenderer.getRenderPath() };
+
+		std::unique_ptr<DeferredLightingSystem> lightingSystem;
+		if (deferred) {
+			lightingSystem = std::make_unique<DeferredLightingSystem>(
+				lveDevice,
+				lveRenderer.getSwapChainRenderPass(),
+				lveRenderer.getLightingSubpass(),
+				globalSetLayout->getDescriptorSetLayout(),
+				lveRenderer.getGBufferSetLayout());
+		}
+
+		PointLightSystem pointLightSystem{
+			lveDevice,
+			lveRenderer.getSwapChainRenderPass(),
+			lveRenderer.getLightingSubpass(),
+			globalSetLayout->getDescriptorSetLayout() };
 
-		PointLightSystem pointLightSystem{ lveDevice, lveRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() };
+		// the systems compile their pipelines in the background, all of them at once
+		lveDevice.pipelines().waitIdle();
 
 		LveCamera camera{};
 
@@ -74,6 +117,40 @@ namespace lve {
 		viewerObject.transform.translation.z = -2.5f;
         KeyboardMovementController cameraController{};
 
+		// the scene is simulated in fixed steps whatever the frame rate, and drawn between the last two of them
+		LveFixedTimestep simulationTimestep{ SIMULATION_STEP, MAX_SIMULATION_STEPS };
+
+		// the frame's updates, each system declaring the data it reads and writes so independent ones overlap.
+		// GLFW input may only be read on the main thread, which runs camera control alongside the others.
+		float frameTime = 0.0f;
+		FrameInfo* updateFrame = nullptr;
+		LveComponentPool<TransformComponent>& transforms = entities.pool<TransformComponent>();
+		LveComponentPool<WorldTransformComponent>& worldTransforms = entities.pool<WorldTransformComponent>();
+
+		LveTaskGraph updateGraph{};
+		updateGraph.addMainThreadTask("camera control", [&] {
+			cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), glm::min(frameTime, MAX_FRAME_TIME), viewerObject);
+			camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+
+			float aspect = lveRenderer.getAspectRatio();
+			camera.setPerspectiveProjection(glm::radians(50.0f), aspect, 0.1f, 100.0f);
+		}, {}, { &viewerObject, &camera });
+		updateGraph.addTask("simulation", [&] {
+			// each step sees the step size as its frame time
+			FrameInfo stepInfo = *updateFrame;
+			stepInfo.frameTime = simulationTimestep.getStepSize();
+			uint32_t steps = simulationTimestep.advance(frameTime);
+			transformInterpolator.simulate(steps, simulationTimestep.getAlpha(), [&] {
+				pointLightSystem.update(stepInfo);
+			});
+		}, {}, { &transforms });
+		updateGraph.addTask("light clusters", [&] {
+			pointLightSystem.addToClusters(*updateFrame);
+		}, { &transforms }, { &lightClusters });
+		updateGraph.addTask("scene graph", [&] {
+			sceneGraph.update();
+		}, { &transforms }, { &worldTransforms });
+
         auto currentTime = std::chrono::high_resolution_clock::now();
 
 		while (!lveWindow.shouldClose())
@@ -81,17 +158,9 @@ namespace lve {
 			glfwPollEvents();
 
             auto newTime = std::chrono::high_resolution_clock::now();
-            float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
+            frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
 
-            frameTime = glm::min(frameTime, MAX_FRAME_TIME);
-
-            cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), frameTime, viewerObject);
-            camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
-
-            float aspect = lveRenderer.getAspectRatio();
-            camera.setPerspectiveProjection(glm::radians(50.0f), aspect, 0.1f, 100.0f);
-
 			if (auto commandBuffer = lveRenderer.beginFrame())
 			{
 				int frameIndex = lveRenderer.getFrameIndex();
@@ -102,30 +171,50 @@ namespace lve {
 					commandBuffer,
 					camera,
 					globalDescriptorSets[frameIndex],
-					gameObjects
+					entities
 				};
+				frameInfo.depthPyramid = lveRenderer.getDepthPyramid();
+				frameInfo.lightClusters = &lightClusters;
+				lightClusters.begin(frameIndex);
 
 				// begin offscreen shadow pass
 				// render shadow casting objects
 				// end offscreen shadow pass
 
 				// update
+				updateFrame = &frameInfo;
+				updateGraph.run();
+
 				GlobalUbo ubo{};
 				ubo.projection = camera.getProjection();
 				ubo.view = camera.getView();
 				ubo.inverseView = camera.getInverseView();
-				pointLightSystem.update(frameInfo, ubo);
+				lightClusters.record(commandBuffer, camera, lveRenderer.getSwapChainExtent(), ubo);
 				uboBuffers[frameIndex]->writeToBuffer(&ubo);
 				uboBuffers[frameIndex]->flush();
 
+				// culling runs in compute, outside of the render pass
+				simpleRenderSystem.cullGameObjects(frameInfo);
+
 				// render
-				lveRenderer.beginSwapChainRenderPass(commandBuffer);
+				// the systems record into secondary command buffers on the thread pool
+				lveRenderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				frameInfo.parallelRecorder = &lveRenderer;
 
 				// order here matters
  				simpleRenderSystem.renderGameObjects(frameInfo);
+				if (deferred)
+				{
+					// the G-buffer is complete, light it and draw the light billboards over the result
+					lveRenderer.nextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					frameInfo.gBufferDescriptorSet = lveRenderer.getGBufferDescriptorSet();
+					lightingSystem->render(frameInfo);
+				}
 				pointLightSystem.render(frameInfo);
 
 				lveRenderer.endSwapChainRenderPass(commandBuffer);
+				// next frame's occlusion tests read this frame's depth
+				lveRenderer.buildDepthPyramid(commandBuffer, camera.getProjection() * camera.getView());
 				lveRenderer.endFrame();
 			}
 		}
@@ -136,28 +225,38 @@ namespace lve {
 	void FirstApp::loadGameObjects()
 	{
 		std::shared_ptr<LveModel> lveModel;
+
+		// the vases stand on a node of the scene graph, their transforms are relative to it
+		LveEntity vaseStand = entities.create();
+		entities.add<TransformComponent>(vaseStand).translation = { 0.0f, 0.6f, 0.0f };
+		sceneGraph.attach(vaseStand);
 		
-		lveModel = LveModel::createModelFromFile(lveDevice, "models/flat_vase.obj");
-		auto flatVase = LveGameObject::createGameObject();
-		flatVase.model = lveModel;
-		flatVase.transform.translation = { -0.5f, 0.6f, 0.0f };
-		flatVase.transform.scale = glm::vec3(3.0f);
-        gameObjects.emplace(flatVase.getId(), std::move(flatVase));
-
-		lveModel = LveModel::createModelFromFile(lveDevice, "models/smooth_vase.obj");
-		auto smoothVase = LveGameObject::createGameObject();
-		smoothVase.model = lveModel;
-		smoothVase.transform.translation = { 0.5f, 0.6f, 0.0f };
-		smoothVase.transform.scale = glm::vec3(3.0f);
-		gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
+		lveModel = LveModel::createModelFromFile(lveDevice, "models/flat_vase.obj", LveModel::VertexFormat::PackedSnorm16);
+		LveEntity flatVase = entities.create();
+		entities.add<ModelComponent>(flatVase, lveModel);
+		TransformComponent& flatVaseTransform = entities.add<TransformComponent>(flatVase);
+		flatVaseTransform.translation = { -0.5f, 0.0f, 0.0f };
+		flatVaseTransform.scale = glm::vec3(3.0f);
+		sceneGraph.attach(flatVase, vaseStand);
+
+		lveModel = LveModel::createModelFromFile(lveDevice, "models/smooth_vase.obj", LveModel::VertexFormat::PackedSnorm16);
+		LveEntity smoothVase = entities.create();
+		entities.add<ModelComponent>(smoothVase, lveModel);
+		// adding a transform moves the others, so each is set up before the next is added
+		TransformComponent& smoothVaseTransform = entities.add<TransformComponent>(smoothVase);
+		smoothVaseTransform.translation = { 0.5f, 0.0f, 0.0f };
+		smoothVaseTransform.scale = glm::vec3(3.0f);
+		sceneGraph.attach(smoothVase, vaseStand);
 
 		lveModel = LveModel::createModelFromFile(lveDevice, "models/quad.obj");
-		auto floor = LveGameObject::createGameObject();
-		floor.model = lveModel;
-		floor.transform.translation = { 0.0f, 0.7f, 0.0f };
-		floor.transform.scale = glm::vec3(4.0f);
-		gameObjects.emplace(floor.getId(), std::move(floor));
-
+		LveEntity floor = entities.create();
+		entities.add<ModelComponent>(floor, lveModel);
+		TransformComponent& floorTransform = entities.add<TransformComponent>(floor);
+		floorTransform.translation = { 0.0f, 0.7f, 0.0f };
+		floorTransform.scale = glm::vec3(4.0f);
+		sceneGraph.attach(floor);
+
+		// lights stay out of the graph, PointLightSystem moves and draws them by their own translation
 		std::vector<glm::vec3> lightColors {
 			{ 1.0f, 0.1f, 0.1f },
 			{ 0.1f, 0.1f, 1.0f },
@@ -169,18 +268,16 @@ namespace lve {
 
 		for (int i = 0; i < lightColors.size(); i++)
 		{
-			auto pointLight = LveGameObject::makePointLight(0.2f);
-			pointLight.color = lightColors[i];
+			LveEntity pointLight = createPointLight(entities, 0.2f, 0.1f, lightColors[i]);
 			auto rotateLight = glm::rotate(
 				glm::mat4(1.0f),
 				(i * glm::two_pi<float>()) / lightColors.size(),
 				{ 0.0f, -1.0f, 0.0f}
 			);
-			pointLight.transform.translation = glm::vec3(rotateLight * glm::vec4(-1.0f, -1.0f, -1.0f, 1.0f));
-			gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+			entities.get<TransformComponent>(pointLight).translation =
+				glm::vec3(rotateLight * glm::vec4(-1.0f, -1.0f, -1.0f, 1.0f));
+			transformInterpolator.track(pointLight);
 		}
-
-		// using pointLight again invalid...
 	}
 
 } // namespace lve
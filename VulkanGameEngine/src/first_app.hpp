@@ -1,8 +1,11 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_entity_registry.hpp"
+#include "lve_fixed_timestep.hpp"
 #include "lve_game_object.hpp"
 #include "lve_renderer.hpp"
+#include "lve_scene_graph.hpp"
 #include "lve_window.hpp"
 #include "lve_descriptors.h"
 
@@ -19,7 +22,7 @@ namespace lve {
 		static constexpr int WIDTH = 1280;
 		static constexpr int HEIGHT = 720;
 
-		FirstApp();
+		explicit FirstApp(LveRenderPath renderPath = LveRenderPath::Forward);
 		~FirstApp();
 
 		FirstApp(const FirstApp&) = delete;
@@ -32,11 +35,15 @@ namespace lve {
 
 		LveWindow lveWindow{ WIDTH, HEIGHT, "Vulkan Game Engine" };
 		LveDevice lveDevice{ lveWindow };
-		LveRenderer lveRenderer{ lveWindow, lveDevice };
+		LveRenderer lveRenderer;
 
 		// note: order of declarations matters
 		std::unique_ptr<LveDescriptorPool> globalPool{};
-		LveGameObject::Map gameObjects;
+		LveEntityRegistry entities;
+		// parents of the entities with one, their world matrices are updated each frame
+		LveSceneGraph sceneGraph{ entities };
+		// entities moved by the fixed simulation steps, drawn between their last two steps
+		LveTransformInterpolator transformInterpolator{ entities };
 	};
 
 } // namespace lve
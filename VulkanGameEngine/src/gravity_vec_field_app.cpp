@@ -3,7 +3,9 @@
 #include "systems/simple_render_system.hpp"
 #include "systems/gravity_physics_system.hpp"
 #include "systems/vec2_field_system.hpp"
+#include "lve_fixed_timestep.hpp"
 #include "lve_game_object.hpp"
+#include "lve_task_graph.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -14,8 +16,14 @@
 // std
 #include <stdexcept>
 #include <array>
+#include <chrono>
 
 
+// same step and catch up cap as FirstApp, each step runs GRAVITY_SUBSTEPS gravity substeps
+const float SIMULATION_STEP = 1.0f / 60.0f;
+const uint32_t MAX_SIMULATION_STEPS = 8;
+const unsigned int GRAVITY_SUBSTEPS = 5;
+
 namespace lve {
 
 	GravityVecFieldApp::GravityVecFieldApp()
@@ -81,13 +89,34 @@ namespace lve {
 
 		SimpleRenderSystem simpleRenderSystem{ lveDevice, lveRenderer.getSwapChainRenderPass(), VkDescriptorSetLayout{} };
 
+		// the simulation advances in fixed steps of real time, whatever the frame rate
+		LveFixedTimestep simulationTimestep{ SIMULATION_STEP, MAX_SIMULATION_STEPS };
+		float frameTime = 0.0f;
+
+		// the field reads the bodies the simulation moves, so it waits for it and spreads its lines over the pool
+		LveTaskGraph updateGraph{};
+		updateGraph.addTask("gravity", [&] {
+			uint32_t steps = simulationTimestep.advance(frameTime);
+			for (uint32_t i = 0; i < steps; i++) {
+				gravitySystem.update(physicsObjects, simulationTimestep.getStepSize(), GRAVITY_SUBSTEPS);
+			}
+		}, {}, { &physicsObjects });
+		updateGraph.addTask("vector field", [&] {
+			vecFieldSystem.update(gravitySystem, physicsObjects, vectorField);
+		}, { &physicsObjects }, { &vectorField });
+
+		auto currentTime = std::chrono::high_resolution_clock::now();
+
 		while (!lveWindow.shouldClose()) {
 			glfwPollEvents();
 
+			auto newTime = std::chrono::high_resolution_clock::now();
+			frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
+			currentTime = newTime;
+
 			if (auto commandBuffer = lveRenderer.beginFrame()) {
 
 				int frameIndex = lveRenderer.getFrameIndex();
-				float frameTime = 0.0f; // not used in this implementation
 
 				FrameInfo frameInfo{
 					frameIndex,
@@ -95,17 +124,15 @@ namespace lve {
 					commandBuffer,
 					camera,
 					globalDescriptorSets[frameIndex],
-					gameObjects
+					entities
 				};
 
 				// update systems
-				gravitySystem.update(physicsObjects, 1.f / 60, 5);
-				vecFieldSystem.update(gravitySystem, physicsObjects, vectorField);
+				updateGraph.run();
 
 				// render system
 				lveRenderer.beginSwapChainRenderPass(commandBuffer);
 				simpleRenderSystem.renderGameObjects(frameInfo);
-				simpleRenderSystem.renderGameObjects(frameInfo);
 				lveRenderer.endSwapChainRenderPass(commandBuffer);
 				lveRenderer.endFrame();
 			}
@@ -127,14 +154,13 @@ namespace lve {
 
 		auto lveModel = std::make_shared<LveModel>(lveDevice, modelBuilder);
 
-		auto triangle = LveGameObject::createGameObject();
-		triangle.model = lveModel;
-		triangle.color = { 0.1f, 0.8f, 0.1f };
-		triangle.transform.translation.x = 0.2f;
-		triangle.transform.scale = { 2.0f, 0.5f, 1.0f };
-		triangle.transform.rotation.y = 0.25f * glm::two_pi<float>();
+		LveEntity triangle = entities.create();
+		entities.add<ModelComponent>(triangle, lveModel, glm::vec3{ 0.1f, 0.8f, 0.1f });
 
-		gameObjects.emplace(triangle.getId(), std::move(triangle));
+		TransformComponent& transform = entities.add<TransformComponent>(triangle);
+		transform.translation.x = 0.2f;
+		transform.scale = { 2.0f, 0.5f, 1.0f };
+		transform.rotation.y = 0.25f * glm::two_pi<float>();
 	}
 
 } // namespace lve
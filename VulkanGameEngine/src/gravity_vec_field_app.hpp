@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_entity_registry.hpp"
 #include "lve_game_object.hpp"
 #include "lve_renderer.hpp"
 #include "lve_window.hpp"
@@ -36,7 +37,7 @@ namespace lve {
 
 		// note: order of declarations matters
 		std::unique_ptr<LveDescriptorPool> globalPool{};
-		LveGameObject::Map gameObjects;
+		LveEntityRegistry entities;
 	};
 
 } // namespace lve
@@ -43,39 +43,43 @@ LveBuffer::LveBuffer(
 	memoryPropertyFlags{memoryPropertyFlags} {
 		alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
 		bufferSize = alignmentSize * instanceCount;
-		device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+		device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation);
 }
 
 LveBuffer::~LveBuffer() {
 	unmap();
 	vkDestroyBuffer(lveDevice.device(), buffer, nullptr);
-	vkFreeMemory(lveDevice.device(), memory, nullptr);
+	lveDevice.freeMemory(allocation);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible memory blocks stay mapped by the allocator, so this only offsets into them
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
  *
  * @return VkResult of the buffer mapping call
  */
-VkResult LveBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-	assert(buffer && memory && "Called map on buffer before create");
-	return vkMapMemory(lveDevice.device(), memory, offset, size, 0, &mapped);
+VkResult LveBuffer::map([[maybe_unused]] VkDeviceSize size, VkDeviceSize offset) {
+	assert(buffer && allocation.memory && "Called map on buffer before create");
+	assert((size == VK_WHOLE_SIZE || offset + size <= bufferSize) && "Mapped range is outside of the buffer");
+	if (!allocation.mapped) {
+		return VK_ERROR_MEMORY_MAP_FAILED;
+	}
+	mapped = static_cast<char *>(allocation.mapped) + offset;
+	return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The memory block itself stays mapped until the allocator releases it
  */
 void LveBuffer::unmap() {
-	if (mapped) {
-		vkUnmapMemory(lveDevice.device(), memory);
-		mapped = nullptr;
-	}
+	mapped = nullptr;
 }
 
 /**
@@ -111,12 +115,7 @@ void LveBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset
  * @return VkResult of the flush call
  */
 VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-	VkMappedMemoryRange mappedRange = {};
-	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
-	return vkFlushMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
+	return lveDevice.allocator().flush(allocation, offset, size);
 }
 
 /**
@@ -131,12 +130,7 @@ VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult LveBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-	VkMappedMemoryRange mappedRange = {};
-	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
-	return vkInvalidateMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
+	return lveDevice.allocator().invalidate(allocation, offset, size);
 }
 
 /**
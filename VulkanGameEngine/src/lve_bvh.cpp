@@ -0,0 +1,443 @@
+#include "lve_bvh.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+
+
+namespace lve {
+
+	bool LveAabb::intersectsRay(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance) const
+	{
+		// slabs, an axis the ray runs parallel to gives infinities that still compare correctly
+		glm::vec3 t1 = (min - origin) * invDirection;
+		glm::vec3 t2 = (max - origin) * invDirection;
+		glm::vec3 tNear = glm::min(t1, t2);
+		glm::vec3 tFar = glm::max(t1, t2);
+		float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+		float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+		return enter <= exit;
+	}
+
+	uint32_t LveBvh::insert(const LveAabb& bounds, uint32_t userData)
+	{
+		uint32_t leaf = allocateNode();
+		Node& node = nodes[leaf];
+		node.bounds = { bounds.min - margin, bounds.max + margin };
+		node.userData = userData;
+		node.height = 0;
+
+		insertLeaf(leaf);
+		proxyCount++;
+		return leaf;
+	}
+
+	void LveBvh::remove(uint32_t proxy)
+	{
+		assert(proxy < nodes.size() && nodes[proxy].isLeaf() && "Not a proxy of this tree!");
+
+		removeLeaf(proxy);
+		freeNode(proxy);
+		proxyCount--;
+	}
+
+	bool LveBvh::move(uint32_t proxy, const LveAabb& bounds)
+	{
+		assert(proxy < nodes.size() && nodes[proxy].isLeaf() && "Not a proxy of this tree!");
+
+		if (nodes[proxy].bounds.contains(bounds)) {
+			return false;
+		}
+
+		removeLeaf(proxy);
+		nodes[proxy].bounds = { bounds.min - margin, bounds.max + margin };
+		insertLeaf(proxy);
+		return true;
+	}
+
+	void LveBvh::clear()
+	{
+		nodes.clear();
+		root = NULL_NODE;
+		freeList = NULL_NODE;
+		proxyCount = 0;
+	}
+
+	uint32_t LveBvh::allocateNode()
+	{
+		uint32_t node;
+		if (freeList != NULL_NODE)
+		{
+			node = freeList;
+			freeList = nodes[node].parent;
+			nodes[node] = Node{};
+		}
+		else
+		{
+			node = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+		}
+		return node;
+	}
+
+	void LveBvh::freeNode(uint32_t node)
+	{
+		nodes[node] = Node{};
+		nodes[node].parent = freeList;
+		freeList = node;
+	}
+
+	uint32_t LveBvh::findBestSibling(const LveAabb& bounds)
+	{
+		// Pairing with a node costs the area of the new parent plus the area every ancestor grows by. That growth
+		// only adds up going down, so with the leaf's own area it bounds the cost of the whole subtree from below,
+		// and subtrees that can not beat the best node so far are skipped. Cheapest lower bounds go first.
+		float leafArea = bounds.halfArea();
+
+		uint32_t best = root;
+		float bestCost = LveAabb::merge(nodes[root].bounds, bounds).halfArea();
+
+		// min heap on the inherited cost
+		auto pushCandidate = [this](float inheritedCost, uint32_t node) {
+			siblingCandidates.push_back({ inheritedCost, node });
+			std::push_heap(siblingCandidates.begin(), siblingCandidates.end(), std::greater<SiblingCandidate>{});
+		};
+		siblingCandidates.clear();
+		pushCandidate(0.0f, root);
+
+		while (!siblingCandidates.empty())
+		{
+			std::pop_heap(siblingCandidates.begin(), siblingCandidates.end(), std::greater<SiblingCandidate>{});
+			auto [inheritedCost, node] = siblingCandidates.back();
+			siblingCandidates.pop_back();
+			if (inheritedCost + leafArea >= bestCost) {
+				break;
+			}
+
+			const Node& current = nodes[node];
+			float directCost = LveAabb::merge(current.bounds, bounds).halfArea();
+			float cost = directCost + inheritedCost;
+			if (cost < bestCost)
+			{
+				best = node;
+				bestCost = cost;
+			}
+
+			if (!current.isLeaf())
+			{
+				float childInheritedCost = inheritedCost + directCost - current.bounds.halfArea();
+				if (childInheritedCost + leafArea < bestCost)
+				{
+					pushCandidate(childInheritedCost, current.child1);
+					pushCandidate(childInheritedCost, current.child2);
+				}
+			}
+		}
+
+		return best;
+	}
+
+	void LveBvh::insertLeaf(uint32_t leaf)
+	{
+		if (root == NULL_NODE)
+		{
+			root = leaf;
+			nodes[leaf].parent = NULL_NODE;
+			return;
+		}
+
+		uint32_t sibling = findBestSibling(nodes[leaf].bounds);
+
+		// allocating may move the nodes, so they are only referenced afterwards
+		uint32_t newParent = allocateNode();
+		uint32_t oldParent = nodes[sibling].parent;
+
+		Node& parent = nodes[newParent];
+		parent.parent = oldParent;
+		parent.bounds = LveAabb::merge(nodes[sibling].bounds, nodes[leaf].bounds);
+		parent.height = nodes[sibling].height + 1;
+		parent.child1 = sibling;
+		parent.child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == NULL_NODE) {
+			root = newParent;
+		}
+		else if (nodes[oldParent].child1 == sibling) {
+			nodes[oldParent].child1 = newParent;
+		}
+		else {
+			nodes[oldParent].child2 = newParent;
+		}
+
+		refitAncestors(newParent);
+	}
+
+	void LveBvh::removeLeaf(uint32_t leaf)
+	{
+		if (leaf == root)
+		{
+			root = NULL_NODE;
+			return;
+		}
+
+		uint32_t parent = nodes[leaf].parent;
+		uint32_t grandParent = nodes[parent].parent;
+		uint32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+		// the sibling takes the parent's place
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+		nodes[leaf].parent = NULL_NODE;
+
+		if (grandParent == NULL_NODE)
+		{
+			root = sibling;
+			return;
+		}
+		if (nodes[grandParent].child1 == parent) {
+			nodes[grandParent].child1 = sibling;
+		}
+		else {
+			nodes[grandParent].child2 = sibling;
+		}
+		refitAncestors(grandParent);
+	}
+
+	void LveBvh::refitAncestors(uint32_t node)
+	{
+		while (node != NULL_NODE)
+		{
+			rotate(node);
+
+			Node& current = nodes[node];
+			const Node& child1 = nodes[current.child1];
+			const Node& child2 = nodes[current.child2];
+			current.bounds = LveAabb::merge(child1.bounds, child2.bounds);
+			current.height = 1 + std::max(child1.height, child2.height);
+			node = current.parent;
+		}
+	}
+
+	void LveBvh::rotate(uint32_t node)
+	{
+		// Swapping a child of node with a grandchild under the other child leaves node's bounds as they are, but
+		// changes the bounds of that other child. Of the four swaps the one shrinking it the most is made, if any.
+		uint32_t b = nodes[node].child1;
+		uint32_t c = nodes[node].child2;
+
+		float bestGain = 0.0f;
+		uint32_t moveUp = NULL_NODE;   // grandchild that becomes a child of node
+		uint32_t moveDown = NULL_NODE; // child of node that takes its place
+
+		auto consider = [&](uint32_t child, uint32_t other) {
+			const Node& otherNode = nodes[other];
+			if (otherNode.isLeaf()) {
+				return;
+			}
+			float area = otherNode.bounds.halfArea();
+			// child swaps with one grandchild, the other child's bounds then cover child and the remaining grandchild
+			float gain1 = area - LveAabb::merge(nodes[child].bounds, nodes[otherNode.child2].bounds).halfArea();
+			float gain2 = area - LveAabb::merge(nodes[child].bounds, nodes[otherNode.child1].bounds).halfArea();
+			if (gain1 > bestGain)
+			{
+				bestGain = gain1;
+				moveUp = otherNode.child1;
+				moveDown = child;
+			}
+			if (gain2 > bestGain)
+			{
+				bestGain = gain2;
+				moveUp = otherNode.child2;
+				moveDown = child;
+			}
+		};
+		consider(b, c);
+		consider(c, b);
+
+		if (moveUp == NULL_NODE) {
+			return;
+		}
+
+		uint32_t other = nodes[moveUp].parent;
+		if (nodes[node].child1 == moveDown) {
+			nodes[node].child1 = moveUp;
+		}
+		else {
+			nodes[node].child2 = moveUp;
+		}
+		nodes[moveUp].parent = node;
+
+		Node& otherNode = nodes[other];
+		if (otherNode.child1 == moveUp) {
+			otherNode.child1 = moveDown;
+		}
+		else {
+			otherNode.child2 = moveDown;
+		}
+		nodes[moveDown].parent = other;
+
+		otherNode.bounds = LveAabb::merge(nodes[otherNode.child1].bounds, nodes[otherNode.child2].bounds);
+		otherNode.height = 1 + std::max(nodes[otherNode.child1].height, nodes[otherNode.child2].height);
+	}
+
+	template<typename Test>
+	void LveBvh::query(const Test& test, std::vector<uint32_t>& results) const
+	{
+		if (root == NULL_NODE) {
+			return;
+		}
+
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			Overlap overlap = test(node.bounds);
+			if (overlap == Overlap::Outside) {
+				continue;
+			}
+
+			if (node.isLeaf()) {
+				results.push_back(node.userData);
+			}
+			else if (overlap == Overlap::Inside) {
+				addSubtree(node.child1, results);
+				addSubtree(node.child2, results);
+			}
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+	void LveBvh::addSubtree(uint32_t subtree, std::vector<uint32_t>& results) const
+	{
+		std::vector<uint32_t> stack{ subtree };
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			if (node.isLeaf()) {
+				results.push_back(node.userData);
+			}
+			else
+			{
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+	void LveBvh::queryAabb(const LveAabb& bounds, std::vector<uint32_t>& results) const
+	{
+		query([&](const LveAabb& nodeBounds) {
+			if (!bounds.intersects(nodeBounds)) {
+				return Overlap::Outside;
+			}
+			return bounds.contains(nodeBounds) ? Overlap::Inside : Overlap::Intersecting;
+		}, results);
+	}
+
+	void LveBvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const
+	{
+		query([&](const LveAabb& nodeBounds) {
+			return nodeBounds.intersectsSphere(center, radius) ? Overlap::Intersecting : Overlap::Outside;
+		}, results);
+	}
+
+	void LveBvh::queryFrustum(const LveFrustum& frustum, std::vector<uint32_t>& results) const
+	{
+		query([&](const LveAabb& nodeBounds) {
+			Overlap overlap = Overlap::Inside;
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				// the corners furthest along and against the plane normal
+				glm::vec3 normal{ plane };
+				glm::vec3 positive = glm::mix(nodeBounds.min, nodeBounds.max, glm::greaterThanEqual(normal, glm::vec3{ 0.0f }));
+				glm::vec3 negative = glm::mix(nodeBounds.max, nodeBounds.min, glm::greaterThanEqual(normal, glm::vec3{ 0.0f }));
+				if (glm::dot(normal, positive) + plane.w < 0.0f) {
+					return Overlap::Outside;
+				}
+				if (glm::dot(normal, negative) + plane.w < 0.0f) {
+					overlap = Overlap::Intersecting;
+				}
+			}
+			return overlap;
+		}, results);
+	}
+
+	void LveBvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& results) const
+	{
+		glm::vec3 invDirection = 1.0f / direction;
+		query([&](const LveAabb& nodeBounds) {
+			return nodeBounds.intersectsRay(origin, invDirection, maxDistance) ? Overlap::Intersecting : Overlap::Outside;
+		}, results);
+	}
+
+	float LveBvh::getAreaRatio() const
+	{
+		if (root == NULL_NODE || nodes[root].isLeaf()) {
+			return 0.0f;
+		}
+
+		float area = 0.0f;
+		std::vector<uint32_t> stack{ root };
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			if (node.isLeaf()) continue;
+
+			area += node.bounds.halfArea();
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+		return area / nodes[root].bounds.halfArea();
+	}
+
+	void LveBvh::validate() const
+	{
+		if (root == NULL_NODE)
+		{
+			assert(proxyCount == 0 && "Empty tree with proxies!");
+			return;
+		}
+		assert(nodes[root].parent == NULL_NODE && "Root has a parent!");
+
+		uint32_t leafCount = 0;
+		std::vector<uint32_t> stack{ root };
+		while (!stack.empty())
+		{
+			uint32_t index = stack.back();
+			const Node& node = nodes[index];
+			stack.pop_back();
+
+			if (node.isLeaf())
+			{
+				assert(node.height == 0 && "Leaf with a height!");
+				leafCount++;
+				continue;
+			}
+
+			const Node& child1 = nodes[node.child1];
+			const Node& child2 = nodes[node.child2];
+			assert(child1.parent == index && child2.parent == index && "Child does not point back at its parent!");
+			assert(node.height == 1 + std::max(child1.height, child2.height) && "Height was not refitted!");
+			assert(node.bounds.contains(child1.bounds) && node.bounds.contains(child2.bounds) && "Bounds were not refitted!");
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+		assert(leafCount == proxyCount && "Leaves and proxies differ!");
+	}
+
+} // namespace lve
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "lve_frustum_culler.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+namespace lve {
+
+	// Axis aligned bounding box in world space
+	struct LveAabb
+	{
+		glm::vec3 min{ 0.0f };
+		glm::vec3 max{ 0.0f };
+
+		static LveAabb fromSphere(const glm::vec3& center, float radius) { return { center - radius, center + radius }; }
+		static LveAabb merge(const LveAabb& a, const LveAabb& b) { return { glm::min(a.min, b.min), glm::max(a.max, b.max) }; }
+
+		// the surface area heuristic only compares areas, so half of it will do
+		float halfArea() const
+		{
+			glm::vec3 size = max - min;
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+
+		bool contains(const LveAabb& other) const
+		{
+			return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+		}
+		bool intersects(const LveAabb& other) const
+		{
+			return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+		}
+		bool intersectsSphere(const glm::vec3& center, float radius) const
+		{
+			glm::vec3 offset = glm::clamp(center, min, max) - center;
+			return glm::dot(offset, offset) <= radius * radius;
+		}
+		// invDirection is 1 / direction of the ray, hits between 0 and maxDistance along it count
+		bool intersectsRay(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance) const;
+	};
+
+	// Dynamic bounding volume hierarchy over world space bounds, for scene queries that would otherwise test every
+	// object: frustum, sphere, box and ray.
+	//
+	// Each object is a leaf with bounds enlarged by a margin, so objects moving within it leave the tree as is.
+	// Leaving it reinserts the leaf: the sibling is the one adding the least area to the tree, found with a branch
+	// and bound search over the surface area heuristic, and the ancestors are refitted on the way up with tree
+	// rotations that keep the tree from degrading as objects move around.
+	//
+	// Queries append the user data of the leaves whose enlarged bounds pass the test, so callers test the exact
+	// bounds of the results when they need to. Queries are thread safe, changes to the tree are not.
+	class LveBvh {
+
+	public:
+		static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+		explicit LveBvh(float margin = 0.1f) : margin{ margin } {}
+
+		// returns the proxy of the new leaf, which stays valid until it is removed
+		uint32_t insert(const LveAabb& bounds, uint32_t userData);
+		void remove(uint32_t proxy);
+		// returns true when bounds left the enlarged bounds of the leaf and it was reinserted
+		bool move(uint32_t proxy, const LveAabb& bounds);
+		void clear();
+
+		uint32_t getUserData(uint32_t proxy) const { return nodes[proxy].userData; }
+		const LveAabb& getFatBounds(uint32_t proxy) const { return nodes[proxy].bounds; }
+
+		void queryAabb(const LveAabb& bounds, std::vector<uint32_t>& results) const;
+		void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const;
+		void queryFrustum(const LveFrustum& frustum, std::vector<uint32_t>& results) const;
+		// leaves the ray passes through before maxDistance, in no particular order
+		void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& results) const;
+
+		uint32_t getProxyCount() const { return proxyCount; }
+		// longest path from the root to a leaf, 0 for a single leaf
+		uint32_t getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+		// summed area of the internal nodes, relative to the root's, lower means cheaper queries
+		float getAreaRatio() const;
+		// asserts the structure and bounds are consistent, for debugging
+		void validate() const;
+
+	private:
+		struct Node
+		{
+			LveAabb bounds{};
+			// next free node while the node is free
+			uint32_t parent = NULL_NODE;
+			uint32_t child1 = NULL_NODE;
+			uint32_t child2 = NULL_NODE;
+			uint32_t userData = 0;
+			// leaves are 0
+			uint32_t height = 0;
+
+			bool isLeaf() const { return child1 == NULL_NODE; }
+		};
+
+		uint32_t allocateNode();
+		void freeNode(uint32_t node);
+
+		void insertLeaf(uint32_t leaf);
+		void removeLeaf(uint32_t leaf);
+		uint32_t findBestSibling(const LveAabb& bounds);
+		// refits bounds and heights from node up to the root, rotating where it lowers the area
+		void refitAncestors(uint32_t node);
+		void rotate(uint32_t node);
+
+		enum class Overlap { Outside, Intersecting, Inside };
+
+		// adds the leaves of the nodes test does not find Outside, whole subtrees of the nodes it finds Inside
+		template<typename Test>
+		void query(const Test& test, std::vector<uint32_t>& results) const;
+		void addSubtree(uint32_t node, std::vector<uint32_t>& results) const;
+
+		float margin;
+		std::vector<Node> nodes;
+		// cost inherited from the ancestors and node, the search heap of findBestSibling kept between inserts
+		using SiblingCandidate = std::pair<float, uint32_t>;
+		std::vector<SiblingCandidate> siblingCandidates;
+		uint32_t root = NULL_NODE;
+		uint32_t freeList = NULL_NODE;
+		uint32_t proxyCount = 0;
+	};
+
+} // namespace lve
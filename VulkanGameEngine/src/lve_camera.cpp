@@ -12,6 +12,9 @@ namespace lve {
 		projectionMatrix[3][0] = -(right + left) / (right - left);
 		projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
 		projectionMatrix[3][2] = -near / (far - near);
+		nearPlane = near;
+		farPlane = far;
+		perspective = false;
 	}
 
 	void LveCamera::setPerspectiveProjection(float fovy, float aspect, float near, float far)
@@ -24,6 +27,9 @@ namespace lve {
 		projectionMatrix[2][2] = far / (far - near);
 		projectionMatrix[2][3] = 1.0f;
 		projectionMatrix[3][2] = (far * near) / (far - near);
+		nearPlane = near;
+		farPlane = far;
+		perspective = true;
 	}
 
 	void LveCamera::setViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up)
@@ -25,11 +25,17 @@ namespace lve {
 		const glm::mat4& getView() const { return viewMatrix; };
 		const glm::mat4& getInverseView() const { return inverseViewMatrix; }
 		const glm::vec3 getPosition() const { return glm::vec3(inverseViewMatrix[3]); }
+		float getNear() const { return nearPlane; }
+		float getFar() const { return farPlane; }
+		bool isPerspective() const { return perspective; }
 
 	private:
 		glm::mat4 projectionMatrix{ 1.0f };
 		glm::mat4 viewMatrix{ 1.0f };
 		glm::mat4 inverseViewMatrix{ 1.0f };
+		float nearPlane = 0.0f;
+		float farPlane = 1.0f;
+		bool perspective = false;
 
 	};
 
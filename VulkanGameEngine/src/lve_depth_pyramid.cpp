@@ -0,0 +1,299 @@
+#include "lve_depth_pyramid.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace lve {
+
+	struct DepthPyramidPushConstants
+	{
+		glm::ivec2 inputSize;
+	};
+
+	static constexpr uint32_t GROUP_SIZE = 8;
+
+	LveDepthPyramid::LveDepthPyramid(LveDevice& device, LveSwapChain& swapChain)
+		: lveDevice{ device }, depthExtent{ swapChain.getSwapChainExtent() }
+	{
+		VkFormat depthFormat = swapChain.getDepthFormat();
+		bool hasStencil = depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT;
+		// layout transitions of depth stencil images cover both aspects
+		depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+		for (uint32_t i = 0; i < swapChain.imageCount(); i++) {
+			depthImages.push_back(swapChain.getDepthImage(i));
+		}
+
+		createImage();
+		createSampler();
+		createDescriptorSets(swapChain);
+		createPipeline();
+	}
+
+	LveDepthPyramid::~LveDepthPyramid()
+	{
+		pipeline.reset();
+		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+		vkDestroySampler(lveDevice.device(), sampler, nullptr);
+		for (VkImageView view : levelViews) {
+			vkDestroyImageView(lveDevice.device(), view, nullptr);
+		}
+		vkDestroyImageView(lveDevice.device(), imageView, nullptr);
+		vkDestroyImage(lveDevice.device(), image, nullptr);
+		lveDevice.freeMemory(imageAllocation);
+	}
+
+	void LveDepthPyramid::createImage()
+	{
+		// mip sizes round down, the last texel of a level also covers the odd row or column left over
+		uint32_t width = std::max(1u, depthExtent.width / 2);
+		uint32_t height = std::max(1u, depthExtent.height / 2);
+		levelCount = 1;
+		while ((std::max(width, height) >> levelCount) > 0) {
+			levelCount++;
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = levelCount;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid image view!");
+		}
+
+		levelViews.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			viewInfo.subresourceRange.baseMipLevel = level;
+			viewInfo.subresourceRange.levelCount = 1;
+			if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create depth pyramid level view!");
+			}
+		}
+
+		VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		lveDevice.endSingleTimeCommands(commandBuffer);
+	}
+
+	void LveDepthPyramid::createSampler()
+	{
+		// only read with texelFetch, filtering never applies
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = static_cast<float>(levelCount);
+
+		if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid sampler!");
+		}
+	}
+
+	void LveDepthPyramid::createDescriptorSets(LveSwapChain& swapChain)
+	{
+		uint32_t setCount = static_cast<uint32_t>(depthImages.size()) + levelCount - 1;
+
+		setLayout = LveDescriptorSetLayout::Builder(lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		descriptorPool = LveDescriptorPool::Builder(lveDevice)
+			.setMaxSets(setCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount)
+			.build();
+
+		VkDescriptorImageInfo outputInfo{ VK_NULL_HANDLE, levelViews[0], VK_IMAGE_LAYOUT_GENERAL };
+
+		depthDescriptorSets.resize(depthImages.size());
+		for (uint32_t i = 0; i < depthImages.size(); i++)
+		{
+			VkDescriptorImageInfo inputInfo{ sampler, swapChain.getDepthImageView(i), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			LveDescriptorWriter(*setLayout, *descriptorPool)
+				.writeImage(0, &inputInfo)
+				.writeImage(1, &outputInfo)
+				.build(depthDescriptorSets[i]);
+		}
+
+		levelDescriptorSets.resize(levelCount);
+		for (uint32_t level = 1; level < levelCount; level++)
+		{
+			VkDescriptorImageInfo inputInfo{ sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			outputInfo.imageView = levelViews[level];
+			LveDescriptorWriter(*setLayout, *descriptorPool)
+				.writeImage(0, &inputInfo)
+				.writeImage(1, &outputInfo)
+				.build(levelDescriptorSets[level]);
+		}
+	}
+
+	void LveDepthPyramid::createPipeline()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DepthPyramidPushConstants);
+
+		VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid pipeline layout!");
+		}
+
+		pipeline = std::make_unique<LveComputePipeline>(lveDevice, "shaders/depth_pyramid.comp.spv", pipelineLayout);
+	}
+
+	VkDescriptorImageInfo LveDepthPyramid::descriptorInfo() const
+	{
+		return { sampler, imageView, VK_IMAGE_LAYOUT_GENERAL };
+	}
+
+	void LveDepthPyramid::build(VkCommandBuffer commandBuffer, uint32_t imageIndex, const glm::mat4& cameraViewProjection)
+	{
+		VkImageMemoryBarrier depthBarrier{};
+		depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.image = depthImages[imageIndex];
+		depthBarrier.subresourceRange = { depthAspect, 0, 1, 0, 1 };
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		// the compute stage also waits for this frame's culling, which still read the previous pyramid
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &depthBarrier);
+
+		pipeline->bind(commandBuffer);
+
+		VkMemoryBarrier levelBarrier{};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		DepthPyramidPushConstants push{};
+		push.inputSize = { depthExtent.width, depthExtent.height };
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			VkDescriptorSet descriptorSet = level == 0 ? depthDescriptorSets[imageIndex] : levelDescriptorSets[level];
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineLayout,
+				0,
+				1,
+				&descriptorSet,
+				0,
+				nullptr);
+
+			glm::ivec2 outputSize = glm::max(push.inputSize / 2, glm::ivec2{ 1 });
+			vkCmdPushConstants(
+				commandBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				0,
+				sizeof(DepthPyramidPushConstants),
+				&push);
+			vkCmdDispatch(
+				commandBuffer,
+				(outputSize.x + GROUP_SIZE - 1) / GROUP_SIZE,
+				(outputSize.y + GROUP_SIZE - 1) / GROUP_SIZE,
+				1);
+
+			// the last barrier makes the pyramid visible to the next frame's culling
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0,
+				1, &levelBarrier,
+				0, nullptr,
+				0, nullptr);
+
+			push.inputSize = outputSize;
+		}
+
+		// back for the next render pass using this attachment, which must not clear it while we still read
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.srcAccessMask = 0;
+		depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &depthBarrier);
+
+		viewProjection = cameraViewProjection;
+		valid = true;
+	}
+
+} // namespace lve
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "lve_descriptors.h"
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_swap_chain.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+
+namespace lve {
+
+	// Hierarchical depth buffer for occlusion culling. Each level holds the farthest depth of 2x2 texels of the
+	// level above, level 0 is half the resolution of the swap chain's depth attachment. It is rebuilt from the depth
+	// of each finished frame and sampled by the next one, and stays in VK_IMAGE_LAYOUT_GENERAL.
+	class LveDepthPyramid {
+
+	public:
+		LveDepthPyramid(LveDevice& device, LveSwapChain& swapChain);
+		~LveDepthPyramid();
+
+		LveDepthPyramid(const LveDepthPyramid&) = delete;
+		LveDepthPyramid& operator=(const LveDepthPyramid&) = delete;
+
+		// records the reduction of the depth attachment of imageIndex, after the render pass that wrote it has ended
+		void build(VkCommandBuffer commandBuffer, uint32_t imageIndex, const glm::mat4& viewProjection);
+
+		// false until the first build, there is nothing to test against before
+		bool isValid() const { return valid; }
+		// camera the depth was rendered with
+		const glm::mat4& getViewProjection() const { return viewProjection; }
+		VkExtent2D getDepthExtent() const { return depthExtent; }
+		uint32_t getLevelCount() const { return levelCount; }
+		// all levels, for texelFetch from compute shaders
+		VkDescriptorImageInfo descriptorInfo() const;
+
+	private:
+		void createImage();
+		void createSampler();
+		void createDescriptorSets(LveSwapChain& swapChain);
+		void createPipeline();
+
+		LveDevice& lveDevice;
+
+		VkExtent2D depthExtent;
+		VkImageAspectFlags depthAspect;
+		std::vector<VkImage> depthImages;
+
+		uint32_t levelCount;
+		VkImage image;
+		LveAllocation imageAllocation;
+		VkImageView imageView;
+		std::vector<VkImageView> levelViews;
+		VkSampler sampler;
+
+		std::unique_ptr<LveDescriptorSetLayout> setLayout;
+		std::unique_ptr<LveDescriptorPool> descriptorPool;
+		// level 0 reads the depth attachment of each swap chain image, level i reads level i - 1
+		std::vector<VkDescriptorSet> depthDescriptorSets;
+		std::vector<VkDescriptorSet> levelDescriptorSets;
+
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<LveComputePipeline> pipeline;
+
+		glm::mat4 viewProjection{ 1.0f };
+		bool valid = false;
+	};
+
+} // namespace lve
@@ -1,6 +1,10 @@
 #include "lve_device.hpp"
+#include "lve_geometry_buffer.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_upload_queue.hpp"
 
 // std headers
+#include <cassert>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -54,9 +58,20 @@ LveDevice::LveDevice(LveWindow &window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  allocator_ = std::make_unique<LveMemoryAllocator>(physicalDevice, device_);
+  uploadQueue_ = std::make_unique<LveUploadQueue>(*this);
+  geometry_ = std::make_unique<LveGeometryBuffer>(*this);
+  pipelineCache_ = std::make_unique<LvePipelineCache>(device_, properties, "pipeline_cache.bin");
+  pipelines_ = std::make_unique<LvePipelineRegistry>(*this);
 }
 
 LveDevice::~LveDevice() {
+  // finishes background compiles, then the cache is saved to disk with every pipeline in it
+  pipelines_.reset();
+  pipelineCache_.reset();
+  uploadQueue_.reset();
+  geometry_.reset();
+  allocator_.reset();
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -138,6 +153,9 @@ void LveDevice::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  if (indices.transferFamilyHasValue) {
+    uniqueQueueFamilies.insert(indices.transferFamily);
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -149,8 +167,21 @@ void LveDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // optional, GPU driven draws need them and fall back to CPU culling without
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+  enabledFeatures_ = deviceFeatures;
+
+  std::vector<const char *> enabledExtensions = deviceExtensions;
+  bool drawIndirectCount = checkDeviceExtensionSupport(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  if (drawIndirectCount) {
+    enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -159,8 +190,8 @@ void LveDevice::createLogicalDevice() {
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -177,6 +208,20 @@ void LveDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+  if (drawIndirectCount) {
+    cmdDrawIndexedIndirectCount_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+
+  graphicsQueueFamily_ = indices.graphicsFamily;
+  if (indices.transferFamilyHasValue) {
+    transferQueueFamily_ = indices.transferFamily;
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+  } else {
+    transferQueueFamily_ = indices.graphicsFamily;
+    transferQueue_ = graphicsQueue_;
+  }
 }
 
 void LveDevice::createCommandPool() {
@@ -318,6 +363,38 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LveDevice::cmdDrawIndexedIndirectCount(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkBuffer countBuffer,
+    VkDeviceSize countBufferOffset,
+    uint32_t maxDrawCount,
+    uint32_t stride) {
+  assert(cmdDrawIndexedIndirectCount_ != nullptr && "VK_KHR_draw_indirect_count is not enabled!");
+  cmdDrawIndexedIndirectCount_(
+      commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+}
+
 QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -346,6 +423,17 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // a transfer only family maps to the copy engines, which run beside the graphics work
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      indices.transferFamily = family;
+      indices.transferFamilyHasValue = true;
+      break;
+    }
+  }
+
   return indices;
 }
 
@@ -404,18 +492,38 @@ uint32_t LveDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags pr
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool LveDevice::hasMemoryType(VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void LveDevice::createBuffer(
     VkDeviceSize size,
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    LveAllocation &bufferAllocation) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+  // buffers written by the transfer queue are shared with the graphics family
+  // instead of transferring queue family ownership after every upload
+  uint32_t queueFamilies[] = {graphicsQueueFamily_, transferQueueFamily_};
+  if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && graphicsQueueFamily_ != transferQueueFamily_) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = queueFamilies;
+  }
+
   if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to create vertex buffer!");
   }
@@ -423,16 +531,11 @@ void LveDevice::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferAllocation = allocator_->allocate(memRequirements, properties, false);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  if (vkBindBufferMemory(device_, buffer, bufferAllocation.memory, bufferAllocation.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind buffer memory!");
   }
-
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
 
 VkCommandBuffer LveDevice::beginSingleTimeCommands() {
@@ -510,7 +613,7 @@ void LveDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    LveAllocation &imageAllocation) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
@@ -518,16 +621,12 @@ void LveDevice::createImageWithInfo(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
+  imageAllocation = allocator_->allocate(
+      memRequirements,
+      properties,
+      imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL);
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+  if (vkBindImageMemory(device_, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
     throw std::runtime_error("failed to bind image memory!");
   }
 }
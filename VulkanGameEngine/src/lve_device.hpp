@@ -1,13 +1,20 @@
 #pragma once
 
+#include "lve_memory_allocator.hpp"
+#include "lve_pipeline_cache.hpp"
 #include "lve_window.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+class LveGeometryBuffer;
+class LvePipelineRegistry;
+class LveUploadQueue;
+
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +24,10 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool transferFamilyHasValue = false;  // optional, transfers fall back to the graphics queue
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -44,22 +53,47 @@ class LveDevice {
     VkSurfaceKHR surface() { return surface_; }
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentQueue() { return presentQueue_; }
+    VkQueue transferQueue() { return transferQueue_; }
+    uint32_t transferQueueFamily() { return transferQueueFamily_; }
+    LveMemoryAllocator &allocator() { return *allocator_; }
+    LveUploadQueue &uploadQueue() { return *uploadQueue_; }
+    LveGeometryBuffer &geometry() { return *geometry_; }
+    // every pipeline is created with it, persisted between runs
+    LvePipelineCache &pipelineCache() { return *pipelineCache_; }
+    // shared pipelines and shader modules, LvePipeline and LveComputePipeline come from here
+    LvePipelineRegistry &pipelines() { return *pipelines_; }
+    const VkPhysicalDeviceFeatures &enabledFeatures() { return enabledFeatures_; }
+
+    // VK_KHR_draw_indirect_count is enabled when the device has it, the draw count is then read from a buffer
+    bool supportsDrawIndirectCount() { return cmdDrawIndexedIndirectCount_ != nullptr; }
+    void cmdDrawIndexedIndirectCount(
+        VkCommandBuffer commandBuffer,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkBuffer countBuffer,
+        VkDeviceSize countBufferOffset,
+        uint32_t maxDrawCount,
+        uint32_t stride);
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    // true when some memory type has all of properties, e.g. lazily allocated memory on tile based GPUs
+    bool hasMemoryType(VkMemoryPropertyFlags properties);
     QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
     VkFormat findSupportedFormat(
         const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
     // Buffer Helper Functions
+    // buffers and images are sub-allocated, release their memory with freeMemory
     void createBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory);
+        LveAllocation &bufferAllocation);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+    // blocks until the copy finished, prefer uploadQueue() for streaming data
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     void copyBufferToImage(
         VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
@@ -68,7 +102,8 @@ class LveDevice {
         const VkImageCreateInfo &imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage &image,
-        VkDeviceMemory &imageMemory);
+        LveAllocation &imageAllocation);
+    void freeMemory(LveAllocation &allocation) { allocator_->free(allocation); }
 
     VkPhysicalDeviceProperties properties;
 
@@ -88,6 +123,7 @@ class LveDevice {
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool checkDeviceExtensionSupport(VkPhysicalDevice device, const char *extensionName);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
@@ -100,6 +136,16 @@ class LveDevice {
         VkSurfaceKHR surface_;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        VkQueue transferQueue_;
+        uint32_t graphicsQueueFamily_;
+        uint32_t transferQueueFamily_;
+        std::unique_ptr<LveMemoryAllocator> allocator_;
+        std::unique_ptr<LveUploadQueue> uploadQueue_;
+        std::unique_ptr<LveGeometryBuffer> geometry_;
+        std::unique_ptr<LvePipelineCache> pipelineCache_;
+        std::unique_ptr<LvePipelineRegistry> pipelines_;
+        VkPhysicalDeviceFeatures enabledFeatures_{};
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount_ = nullptr;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
         const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
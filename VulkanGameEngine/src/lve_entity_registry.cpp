@@ -0,0 +1,47 @@
+#include "lve_entity_registry.hpp"
+
+// std
+#include <atomic>
+
+
+namespace lve {
+
+	LveEntity LveEntityRegistry::create()
+	{
+		entityCount++;
+
+		if (!freeIndices.empty())
+		{
+			uint32_t index = freeIndices.back();
+			freeIndices.pop_back();
+			return LveEntity{ index, generations[index] };
+		}
+
+		generations.push_back(0);
+		return LveEntity{ static_cast<uint32_t>(generations.size() - 1), 0 };
+	}
+
+	void LveEntityRegistry::destroy(LveEntity entity)
+	{
+		assert(isAlive(entity) && "Entity was already destroyed!");
+
+		for (auto& components : pools)
+		{
+			if (components != nullptr && components->contains(entity.index)) {
+				components->remove(entity.index);
+			}
+		}
+
+		// handles to the old generation no longer match
+		generations[entity.index]++;
+		freeIndices.push_back(entity.index);
+		entityCount--;
+	}
+
+	uint32_t LveEntityRegistry::nextComponentId()
+	{
+		static std::atomic<uint32_t> nextId{ 0 };
+		return nextId.fetch_add(1, std::memory_order_relaxed);
+	}
+
+} // namespace lve
@@ -0,0 +1,247 @@
+#pragma once
+
+// std
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace lve {
+
+	// Handle of an entity in an LveEntityRegistry. Indices of destroyed entities are reused with the next
+	// generation, so a stale handle is told apart from the entity that took its index.
+	struct LveEntity
+	{
+		static constexpr uint32_t NULL_INDEX = UINT32_MAX;
+
+		uint32_t index = NULL_INDEX;
+		uint32_t generation = 0;
+
+		bool isNull() const { return index == NULL_INDEX; }
+		bool operator==(const LveEntity& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const LveEntity& other) const { return !(*this == other); }
+	};
+
+	// Components of one type as a sparse set: the components and their entity indices in dense arrays, and an array
+	// from entity index to dense position. Lookup, add and remove are O(1), removing moves the last component into
+	// the gap so the arrays stay packed.
+	class LveComponentPoolBase {
+
+	public:
+		virtual ~LveComponentPoolBase() = default;
+
+		bool contains(uint32_t entityIndex) const
+		{
+			return entityIndex < sparse.size() && sparse[entityIndex] != NOT_PRESENT;
+		}
+		uint32_t size() const { return static_cast<uint32_t>(entities.size()); }
+		// entity index of each component, in the order of the components
+		const std::vector<uint32_t>& getEntities() const { return entities; }
+
+		virtual void remove(uint32_t entityIndex) = 0;
+
+	protected:
+		static constexpr uint32_t NOT_PRESENT = UINT32_MAX;
+
+		std::vector<uint32_t> sparse;
+		std::vector<uint32_t> entities;
+	};
+
+	template<typename T>
+	class LveComponentPool : public LveComponentPoolBase {
+
+	public:
+		template<typename... Args>
+		T& add(uint32_t entityIndex, Args&&... args)
+		{
+			assert(!contains(entityIndex) && "Entity already has this component!");
+
+			if (entityIndex >= sparse.size()) {
+				sparse.resize(entityIndex + 1, NOT_PRESENT);
+			}
+			sparse[entityIndex] = size();
+			entities.push_back(entityIndex);
+			// aggregates like most components are brace initialized from the arguments
+			if constexpr (std::is_constructible<T, Args...>::value) {
+				components.emplace_back(std::forward<Args>(args)...);
+			}
+			else {
+				components.push_back(T{ std::forward<Args>(args)... });
+			}
+			return components.back();
+		}
+
+		void remove(uint32_t entityIndex) override
+		{
+			assert(contains(entityIndex) && "Entity does not have this component!");
+
+			uint32_t position = sparse[entityIndex];
+			uint32_t last = size() - 1;
+			if (position != last)
+			{
+				components[position] = std::move(components[last]);
+				entities[position] = entities[last];
+				sparse[entities[position]] = position;
+			}
+			components.pop_back();
+			entities.pop_back();
+			sparse[entityIndex] = NOT_PRESENT;
+		}
+
+		T& get(uint32_t entityIndex)
+		{
+			assert(contains(entityIndex) && "Entity does not have this component!");
+			return components[sparse[entityIndex]];
+		}
+
+		T* tryGet(uint32_t entityIndex)
+		{
+			return contains(entityIndex) ? &components[sparse[entityIndex]] : nullptr;
+		}
+
+		// packed, components[i] belongs to getEntities()[i]
+		std::vector<T>& getComponents() { return components; }
+
+	private:
+		std::vector<T> components;
+	};
+
+	// Entities and their components, each component type in its own LveComponentPool. Systems query the entities
+	// having a set of components with each(), which walks only the smallest of the pools, or iterate a pool's
+	// dense arrays directly.
+	//
+	// Adding or removing components of a type moves that type's components, so references to them are only valid
+	// until then. Not thread safe, though components of different entities can be written from different threads.
+	class LveEntityRegistry {
+
+	public:
+		LveEntityRegistry() = default;
+
+		LveEntityRegistry(const LveEntityRegistry&) = delete;
+		LveEntityRegistry& operator=(const LveEntityRegistry&) = delete;
+
+		LveEntity create();
+		// removes the entity's components, its handles become stale
+		void destroy(LveEntity entity);
+		bool isAlive(LveEntity entity) const
+		{
+			return entity.index < generations.size() && generations[entity.index] == entity.generation;
+		}
+		uint32_t getEntityCount() const { return entityCount; }
+		// handle of the live entity at index, for the entity indices of a pool
+		LveEntity getEntity(uint32_t index) const { return LveEntity{ index, generations[index] }; }
+
+		template<typename T, typename... Args>
+		T& add(LveEntity entity, Args&&... args)
+		{
+			assert(isAlive(entity) && "Adding a component to a destroyed entity!");
+			return pool<T>().add(entity.index, std::forward<Args>(args)...);
+		}
+
+		template<typename T>
+		void remove(LveEntity entity)
+		{
+			assert(isAlive(entity) && "Removing a component of a destroyed entity!");
+			pool<T>().remove(entity.index);
+		}
+
+		template<typename T>
+		bool has(LveEntity entity) const
+		{
+			const LveComponentPoolBase* components = findPool<T>();
+			return isAlive(entity) && components != nullptr && components->contains(entity.index);
+		}
+
+		template<typename T>
+		T& get(LveEntity entity)
+		{
+			assert(isAlive(entity) && "Getting a component of a destroyed entity!");
+			return pool<T>().get(entity.index);
+		}
+
+		// null when the entity is destroyed or lacks the component
+		template<typename T>
+		T* tryGet(LveEntity entity)
+		{
+			LveComponentPool<T>* components = findPool<T>();
+			return isAlive(entity) && components != nullptr ? components->tryGet(entity.index) : nullptr;
+		}
+
+		// every component of type T, created empty on first use
+		template<typename T>
+		LveComponentPool<T>& pool()
+		{
+			uint32_t id = componentId<T>();
+			if (id >= pools.size()) {
+				pools.resize(id + 1);
+			}
+			if (pools[id] == nullptr) {
+				pools[id] = std::make_unique<LveComponentPool<T>>();
+			}
+			return static_cast<LveComponentPool<T>&>(*pools[id]);
+		}
+
+		// calls fn(entity, components...) for each entity having all of Ts, in the order of the smallest pool.
+		// fn must not add or remove components of Ts.
+		template<typename... Ts, typename Fn>
+		void each(Fn&& fn)
+		{
+			static_assert(sizeof...(Ts) > 0, "Queries need at least one component type");
+
+			std::tuple<LveComponentPool<Ts>*...> queried{ findPool<Ts>()... };
+			std::array<LveComponentPoolBase*, sizeof...(Ts)> candidates{ std::get<LveComponentPool<Ts>*>(queried)... };
+			LveComponentPoolBase* smallest = nullptr;
+			for (LveComponentPoolBase* components : candidates)
+			{
+				// a type no entity ever had matches nothing
+				if (components == nullptr) {
+					return;
+				}
+				if (smallest == nullptr || components->size() < smallest->size()) {
+					smallest = components;
+				}
+			}
+
+			const std::vector<uint32_t>& entities = smallest->getEntities();
+			for (size_t i = 0; i < entities.size(); i++)
+			{
+				uint32_t index = entities[i];
+				if ((std::get<LveComponentPool<Ts>*>(queried)->contains(index) && ...)) {
+					fn(getEntity(index), std::get<LveComponentPool<Ts>*>(queried)->get(index)...);
+				}
+			}
+		}
+
+	private:
+		static uint32_t nextComponentId();
+
+		// dense ids of the component types, in the order they were first used
+		template<typename T>
+		static uint32_t componentId()
+		{
+			static const uint32_t id = nextComponentId();
+			return id;
+		}
+
+		template<typename T>
+		LveComponentPool<T>* findPool() const
+		{
+			uint32_t id = componentId<T>();
+			return id < pools.size() ? static_cast<LveComponentPool<T>*>(pools[id].get()) : nullptr;
+		}
+
+		// by component id, null for types never added to this registry
+		std::vector<std::unique_ptr<LveComponentPoolBase>> pools;
+
+		// current generation of each entity index, and the indices of destroyed entities to reuse
+		std::vector<uint32_t> generations;
+		std::vector<uint32_t> freeIndices;
+		uint32_t entityCount = 0;
+	};
+
+} // namespace lve
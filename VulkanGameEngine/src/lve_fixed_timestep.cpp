@@ -0,0 +1,119 @@
+#include "lve_fixed_timestep.hpp"
+
+#include "lve_game_object.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+namespace lve {
+
+	LveFixedTimestep::LveFixedTimestep(float stepSize, uint32_t maxStepsPerFrame)
+		: stepSize{ stepSize }, maxStepsPerFrame{ maxStepsPerFrame }
+	{
+		assert(stepSize > 0.0f && maxStepsPerFrame > 0 && "Fixed timesteps need a positive step size and step count!");
+	}
+
+	uint32_t LveFixedTimestep::advance(float frameTime)
+	{
+		accumulator += std::max(frameTime, 0.0f);
+
+		float available = std::floor(accumulator / stepSize);
+		uint32_t steps = maxStepsPerFrame;
+		if (available > static_cast<float>(maxStepsPerFrame))
+		{
+			// keep the fraction of a step, so rendering stays as far between the states as it was
+			float dropped = (available - static_cast<float>(maxStepsPerFrame)) * stepSize;
+			droppedTime += dropped;
+			accumulator -= dropped;
+		}
+		else {
+			steps = static_cast<uint32_t>(available);
+		}
+
+		// rounding can leave the remainder a hair outside of a step
+		accumulator = glm::clamp(accumulator - static_cast<float>(steps) * stepSize, 0.0f, stepSize);
+		stepCount += steps;
+		return steps;
+	}
+
+	void LveTransformInterpolator::track(LveEntity entity)
+	{
+		const TransformComponent& transform = registry.get<TransformComponent>(entity);
+		registry.add<InterpolatedTransformComponent>(entity, InterpolatedTransformComponent{
+			transform.translation,
+			transform.scale,
+			transform.rotation,
+			transform.translation,
+			transform.scale,
+			transform.rotation });
+	}
+
+	void LveTransformInterpolator::simulate(uint32_t stepCount, float alpha, const std::function<void()>& step)
+	{
+		if (stepCount > 0)
+		{
+			restore();
+			for (uint32_t i = 0; i < stepCount; i++)
+			{
+				// only the state before the last step is blended from
+				if (i + 1 == stepCount) {
+					keepPrevious();
+				}
+				step();
+			}
+			keepCurrent();
+		}
+		interpolate(alpha);
+	}
+
+	void LveTransformInterpolator::restore()
+	{
+		registry.each<InterpolatedTransformComponent, TransformComponent>(
+			[](LveEntity, InterpolatedTransformComponent& states, TransformComponent& transform) {
+				transform.translation = states.translation;
+				transform.scale = states.scale;
+				transform.rotation = states.rotation;
+			});
+	}
+
+	void LveTransformInterpolator::keepPrevious()
+	{
+		registry.each<InterpolatedTransformComponent, TransformComponent>(
+			[](LveEntity, InterpolatedTransformComponent& states, TransformComponent& transform) {
+				states.previousTranslation = transform.translation;
+				states.previousScale = transform.scale;
+				states.previousRotation = transform.rotation;
+			});
+	}
+
+	void LveTransformInterpolator::keepCurrent()
+	{
+		registry.each<InterpolatedTransformComponent, TransformComponent>(
+			[](LveEntity, InterpolatedTransformComponent& states, TransformComponent& transform) {
+				states.translation = transform.translation;
+				states.scale = transform.scale;
+				states.rotation = transform.rotation;
+			});
+	}
+
+	void LveTransformInterpolator::interpolate(float alpha)
+	{
+		registry.each<InterpolatedTransformComponent, TransformComponent>(
+			[alpha](LveEntity, InterpolatedTransformComponent& states, TransformComponent& transform) {
+				// angles the long way round, like atan2 flipping from pi to -pi, turn the short way instead
+				glm::vec3 turn = states.rotation - states.previousRotation;
+				turn -= glm::two_pi<float>() * glm::round(turn / glm::two_pi<float>());
+
+				transform.translation = glm::mix(states.previousTranslation, states.translation, alpha);
+				transform.scale = glm::mix(states.previousScale, states.scale, alpha);
+				transform.rotation = states.previousRotation + turn * alpha;
+			});
+	}
+
+} // namespace lve
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "lve_entity_registry.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+
+
+namespace lve {
+
+	// Accumulates real frame time and hands it out as fixed simulation steps, so the simulation advances at the same
+	// rate whatever the frame rate. What is left over, less than a step, carries into the next frame and tells how far
+	// rendering is between the last two simulated states.
+	//
+	// A frame never takes more than maxStepsPerFrame steps. Time beyond them is dropped, so after a hitch the
+	// simulation slows down for a frame instead of falling further behind with every frame spent catching up.
+	class LveFixedTimestep {
+
+	public:
+		explicit LveFixedTimestep(float stepSize = 1.0f / 60.0f, uint32_t maxStepsPerFrame = 8);
+
+		// adds a frame's real time in seconds, returns how many steps to simulate for it
+		uint32_t advance(float frameTime);
+
+		float getStepSize() const { return stepSize; }
+		// fraction of a step real time is ahead of the last step, from 0 to 1
+		float getAlpha() const { return accumulator / stepSize; }
+		// steps simulated since the start
+		uint64_t getStepCount() const { return stepCount; }
+		// real time the step cap dropped since the start, in seconds
+		double getDroppedTime() const { return droppedTime; }
+
+	private:
+		float stepSize;
+		uint32_t maxStepsPerFrame;
+		float accumulator = 0.0f;
+		uint64_t stepCount = 0;
+		double droppedTime = 0.0;
+	};
+
+	// Renders entities with an InterpolatedTransformComponent between their last two fixed step states. Their
+	// TransformComponent is the simulated state while the steps run and the interpolated one after, so systems
+	// stepping the simulation and systems drawing it both just read the TransformComponent.
+	//
+	// Only the fixed steps may move interpolated entities, anything written to their TransformComponent outside of
+	// them is replaced by the simulated state before the next step.
+	class LveTransformInterpolator {
+
+	public:
+		explicit LveTransformInterpolator(LveEntityRegistry& registry) : registry{ registry } {}
+
+		// interpolates entity from now on, starting from its TransformComponent as both states
+		void track(LveEntity entity);
+
+		// Runs step stepCount times on the simulated transforms, then leaves the transforms alpha of the way from
+		// the state before the last step to the state after it.
+		void simulate(uint32_t stepCount, float alpha, const std::function<void()>& step);
+
+	private:
+		// the last simulated state back into the TransformComponents
+		void restore();
+		void keepPrevious();
+		void keepCurrent();
+		void interpolate(float alpha);
+
+		LveEntityRegistry& registry;
+	};
+
+} // namespace lve
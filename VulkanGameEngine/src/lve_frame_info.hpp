@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lve_camera.hpp"
+#include "lve_entity_registry.hpp"
 #include "lve_game_object.hpp"
 
 // lib
@@ -10,11 +11,13 @@
 namespace lve
 {
 
-#define MAX_LIGHTS 10
+	class LveDepthPyramid;
+	class LveLightClusters;
+	class LveRenderer;
 
 	struct PointLight
 	{
-		glm::vec4 position{}; // ignore w
+		glm::vec4 position{}; // w is the range
 		glm::vec4 color{};    // w is intensity
 	};
 
@@ -23,8 +26,9 @@ namespace lve
 		glm::mat4 view{ 1.0f };
 		glm::mat4 inverseView{ 1.0f };
 		glm::vec4 ambientLightColor{ 1.0f, 1.0f, 1.0f, 0.02f }; // w is intensity
-		PointLight pointLights[MAX_LIGHTS];
-		int numLights;
+		// point lights are in storage buffers, binned into clusters by LveLightClusters
+		glm::uvec4 clusterCount{}; // xyz light clusters, w point lights
+		glm::vec4 clusterScale{};  // xy clusters per pixel, zw scale and bias from log view depth to cluster slice
 	};
 
 	struct FrameInfo {
@@ -33,7 +37,15 @@ namespace lve
 		VkCommandBuffer commandBuffer;
 		LveCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
-		LveGameObject::Map& gameObjects;
+		LveEntityRegistry& entities;
+		// set when the render pass was begun for secondary command buffers, systems record through it
+		LveRenderer* parallelRecorder = nullptr;
+		// depth of the previous frame for occlusion culling, null when there is none
+		LveDepthPyramid* depthPyramid = nullptr;
+		// point lights of the frame are added to it, null when nothing is lit
+		LveLightClusters* lightClusters = nullptr;
+		// input attachments of the deferred lighting subpass, set once the G-buffer subpass is done
+		VkDescriptorSet gBufferDescriptorSet = VK_NULL_HANDLE;
 	};
 
 } // namespace lve
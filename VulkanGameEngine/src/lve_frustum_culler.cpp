@@ -0,0 +1,159 @@
+#include "lve_frustum_culler.hpp"
+
+// std
+#include <cassert>
+
+#if defined(__AVX__)
+#define LVE_CULL_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LVE_CULL_SSE
+#include <emmintrin.h>
+#endif
+
+
+namespace lve {
+
+	LveFrustum LveFrustum::fromMatrix(const glm::mat4& viewProjection)
+	{
+		// glm is column major, row i of the matrix holds the clip space coordinate i as a function of the world position
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = { viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] };
+		}
+
+		// inside is -w <= x, y <= w and 0 <= z <= w
+		LveFrustum frustum{};
+		frustum.planes[Left] = rows[3] + rows[0];
+		frustum.planes[Right] = rows[3] - rows[0];
+		frustum.planes[Bottom] = rows[3] + rows[1];
+		frustum.planes[Top] = rows[3] - rows[1];
+		frustum.planes[Near] = rows[2];
+		frustum.planes[Far] = rows[3] - rows[2];
+
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3{ plane });
+		}
+		return frustum;
+	}
+
+	bool LveFrustum::intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const auto& plane : planes)
+		{
+			if (glm::dot(glm::vec3{ plane }, center) + plane.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void LveFrustumCuller::setFrustum(const glm::mat4& projection, const glm::mat4& view)
+	{
+		frustum = LveFrustum::fromMatrix(projection * view);
+	}
+
+	void LveFrustumCuller::resize(uint32_t count)
+	{
+		candidateCount = count;
+
+		uint32_t paddedCount = (count + LANE_COUNT - 1) / LANE_COUNT * LANE_COUNT;
+		centerX.resize(paddedCount);
+		centerY.resize(paddedCount);
+		centerZ.resize(paddedCount);
+		radii.resize(paddedCount);
+	}
+
+	const std::vector<uint32_t>& LveFrustumCuller::cull()
+	{
+		assert(centerX.size() >= candidateCount && "Culler was not resized for the candidates!");
+
+		// written branch free, every lane stores its index and only visible lanes advance the count
+		visible.resize(centerX.size());
+		uint32_t visibleCount = 0;
+
+#if defined(LVE_CULL_AVX)
+		__m256 planeX[LveFrustum::PLANE_COUNT], planeY[LveFrustum::PLANE_COUNT];
+		__m256 planeZ[LveFrustum::PLANE_COUNT], planeW[LveFrustum::PLANE_COUNT];
+		for (int p = 0; p < LveFrustum::PLANE_COUNT; p++)
+		{
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+		for (uint32_t i = 0; i < candidateCount; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(&centerX[i]);
+			__m256 y = _mm256_loadu_ps(&centerY[i]);
+			__m256 z = _mm256_loadu_ps(&centerZ[i]);
+			__m256 r = _mm256_loadu_ps(&radii[i]);
+
+			// distance to each plane plus the radius, negative means fully outside
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < LveFrustum::PLANE_COUNT; p++)
+			{
+				__m256 distance = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+					_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), _mm256_add_ps(planeW[p], r)));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				visible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1u & (i + lane < candidateCount);
+			}
+		}
+#elif defined(LVE_CULL_SSE)
+		__m128 planeX[LveFrustum::PLANE_COUNT], planeY[LveFrustum::PLANE_COUNT];
+		__m128 planeZ[LveFrustum::PLANE_COUNT], planeW[LveFrustum::PLANE_COUNT];
+		for (int p = 0; p < LveFrustum::PLANE_COUNT; p++)
+		{
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		for (uint32_t i = 0; i < candidateCount; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&centerX[i]);
+			__m128 y = _mm_loadu_ps(&centerY[i]);
+			__m128 z = _mm_loadu_ps(&centerZ[i]);
+			__m128 r = _mm_loadu_ps(&radii[i]);
+
+			// distance to each plane plus the radius, negative means fully outside
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < LveFrustum::PLANE_COUNT; p++)
+			{
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[p], z), _mm_add_ps(planeW[p], r)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				visible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1u & (i + lane < candidateCount);
+			}
+		}
+#else
+		for (uint32_t i = 0; i < candidateCount; i++)
+		{
+			visible[visibleCount] = i;
+			visibleCount += frustum.intersectsSphere({ centerX[i], centerY[i], centerZ[i] }, radii[i]);
+		}
+#endif
+
+		visible.resize(visibleCount);
+		return visible;
+	}
+
+} // namespace lve
@@ -0,0 +1,67 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+
+namespace lve {
+
+	// Six planes facing into the view volume, normalized so plane distances are in world units
+	struct LveFrustum
+	{
+		enum Plane { Left, Right, Bottom, Top, Near, Far, PLANE_COUNT };
+
+		glm::vec4 planes[PLANE_COUNT]{};
+
+		// clip volume of projection * view, with the Vulkan depth range of 0 to 1
+		static LveFrustum fromMatrix(const glm::mat4& viewProjection);
+
+		bool intersectsSphere(const glm::vec3& center, float radius) const;
+	};
+
+	// Tests world space bounding spheres against the camera frustum. Spheres are kept as structure of arrays,
+	// so each plane is tested against 4 spheres at a time with SSE, or 8 when the engine is compiled for AVX.
+	class LveFrustumCuller {
+
+	public:
+		void setFrustum(const glm::mat4& projection, const glm::mat4& view);
+		const LveFrustum& getFrustum() const { return frustum; }
+
+		// sizes the sphere arrays for this frame's candidates, which are then written by index
+		void resize(uint32_t candidateCount);
+		// different indices may be written from different threads
+		void setSphere(uint32_t index, const glm::vec3& center, float radius)
+		{
+			centerX[index] = center.x;
+			centerY[index] = center.y;
+			centerZ[index] = center.z;
+			radii[index] = radius;
+		}
+
+		// indices of the candidates intersecting the frustum, in increasing order
+		const std::vector<uint32_t>& cull();
+
+		uint32_t getCandidateCount() const { return candidateCount; }
+		uint32_t getVisibleCount() const { return static_cast<uint32_t>(visible.size()); }
+		uint32_t getCulledCount() const { return candidateCount - getVisibleCount(); }
+
+	private:
+		// widest batch the SIMD paths test, the arrays are padded to a multiple of it
+		static constexpr uint32_t LANE_COUNT = 8;
+
+		LveFrustum frustum{};
+		uint32_t candidateCount = 0;
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radii;
+		std::vector<uint32_t> visible;
+	};
+
+} // namespace lve
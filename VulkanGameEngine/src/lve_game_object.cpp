@@ -5,38 +5,43 @@ namespace lve {
 
 
 
-	glm::mat4 TransformComponent::mat4()
+	std::atomic<uint32_t> TransformComponent::rebuildCount{ 0 };
+
+	const glm::mat4& TransformComponent::mat4()
 	{
-		const float c3 = glm::cos(rotation.z);
-		const float s3 = glm::sin(rotation.z);
-		const float c2 = glm::cos(rotation.x);
-		const float s2 = glm::sin(rotation.x);
-		const float c1 = glm::cos(rotation.y);
-		const float s1 = glm::sin(rotation.y);
-		return glm::mat4{
-			{
-				scale.x * (c1 * c3 + s1 * s2 * s3),
-				scale.x * (c2 * s3),
-				scale.x * (c1 * s2 * s3 - c3 * s1),
-				0.0f,
-			},
-			{
-				scale.y * (c3 * s1 * s2 - c1 * s3),
-				scale.y * (c2 * c3),
-				scale.y * (c1 * c3 * s2 + s1 * s3),
-				0.0f,
-			},
-			{
-				scale.z * (c2 * s1),
-				scale.z * (-s2),
-				scale.z * (c1 * c2),
-				0.0f,
-			},
-			{translation.x, translation.y, translation.z, 1.0f} };
+		update();
+		return cachedMatrix;
+	}
+
+	const glm::mat3& TransformComponent::normalMatrix()
+	{
+		update();
+		return cachedNormalMatrix;
+	}
+
+	uint32_t TransformComponent::getRevision()
+	{
+		update();
+		return revision;
+	}
+
+	uint32_t TransformComponent::takeRebuildCount()
+	{
+		return rebuildCount.exchange(0, std::memory_order_relaxed);
 	}
 
-	glm::mat3 TransformComponent::normalMatrix()
+	void TransformComponent::update()
 	{
+		if (built && translation == builtTranslation && rotation == builtRotation && scale == builtScale) {
+			return;
+		}
+		builtTranslation = translation;
+		builtRotation = rotation;
+		builtScale = scale;
+		built = true;
+		revision++;
+		rebuildCount.fetch_add(1, std::memory_order_relaxed);
+
 		const float c3 = glm::cos(rotation.z);
 		const float s3 = glm::sin(rotation.z);
 		const float c2 = glm::cos(rotation.x);
@@ -44,38 +49,50 @@ namespace lve {
 		const float c1 = glm::cos(rotation.y);
 		const float s1 = glm::sin(rotation.y);
 
-		const glm::vec3 invScale = 1.0f / scale;
-
-		return glm::mat3{
+		// the rotation is shared, the normal matrix scales it by the inverse scale instead
+		const glm::mat3 rotationMatrix{
 			{
-				invScale.x * (c1 * c3 + s1 * s2 * s3),
-				invScale.x * (c2 * s3),
-				invScale.x * (c1 * s2 * s3 - c3 * s1),
+				c1 * c3 + s1 * s2 * s3,
+				c2 * s3,
+				c1 * s2 * s3 - c3 * s1,
 			},
 			{
-				invScale.y * (c3 * s1 * s2 - c1 * s3),
-				invScale.y * (c2 * c3),
-				invScale.y * (c1 * c3 * s2 + s1 * s3),
+				c3 * s1 * s2 - c1 * s3,
+				c2 * c3,
+				c1 * c3 * s2 + s1 * s3,
 			},
 			{
-				invScale.z * (c2 * s1),
-				invScale.z * (-s2),
-				invScale.z * (c1 * c2),
+				c2 * s1,
+				-s2,
+				c1 * c2,
 			},
 		};
 
+		const glm::vec3 invScale = 1.0f / scale;
+
+		cachedMatrix = glm::mat4{
+			glm::vec4{ scale.x * rotationMatrix[0], 0.0f },
+			glm::vec4{ scale.y * rotationMatrix[1], 0.0f },
+			glm::vec4{ scale.z * rotationMatrix[2], 0.0f },
+			glm::vec4{ translation, 1.0f } };
+		cachedNormalMatrix = glm::mat3{
+			invScale.x * rotationMatrix[0],
+			invScale.y * rotationMatrix[1],
+			invScale.z * rotationMatrix[2] };
 	}
 
-	LveGameObject LveGameObject::makePointLight(float intensity, float radius, glm::vec3 color)
+	LveEntity createPointLight(LveEntityRegistry& registry, float intensity, float radius, glm::vec3 color)
 	{
-		LveGameObject gameObj = LveGameObject::createGameObject();
+		LveEntity entity = registry.create();
+
+		TransformComponent& transform = registry.add<TransformComponent>(entity);
+		transform.scale.x = radius;
 
-		gameObj.color = color;
-		gameObj.transform.scale.x = radius;
-		gameObj.pointLight = std::make_unique<PointLightComponent>();
-		gameObj.pointLight->lightIntensity = intensity;
+		PointLightComponent& pointLight = registry.add<PointLightComponent>(entity);
+		pointLight.lightIntensity = intensity;
+		pointLight.color = color;
 
-		return gameObj;
+		return entity;
 	}
 
 } // namespace lve
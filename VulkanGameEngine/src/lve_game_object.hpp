@@ -1,13 +1,14 @@
 #pragma once
 
+#include "lve_entity_registry.hpp"
 #include "lve_model.hpp"
 
 // libs
 #include <glm/gtc/matrix_transform.hpp>
 
 // std
+#include <atomic>
 #include <memory>
-#include <unordered_map>
 
 
 namespace lve {
@@ -21,8 +22,29 @@ namespace lve {
 		// Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
 		  // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
 		  // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-		glm::mat4 mat4();
-		glm::mat3 normalMatrix();
+		// Both matrices are cached and rebuilt together when translation, rotation or scale changed since the
+		// last call, so static objects cost a comparison per frame.
+		const glm::mat4& mat4();
+		const glm::mat3& normalMatrix();
+		// changes whenever the matrices are rebuilt, so a reader can tell they changed since it last looked
+		uint32_t getRevision();
+
+		// matrix rebuilds of all transforms since the last call, thread safe
+		static uint32_t takeRebuildCount();
+
+	private:
+		void update();
+
+		// the values the cached matrices were built from
+		glm::vec3 builtTranslation{};
+		glm::vec3 builtScale{};
+		glm::vec3 builtRotation{};
+		bool built = false;
+		uint32_t revision = 0;
+		glm::mat4 cachedMatrix{ 1.0f };
+		glm::mat3 cachedNormalMatrix{ 1.0f };
+
+		static std::atomic<uint32_t> rebuildCount;
 	};
 
 	struct RigidBody2dComponent
@@ -31,25 +53,59 @@ namespace lve {
 		float mass{1.0f};
 	};
 
+	// drawn by SimpleRenderSystem with the entity's TransformComponent
+	struct ModelComponent
+	{
+		std::shared_ptr<LveModel> model{};
+		// zero keeps the vertex colors
+		glm::vec3 color{};
+	};
+
+	// world space matrices of an entity in an LveSceneGraph, its TransformComponent is then relative to the parent.
+	// Written by LveSceneGraph::update, SimpleRenderSystem draws with them when the entity has one.
+	struct WorldTransformComponent
+	{
+		glm::mat4 matrix{ 1.0f };
+		glm::mat3 normalMatrix{ 1.0f };
+		// the LveSceneGraph update that last wrote the matrices, so a reader can tell they changed since it last looked
+		uint32_t revision = 0;
+	};
+
+	// The last two fixed step states of an entity whose TransformComponent is simulated at a fixed rate, see
+	// LveTransformInterpolator. Between the steps of a frame the TransformComponent holds a blend of the two.
+	struct InterpolatedTransformComponent
+	{
+		glm::vec3 previousTranslation{};
+		glm::vec3 previousScale{ 1.0f };
+		glm::vec3 previousRotation{};
+		glm::vec3 translation{};
+		glm::vec3 scale{ 1.0f };
+		glm::vec3 rotation{};
+	};
+
+	// the radius of the billboard is the x scale of the entity's TransformComponent
 	struct PointLightComponent
 	{
 		float lightIntensity = 1.0f;
+		glm::vec3 color{ 1.0f };
 	};
 
+	// entity with the transform and point light components of a light
+	LveEntity createPointLight(
+		LveEntityRegistry& registry, float intensity = 10.0f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.0f));
+
+	// A standalone object with every component inline, for the 2D gravity demo and the camera's viewer. Scenes keep
+	// their objects as entities of an LveEntityRegistry.
 	class LveGameObject
 	{
 	public:
 		using id_t = unsigned int;
-		using Map = std::unordered_map<id_t, LveGameObject>;
 
 		static LveGameObject createGameObject() {
 			static id_t currentId = 0;
 			return LveGameObject{ currentId++ };
 		}
 
-		static LveGameObject makePointLight(
-		float intensity = 10.0f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.0f));
-
 		LveGameObject(const LveGameObject&) = delete;
 		LveGameObject& operator=(const LveGameObject&) = delete;
 		LveGameObject(LveGameObject&&) = default;
@@ -63,7 +119,6 @@ namespace lve {
 
 		// Optional pointer components
 		std::shared_ptr<LveModel> model{};
-		std::unique_ptr<PointLightComponent> pointLight = nullptr;
 
 	private:
 		LveGameObject(id_t objId) : id{ objId } {}
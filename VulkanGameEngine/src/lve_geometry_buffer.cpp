@@ -0,0 +1,152 @@
+#include "lve_geometry_buffer.hpp"
+
+#include "lve_swap_chain.hpp"
+#include "lve_upload_queue.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+
+namespace lve {
+
+	LveGeometryBuffer::LveGeometryBuffer(LveDevice& device, uint32_t vertexCapacity, uint32_t indexCapacity)
+		: lveDevice{ device }, vertexCapacity{ vertexCapacity }, indexCapacity{ indexCapacity }
+	{
+	}
+
+	LveGeometryBuffer::~LveGeometryBuffer()
+	{
+		// the device is idle by now
+		for (auto& pending : pendingFrees) {
+			release(pending.allocation);
+		}
+	}
+
+	uint32_t LveGeometryBuffer::allocateRange(
+		std::vector<std::unique_ptr<Arena>>& arenas, uint32_t stride, uint32_t count, uint32_t capacity,
+		VkBufferUsageFlags usage, uint32_t& offset, LveRangeAllocator::Handle& range)
+	{
+		uint64_t rangeOffset = 0;
+		for (uint32_t i = 0; i < arenas.size(); i++)
+		{
+			if (arenas[i]->stride == stride && arenas[i]->ranges.allocate(count, 1, rangeOffset, range)) {
+				offset = static_cast<uint32_t>(rangeOffset);
+				return i;
+			}
+		}
+
+		// meshes larger than the default capacity get an arena sized for them
+		capacity = std::max<uint32_t>(capacity, (count + LveRangeAllocator::MIN_ALIGNMENT - 1) /
+			LveRangeAllocator::MIN_ALIGNMENT * LveRangeAllocator::MIN_ALIGNMENT);
+
+		auto arena = std::make_unique<Arena>(stride, capacity);
+		arena->buffer = std::make_unique<LveBuffer>(
+			lveDevice,
+			stride,
+			capacity,
+			usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (!arena->ranges.allocate(count, 1, rangeOffset, range)) {
+			throw std::runtime_error("Failed to allocate geometry range!");
+		}
+		offset = static_cast<uint32_t>(rangeOffset);
+
+		arenas.push_back(std::move(arena));
+		return static_cast<uint32_t>(arenas.size() - 1);
+	}
+
+	LveGeometryAllocation LveGeometryBuffer::allocate(uint32_t vertexStride, uint32_t vertexCount, uint32_t indexCount)
+	{
+		assert(vertexCount > 0 && "Allocating geometry without vertices!");
+
+		LveGeometryAllocation allocation{};
+		allocation.vertexCount = vertexCount;
+		allocation.indexCount = indexCount;
+
+		allocation.vertexArena = allocateRange(
+			vertexArenas, vertexStride, vertexCount, vertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			allocation.firstVertex, allocation.vertexRange);
+
+		if (indexCount > 0)
+		{
+			allocation.indexArena = allocateRange(
+				indexArenas, sizeof(uint32_t), indexCount, indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+				allocation.firstIndex, allocation.indexRange);
+		}
+		else {
+			allocation.indexArena = NO_ARENA;
+		}
+
+		return allocation;
+	}
+
+	void LveGeometryBuffer::release(const LveGeometryAllocation& allocation)
+	{
+		vertexArenas[allocation.vertexArena]->ranges.free(allocation.vertexRange);
+		if (allocation.hasIndices()) {
+			indexArenas[allocation.indexArena]->ranges.free(allocation.indexRange);
+		}
+	}
+
+	void LveGeometryBuffer::free(LveGeometryAllocation& allocation)
+	{
+		if (!allocation.valid()) {
+			return;
+		}
+
+		pendingFrees.push_back({ allocation, frameCounter });
+		allocation = LveGeometryAllocation{};
+	}
+
+	void LveGeometryBuffer::beginFrame()
+	{
+		frameCounter++;
+
+		// a range freed while frame N was recorded is last read by frame N,
+		// which has finished once the frame MAX_FRAMES_IN_FLIGHT later begins
+		auto released = std::remove_if(pendingFrees.begin(), pendingFrees.end(), [this](const PendingFree& pending) {
+			if (pending.frame + LveSwapChain::MAX_FRAMES_IN_FLIGHT > frameCounter) {
+				return false;
+			}
+			release(pending.allocation);
+			return true;
+		});
+		pendingFrees.erase(released, pendingFrees.end());
+	}
+
+	uint64_t LveGeometryBuffer::upload(const LveGeometryAllocation& allocation, const void* vertices, const uint32_t* indices)
+	{
+		const Arena& vertexArena = *vertexArenas[allocation.vertexArena];
+		uint64_t ticket = lveDevice.uploadQueue().uploadBuffer(
+			vertexArena.buffer->getBuffer(),
+			static_cast<VkDeviceSize>(allocation.firstVertex) * vertexArena.stride,
+			vertices,
+			static_cast<VkDeviceSize>(allocation.vertexCount) * vertexArena.stride);
+
+		if (allocation.hasIndices())
+		{
+			ticket = lveDevice.uploadQueue().uploadBuffer(
+				indexArenas[allocation.indexArena]->buffer->getBuffer(),
+				static_cast<VkDeviceSize>(allocation.firstIndex) * sizeof(uint32_t),
+				indices,
+				static_cast<VkDeviceSize>(allocation.indexCount) * sizeof(uint32_t));
+		}
+		return ticket;
+	}
+
+	void LveGeometryBuffer::bindVertexArena(VkCommandBuffer commandBuffer, uint32_t arena)
+	{
+		VkBuffer buffers[] = { vertexArenas[arena]->buffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	}
+
+	void LveGeometryBuffer::bindIndexArena(VkCommandBuffer commandBuffer, uint32_t arena)
+	{
+		vkCmdBindIndexBuffer(commandBuffer, indexArenas[arena]->buffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+
+} // namespace lve
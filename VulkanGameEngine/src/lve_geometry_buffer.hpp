@@ -0,0 +1,101 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+#include "lve_range_allocator.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace lve {
+
+	// A model's sub-range of the geometry buffer, offsets and counts are in vertices and indices
+	struct LveGeometryAllocation
+	{
+		uint32_t vertexArena = 0;
+		uint32_t firstVertex = 0;
+		uint32_t vertexCount = 0;
+		uint32_t indexArena = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+
+		LveRangeAllocator::Handle vertexRange = LveRangeAllocator::INVALID_HANDLE;
+		LveRangeAllocator::Handle indexRange = LveRangeAllocator::INVALID_HANDLE;
+
+		bool valid() const { return vertexRange != LveRangeAllocator::INVALID_HANDLE; }
+		bool hasIndices() const { return indexRange != LveRangeAllocator::INVALID_HANDLE; }
+	};
+
+	// Engine wide vertex and index arenas that models are sub-allocated from, so a frame binds geometry
+	// once per arena instead of once per object. Vertex arenas are keyed by stride, and a new arena is
+	// added whenever the existing ones of that stride are full.
+	class LveGeometryBuffer {
+
+	public:
+		static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 20;
+		static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1 << 23;
+		static constexpr uint32_t NO_ARENA = ~0u;
+
+		LveGeometryBuffer(
+			LveDevice& device,
+			uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+			uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+		~LveGeometryBuffer();
+
+		LveGeometryBuffer(const LveGeometryBuffer&) = delete;
+		LveGeometryBuffer& operator=(const LveGeometryBuffer&) = delete;
+
+		LveGeometryAllocation allocate(uint32_t vertexStride, uint32_t vertexCount, uint32_t indexCount);
+		// the ranges are reused once the frames that may still draw from them have finished
+		void free(LveGeometryAllocation& allocation);
+
+		// queues the copies on the upload queue, returns its ticket
+		uint64_t upload(const LveGeometryAllocation& allocation, const void* vertices, const uint32_t* indices);
+
+		// call once per frame after waiting for the frame's fence, releases the ranges freed frames ago
+		void beginFrame();
+
+		void bindVertexArena(VkCommandBuffer commandBuffer, uint32_t arena);
+		void bindIndexArena(VkCommandBuffer commandBuffer, uint32_t arena);
+
+		VkBuffer getVertexBuffer(uint32_t arena) const { return vertexArenas[arena]->buffer->getBuffer(); }
+		VkBuffer getIndexBuffer(uint32_t arena) const { return indexArenas[arena]->buffer->getBuffer(); }
+		uint32_t getVertexArenaCount() const { return static_cast<uint32_t>(vertexArenas.size()); }
+		uint32_t getIndexArenaCount() const { return static_cast<uint32_t>(indexArenas.size()); }
+
+	private:
+		struct Arena
+		{
+			uint32_t stride;
+			std::unique_ptr<LveBuffer> buffer;
+			LveRangeAllocator ranges;
+
+			Arena(uint32_t stride, uint32_t capacity) : stride{ stride }, ranges{ capacity } {}
+		};
+
+		struct PendingFree
+		{
+			LveGeometryAllocation allocation;
+			uint64_t frame;
+		};
+
+		uint32_t allocateRange(
+			std::vector<std::unique_ptr<Arena>>& arenas, uint32_t stride, uint32_t count, uint32_t capacity,
+			VkBufferUsageFlags usage, uint32_t& offset, LveRangeAllocator::Handle& range);
+		void release(const LveGeometryAllocation& allocation);
+
+		LveDevice& lveDevice;
+		uint32_t vertexCapacity;
+		uint32_t indexCapacity;
+
+		std::vector<std::unique_ptr<Arena>> vertexArenas;
+		std::vector<std::unique_ptr<Arena>> indexArenas;
+
+		std::vector<PendingFree> pendingFrees;
+		uint64_t frameCounter = 0;
+	};
+
+} // namespace lve
@@ -0,0 +1,400 @@
+#include "lve_gpu_culler.hpp"
+
+#include "lve_frustum_culler.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace lve {
+
+	// dispatch stages of gpu_cull.comp
+	static constexpr uint32_t CULL_OBJECTS = 0;
+	static constexpr uint32_t BUILD_DRAWS = 1;
+	static constexpr uint32_t GROUP_SIZE = 64;
+	static constexpr uint32_t MIN_CAPACITY = 64;
+
+	bool LveGpuCuller::isSupported(LveDevice& device)
+	{
+		return device.enabledFeatures().drawIndirectFirstInstance == VK_TRUE;
+	}
+
+	LveGpuCuller::LveGpuCuller(LveDevice& device)
+		: lveDevice{ device }
+	{
+		assert(isSupported(device) && "GPU culling needs drawIndirectFirstInstance!");
+
+		setLayout = LveDescriptorSetLayout::Builder(lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		descriptorPool = LveDescriptorPool::Builder(lveDevice)
+			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames)
+		{
+			frame.uniformBuffer = std::make_unique<LveBuffer>(
+				lveDevice,
+				sizeof(CullUniforms),
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.uniformBuffer->map();
+
+			frame.statsBuffer = std::make_unique<LveBuffer>(
+				lveDevice,
+				sizeof(uint32_t),
+				1,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.statsBuffer->map();
+		}
+		objectBuffer = std::make_unique<LvePersistentBuffer>(lveDevice, sizeof(LveGpuCullObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+		createPipeline();
+	}
+
+	LveGpuCuller::~LveGpuCuller()
+	{
+		pipeline.reset();
+		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+	}
+
+	void LveGpuCuller::createPipeline()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(uint32_t);
+
+		VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create culling pipeline layout!");
+		}
+
+		pipeline = std::make_unique<LveComputePipeline>(lveDevice, "shaders/gpu_cull.comp.spv", pipelineLayout);
+	}
+
+	bool LveGpuCuller::reserve(std::unique_ptr<LveBuffer>& buffer, VkDeviceSize instanceSize, uint32_t count,
+		VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+	{
+		if (buffer != nullptr && buffer->getInstanceCount() >= count) {
+			return false;
+		}
+
+		uint32_t capacity = buffer != nullptr ? buffer->getInstanceCount() : MIN_CAPACITY;
+		while (capacity < count) {
+			capacity *= 2;
+		}
+
+		// the frame that last used this frame's buffers has finished
+		buffer = std::make_unique<LveBuffer>(lveDevice, instanceSize, capacity, usage, properties);
+		if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			buffer->map();
+		}
+		return true;
+	}
+
+	void LveGpuCuller::begin(int frame, uint32_t count)
+	{
+		frameIndex = frame;
+		objectCount = count;
+		slots.clear();
+		groups.clear();
+		models.clear();
+		instanceCapacity = 0;
+
+		FrameResources& resources = frames[frameIndex];
+		if (resources.recorded)
+		{
+			resources.statsBuffer->invalidate();
+			visibleCount = *static_cast<const uint32_t*>(resources.statsBuffer->getMappedMemory());
+		}
+
+		objectBuffer->begin(frameIndex, objectCount);
+	}
+
+	uint32_t LveGpuCuller::addGroup()
+	{
+		groups.push_back({ static_cast<uint32_t>(slots.size()), 0 });
+		return static_cast<uint32_t>(groups.size() - 1);
+	}
+
+	void LveGpuCuller::addModel(uint32_t modelIndex, const LveModel& model, uint32_t maxInstances)
+	{
+		assert(!groups.empty() && "Add a group before its models!");
+		assert(model.getGeometry().hasIndices() && "GPU culled models need an index buffer!");
+
+		const LveGeometryAllocation& geometry = model.getGeometry();
+		if (modelIndex >= models.size()) {
+			models.resize(modelIndex + 1, ModelSlots{ 0, 0 });
+		}
+		models[modelIndex] = { static_cast<uint32_t>(slots.size()), model.getLodCount() };
+
+		for (uint32_t lod = 0; lod < model.getLodCount(); lod++)
+		{
+			DrawSlot slot{};
+			slot.indexCount = model.getLod(lod).indexCount;
+			slot.firstIndex = geometry.firstIndex + model.getLod(lod).firstIndex;
+			slot.vertexOffset = static_cast<int32_t>(geometry.firstVertex);
+			slot.firstInstance = instanceCapacity;
+			slot.lodError = model.getLod(lod).error;
+			slot.group = static_cast<uint32_t>(groups.size() - 1);
+			slot.commandIndex = static_cast<uint32_t>(slots.size());
+			slot.groupFirstCommand = groups.back().firstCommand;
+			slots.push_back(slot);
+
+			// every level has room for all instances of the model, the pass decides which one they land in
+			instanceCapacity += maxInstances;
+			groups.back().commandCount++;
+		}
+	}
+
+	LveGpuCullObject* LveGpuCuller::stageObjects(const std::vector<uint32_t>& indices)
+	{
+		return static_cast<LveGpuCullObject*>(objectBuffer->stage(indices));
+	}
+
+	void LveGpuCuller::writeDescriptorSet(const LveDepthPyramid& depthPyramid)
+	{
+		FrameResources& resources = frames[frameIndex];
+
+		VkDescriptorBufferInfo objectInfo = objectBuffer->getBuffer().descriptorInfo();
+		VkDescriptorBufferInfo slotInfo = resources.slotBuffer->descriptorInfo();
+		VkDescriptorBufferInfo instanceIndexInfo = resources.instanceIndexBuffer->descriptorInfo();
+		VkDescriptorImageInfo pyramidInfo = depthPyramid.descriptorInfo();
+		VkDescriptorBufferInfo uniformInfo = resources.uniformBuffer->descriptorInfo();
+		VkDescriptorBufferInfo commandInfo = resources.commandBuffer->descriptorInfo();
+		VkDescriptorBufferInfo drawCountInfo = resources.drawCountBuffer->descriptorInfo();
+		VkDescriptorBufferInfo statsInfo = resources.statsBuffer->descriptorInfo();
+		VkDescriptorBufferInfo modelInfo = resources.modelBuffer->descriptorInfo();
+
+		LveDescriptorWriter writer{ *setLayout, *descriptorPool };
+		writer.writeBuffer(0, &objectInfo)
+			.writeBuffer(1, &slotInfo)
+			.writeBuffer(2, &instanceIndexInfo)
+			.writeImage(3, &pyramidInfo)
+			.writeBuffer(4, &uniformInfo)
+			.writeBuffer(5, &commandInfo)
+			.writeBuffer(6, &drawCountInfo)
+			.writeBuffer(7, &statsInfo)
+			.writeBuffer(8, &modelInfo);
+
+		if (resources.descriptorSet == VK_NULL_HANDLE) {
+			writer.build(resources.descriptorSet);
+		}
+		else {
+			writer.overwrite(resources.descriptorSet);
+		}
+
+		resources.pyramidView = pyramidInfo.imageView;
+		resources.objectGeneration = objectBuffer->getGeneration();
+		resources.descriptorsDirty = false;
+	}
+
+	void LveGpuCuller::record(
+		VkCommandBuffer commandBuffer, const LveCamera& camera, const LveDepthPyramid& depthPyramid, float lodErrorThreshold)
+	{
+		FrameResources& resources = frames[frameIndex];
+		uint32_t slotCount = static_cast<uint32_t>(slots.size());
+		uint32_t groupCount = static_cast<uint32_t>(groups.size());
+		uint32_t modelCount = static_cast<uint32_t>(models.size());
+
+		// the staged objects are copied even without draws, they stay for the next frames
+		objectBuffer->record(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		if (objectCount == 0 || slotCount == 0)
+		{
+			resources.recorded = false;
+			visibleCount = 0;
+			return;
+		}
+
+		resources.descriptorsDirty |= reserve(
+			resources.modelBuffer,
+			sizeof(ModelSlots),
+			modelCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		resources.descriptorsDirty |= reserve(
+			resources.slotStagingBuffer,
+			sizeof(DrawSlot),
+			slotCount,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		resources.descriptorsDirty |= reserve(
+			resources.slotBuffer,
+			sizeof(DrawSlot),
+			slotCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		resources.descriptorsDirty |= reserve(
+			resources.commandBuffer,
+			sizeof(VkDrawIndexedIndirectCommand),
+			slotCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		resources.descriptorsDirty |= reserve(
+			resources.drawCountBuffer,
+			sizeof(uint32_t),
+			groupCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (reserve(
+			resources.instanceIndexBuffer,
+			sizeof(uint32_t),
+			instanceCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+		{
+			resources.instanceIndexGeneration++;
+			resources.descriptorsDirty = true;
+		}
+
+		if (resources.descriptorsDirty
+			|| resources.objectGeneration != objectBuffer->getGeneration()
+			|| resources.pyramidView != depthPyramid.descriptorInfo().imageView)
+		{
+			writeDescriptorSet(depthPyramid);
+		}
+
+		std::memcpy(resources.slotStagingBuffer->getMappedMemory(), slots.data(), slotCount * sizeof(DrawSlot));
+		resources.slotStagingBuffer->flush(slotCount * sizeof(DrawSlot));
+		std::memcpy(resources.modelBuffer->getMappedMemory(), models.data(), modelCount * sizeof(ModelSlots));
+		resources.modelBuffer->flush(modelCount * sizeof(ModelSlots));
+
+		const glm::mat4& projection = camera.getProjection();
+		LveFrustum frustum = LveFrustum::fromMatrix(projection * camera.getView());
+
+		CullUniforms uniforms{};
+		std::copy(std::begin(frustum.planes), std::end(frustum.planes), uniforms.frustumPlanes);
+		uniforms.previousViewProjection = depthPyramid.getViewProjection();
+		uniforms.cameraPosition = glm::vec4{ camera.getPosition(), 1.0f };
+		uniforms.screenExtent = { depthPyramid.getDepthExtent().width, depthPyramid.getDepthExtent().height };
+		// the screen height spans 2 units in clip space
+		uniforms.screenPerWorld = glm::abs(projection[1][1]) * 0.5f;
+		uniforms.lodErrorThreshold = lodErrorThreshold;
+		uniforms.objectCount = objectCount;
+		uniforms.slotCount = slotCount;
+		uniforms.perspective = projection[2][3] != 0.0f;
+		uniforms.occlusion = depthPyramid.isValid();
+		uniforms.pyramidLevels = depthPyramid.getLevelCount();
+		uniforms.compactDraws = lveDevice.supportsDrawIndirectCount();
+		resources.uniformBuffer->writeToBuffer(&uniforms);
+		resources.uniformBuffer->flush();
+
+		VkBufferCopy copyRegion{ 0, 0, slotCount * sizeof(DrawSlot) };
+		vkCmdCopyBuffer(commandBuffer, resources.slotStagingBuffer->getBuffer(), resources.slotBuffer->getBuffer(), 1, &copyRegion);
+		vkCmdFillBuffer(commandBuffer, resources.drawCountBuffer->getBuffer(), 0, groupCount * sizeof(uint32_t), 0);
+		vkCmdFillBuffer(commandBuffer, resources.statsBuffer->getBuffer(), 0, sizeof(uint32_t), 0);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayout,
+			0,
+			1,
+			&resources.descriptorSet,
+			0,
+			nullptr);
+
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &CULL_OBJECTS);
+		vkCmdDispatch(commandBuffer, (objectCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+		// instance counts are final once every object went through
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &BUILD_DRAWS);
+		vkCmdDispatch(commandBuffer, (slotCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		resources.recorded = true;
+	}
+
+	void LveGpuCuller::drawGroup(VkCommandBuffer commandBuffer, uint32_t group)
+	{
+		const FrameResources& resources = frames[frameIndex];
+		const DrawGroup& drawGroup = groups[group];
+		constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		VkDeviceSize offset = drawGroup.firstCommand * VkDeviceSize{ stride };
+
+		if (lveDevice.supportsDrawIndirectCount())
+		{
+			lveDevice.cmdDrawIndexedIndirectCount(
+				commandBuffer,
+				resources.commandBuffer->getBuffer(),
+				offset,
+				resources.drawCountBuffer->getBuffer(),
+				group * sizeof(uint32_t),
+				drawGroup.commandCount,
+				stride);
+		}
+		else if (lveDevice.enabledFeatures().multiDrawIndirect)
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, resources.commandBuffer->getBuffer(), offset, drawGroup.commandCount, stride);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < drawGroup.commandCount; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, resources.commandBuffer->getBuffer(), offset + i * stride, 1, stride);
+			}
+		}
+	}
+
+} // namespace lve
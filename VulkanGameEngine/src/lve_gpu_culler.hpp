@@ -0,0 +1,168 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_camera.hpp"
+#include "lve_depth_pyramid.hpp"
+#include "lve_descriptors.h"
+#include "lve_device.hpp"
+#include "lve_model.hpp"
+#include "lve_persistent_buffer.hpp"
+#include "lve_pipeline.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+
+namespace lve {
+
+	// Per object input of the culling pass, matches CullObject in gpu_cull.comp
+	struct LveGpuCullObject
+	{
+		glm::vec4 sphere{}; // world space center and radius
+		uint32_t model = 0; // as passed to LveGpuCuller::addModel
+		float scale = 1.0f; // largest axis scale of the model matrix, for the LOD error
+		uint32_t padding[2]{};
+	};
+
+	// Culls objects and selects their level of detail in a compute pass, and writes the survivors as
+	// VkDrawIndexedIndirectCommands, one per model and LOD ("draw slot"), so nothing per object comes back to the CPU.
+	// Slots are grouped by what the caller binds between draws (pipeline and geometry arenas), each group is drawn
+	// with one vkCmdDrawIndexedIndirectCount when VK_KHR_draw_indirect_count is enabled, or one
+	// vkCmdDrawIndexedIndirect over all its slots, culled slots drawing zero instances.
+	//
+	// Per frame: begin(), addGroup() and addModel() for the slots, stageObjects() that changed, then record() outside
+	// of the render pass and drawGroup() inside it. Objects stay on the GPU from frame to frame and refer to their
+	// model by index, so only the objects that moved or changed model are staged again, and the slots can be laid out
+	// anew every frame. The instance index buffer replaces the CPU batcher's remap table.
+	class LveGpuCuller {
+
+	public:
+		// needs drawIndirectFirstInstance, each slot's instances start at its own offset
+		static bool isSupported(LveDevice& device);
+
+		explicit LveGpuCuller(LveDevice& device);
+		~LveGpuCuller();
+
+		LveGpuCuller(const LveGpuCuller&) = delete;
+		LveGpuCuller& operator=(const LveGpuCuller&) = delete;
+
+		// objects past objectCount are dropped, the others are kept from the last frame
+		void begin(int frameIndex, uint32_t objectCount);
+		// slots added after this belong to the new group
+		uint32_t addGroup();
+		// reserves one slot per LOD of model, each with room for maxInstances, for the objects with modelIndex
+		void addModel(uint32_t modelIndex, const LveModel& model, uint32_t maxInstances);
+		// room for the objects to replace, entry i is object indices[i], may be filled from several threads
+		LveGpuCullObject* stageObjects(const std::vector<uint32_t>& indices);
+
+		// records the culling and draw building dispatches, depth is from the previous frame
+		void record(VkCommandBuffer commandBuffer, const LveCamera& camera, const LveDepthPyramid& depthPyramid, float lodErrorThreshold);
+		// records the draws of group, its pipeline and geometry arenas are bound by the caller
+		void drawGroup(VkCommandBuffer commandBuffer, uint32_t group);
+
+		// instance indices grouped by slot, read by the vertex shader like the CPU batcher's remap table
+		LveBuffer& getInstanceIndexBuffer() { return *frames[frameIndex].instanceIndexBuffer; }
+		// changes whenever record() reallocated this frame's instance index buffer, descriptors of it need rewriting
+		uint32_t getInstanceIndexGeneration() const { return frames[frameIndex].instanceIndexGeneration; }
+		uint32_t getGroupCount() const { return static_cast<uint32_t>(groups.size()); }
+		uint32_t getSlotCount() const { return static_cast<uint32_t>(slots.size()); }
+		// objects drawn the last time this frame index was recorded, read back without waiting on the GPU
+		uint32_t getVisibleCount() const { return visibleCount; }
+
+	private:
+		// matches DrawSlot in gpu_cull.comp
+		struct DrawSlot
+		{
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t firstInstance;
+			float lodError;
+			uint32_t group;
+			uint32_t commandIndex;
+			uint32_t groupFirstCommand;
+			uint32_t instanceCount;
+			uint32_t padding[3];
+		};
+
+		// matches CullUbo in gpu_cull.comp, std140
+		struct CullUniforms
+		{
+			glm::vec4 frustumPlanes[6];
+			glm::mat4 previousViewProjection;
+			glm::vec4 cameraPosition;
+			glm::vec2 screenExtent;
+			float screenPerWorld;
+			float lodErrorThreshold;
+			uint32_t objectCount;
+			uint32_t slotCount;
+			uint32_t perspective;
+			uint32_t occlusion;
+			uint32_t pyramidLevels;
+			uint32_t compactDraws;
+		};
+
+		// matches ModelSlots in gpu_cull.comp
+		struct ModelSlots
+		{
+			uint32_t firstSlot;
+			uint32_t lodCount;
+		};
+
+		struct DrawGroup
+		{
+			uint32_t firstCommand;
+			uint32_t commandCount;
+		};
+
+		// buffers of one frame in flight, grown by doubling
+		struct FrameResources
+		{
+			std::unique_ptr<LveBuffer> modelBuffer;
+			std::unique_ptr<LveBuffer> slotStagingBuffer;
+			std::unique_ptr<LveBuffer> slotBuffer;
+			std::unique_ptr<LveBuffer> uniformBuffer;
+			std::unique_ptr<LveBuffer> commandBuffer;
+			std::unique_ptr<LveBuffer> drawCountBuffer;
+			std::unique_ptr<LveBuffer> statsBuffer;
+			std::unique_ptr<LveBuffer> instanceIndexBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkImageView pyramidView = VK_NULL_HANDLE;
+			uint32_t objectGeneration = 0;
+			uint32_t instanceIndexGeneration = 0;
+			bool descriptorsDirty = true;
+			bool recorded = false;
+		};
+
+		// returns true when the buffer was replaced
+		bool reserve(std::unique_ptr<LveBuffer>& buffer, VkDeviceSize instanceSize, uint32_t count,
+			VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		void writeDescriptorSet(const LveDepthPyramid& depthPyramid);
+		void createPipeline();
+
+		LveDevice& lveDevice;
+
+		std::unique_ptr<LveDescriptorSetLayout> setLayout;
+		std::unique_ptr<LveDescriptorPool> descriptorPool;
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<LveComputePipeline> pipeline;
+
+		std::vector<FrameResources> frames;
+		std::unique_ptr<LvePersistentBuffer> objectBuffer;
+
+		int frameIndex = 0;
+		uint32_t objectCount = 0;
+		std::vector<DrawSlot> slots;
+		std::vector<ModelSlots> models;
+		std::vector<DrawGroup> groups;
+		uint32_t instanceCapacity = 0;
+		uint32_t visibleCount = 0;
+	};
+
+} // namespace lve
@@ -0,0 +1,99 @@
+#include "lve_instance_batcher.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+
+namespace lve {
+
+	static uint32_t hashKey(const LveModel* model, uint32_t lod)
+	{
+		// fibonacci hashing, the upper half of the product depends on every bit of the pointer
+		uint64_t bits = reinterpret_cast<uintptr_t>(model) ^ (uint64_t{ lod } << 40);
+		return static_cast<uint32_t>((bits * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	void LveInstanceBatcher::growTable()
+	{
+		batchTable.assign(std::max<size_t>(64, batchTable.size() * 2), EMPTY_SLOT);
+		uint32_t mask = static_cast<uint32_t>(batchTable.size() - 1);
+		for (uint32_t batch = 0; batch < batches.size(); batch++)
+		{
+			uint32_t slot = hashKey(batches[batch].model, batches[batch].lod) & mask;
+			while (batchTable[slot] != EMPTY_SLOT) {
+				slot = (slot + 1) & mask;
+			}
+			batchTable[slot] = batch;
+		}
+	}
+
+	uint32_t LveInstanceBatcher::findBatch(const Key& key)
+	{
+		if ((batches.size() + 1) * 2 > batchTable.size()) {
+			growTable();
+		}
+
+		uint32_t mask = static_cast<uint32_t>(batchTable.size() - 1);
+		uint32_t slot = hashKey(key.model, key.lod) & mask;
+		while (batchTable[slot] != EMPTY_SLOT)
+		{
+			const LveDrawBatch& batch = batches[batchTable[slot]];
+			if (batch.model == key.model && batch.lod == key.lod) {
+				return batchTable[slot];
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		batchTable[slot] = static_cast<uint32_t>(batches.size());
+		batches.push_back({ key.model, key.lod, 0, 0 });
+		return batchTable[slot];
+	}
+
+	void LveInstanceBatcher::clear()
+	{
+		// keeps the capacity, the same objects are batched again next frame
+		std::fill(batchTable.begin(), batchTable.end(), EMPTY_SLOT);
+		batches.clear();
+		instanceBatches.clear();
+		lastKey = { nullptr, 0 };
+	}
+
+	uint32_t LveInstanceBatcher::add(LveModel* model, uint32_t lod)
+	{
+		assert(model != nullptr && "Batching an object without a model!");
+
+		Key key{ model, lod };
+		if (!(key == lastKey))
+		{
+			lastBatch = findBatch(key);
+			lastKey = key;
+		}
+
+		batches[lastBatch].instanceCount++;
+		instanceBatches.push_back(lastBatch);
+		return static_cast<uint32_t>(instanceBatches.size() - 1);
+	}
+
+	std::vector<LveDrawBatch>& LveInstanceBatcher::build(uint32_t* dst)
+	{
+		uint32_t firstInstance = 0;
+		for (auto& batch : batches)
+		{
+			batch.firstInstance = firstInstance;
+			firstInstance += batch.instanceCount;
+		}
+
+		// counting sort of the instances by batch
+		cursors.resize(batches.size());
+		for (size_t i = 0; i < batches.size(); i++) {
+			cursors[i] = batches[i].firstInstance;
+		}
+		for (size_t i = 0; i < instanceBatches.size(); i++) {
+			dst[cursors[instanceBatches[i]]++] = static_cast<uint32_t>(i);
+		}
+
+		return batches;
+	}
+
+} // namespace lve
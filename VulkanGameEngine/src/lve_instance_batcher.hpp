@@ -0,0 +1,80 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+
+namespace lve {
+
+	class LveModel;
+
+	// Per instance data read by the vertex shaders, matches the std430 Instance struct
+	struct LveInstanceData
+	{
+		glm::mat4 modelMatrix{ 1.0f };
+		glm::mat4 normalMatrix{ 1.0f };
+		glm::vec4 color{ 0.0f }; // w selects color over the vertex colors
+	};
+
+	// One instanced draw of a model, its instance indices are contiguous from firstInstance
+	struct LveDrawBatch
+	{
+		LveModel* model;
+		uint32_t lod;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	// Groups objects drawn with the same model and level of detail, so each group becomes one instanced draw.
+	// Instance data is written once in submission order, and a remap table sorted by batch points
+	// gl_InstanceIndex at it, so grouping only moves 4 byte indices around.
+	// Models are only used as keys here, never dereferenced.
+	class LveInstanceBatcher {
+
+	public:
+		void clear();
+
+		// returns the index the object's LveInstanceData is to be written at
+		uint32_t add(LveModel* model, uint32_t lod);
+
+		// writes the instance indices grouped by batch to dst, which needs room for getInstanceCount() entries,
+		// and returns the batches in order of first use
+		std::vector<LveDrawBatch>& build(uint32_t* dst);
+
+		uint32_t getInstanceCount() const { return static_cast<uint32_t>(instanceBatches.size()); }
+		uint32_t getBatchCount() const { return static_cast<uint32_t>(batches.size()); }
+		// batches in order of first use, firstInstance is only set by build
+		const std::vector<LveDrawBatch>& getBatches() const { return batches; }
+		// index into getBatches() of the instance returned by add
+		uint32_t getInstanceBatch(uint32_t instance) const { return instanceBatches[instance]; }
+
+	private:
+		struct Key
+		{
+			LveModel* model;
+			uint32_t lod;
+
+			bool operator==(const Key& other) const { return model == other.model && lod == other.lod; }
+		};
+
+		static constexpr uint32_t EMPTY_SLOT = ~0u;
+
+		uint32_t findBatch(const Key& key);
+		void growTable();
+
+		// open addressing table from key to batch index, sized to a power of two above twice the batch count
+		std::vector<uint32_t> batchTable;
+		std::vector<LveDrawBatch> batches;
+		std::vector<uint32_t> instanceBatches;
+		std::vector<uint32_t> cursors;
+
+		// objects sharing a model are often added back to back
+		Key lastKey{ nullptr, 0 };
+		uint32_t lastBatch = 0;
+	};
+
+} // namespace lve
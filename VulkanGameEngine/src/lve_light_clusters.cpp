@@ -0,0 +1,226 @@
+#include "lve_light_clusters.hpp"
+
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+
+namespace lve {
+
+	static constexpr uint32_t GROUP_SIZE = 64;
+	static constexpr uint32_t CLUSTER_TOTAL =
+		LveLightClusters::CLUSTER_COUNT_X * LveLightClusters::CLUSTER_COUNT_Y * LveLightClusters::CLUSTER_COUNT_Z;
+
+	// matches Push in light_cluster.comp
+	struct LightClusterPushConstants
+	{
+		glm::mat4 view{ 1.0f };
+		glm::vec4 projection{}; // x and y scale of the projection, near and far plane
+		glm::uvec4 clusterCount{}; // xyz clusters, w lights
+		uint32_t lightIndexCapacity = 0;
+	};
+
+	void LveLightingOptions::specialize(PipelineConfigInfo& configInfo, uint32_t lightLoopVariant) const
+	{
+		assert(lightLoopVariant < LIGHT_LOOP_VARIANT_COUNT && "Unknown light loop variant!");
+
+		uint32_t lightLoopBound = lightLoopVariant == SMALL_LIGHT_LOOP_VARIANT ? SMALL_LIGHT_LOOP : 0;
+		LvePipeline::setSpecializationConstant(configInfo, LIGHT_LOOP_BOUND_ID, lightLoopBound);
+		LvePipeline::setSpecializationConstant(configInfo, SPECULAR_ID, specular);
+		LvePipeline::setSpecializationConstant(configInfo, SPECULAR_EXPONENT_ID, specularExponent);
+	}
+
+	uint32_t LveLightingOptions::selectLightLoop(const FrameInfo& frameInfo)
+	{
+		if (frameInfo.lightClusters == nullptr || frameInfo.lightClusters->getLightCount() <= SMALL_LIGHT_LOOP) {
+			return SMALL_LIGHT_LOOP_VARIANT;
+		}
+		return DYNAMIC_LIGHT_LOOP;
+	}
+
+	LveLightClusters::LveLightClusters(LveDevice& device, uint32_t maxLights)
+		: lveDevice{ device }, maxLights{ maxLights }
+	{
+		setLayout = LveDescriptorSetLayout::Builder(lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		descriptorPool = LveDescriptorPool::Builder(lveDevice)
+			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		createFrameResources();
+		createPipeline();
+	}
+
+	LveLightClusters::~LveLightClusters()
+	{
+		pipeline.reset();
+		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+	}
+
+	void LveLightClusters::createFrameResources()
+	{
+		frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : frames)
+		{
+			frame.lightBuffer = std::make_unique<LveBuffer>(
+				lveDevice,
+				sizeof(PointLight),
+				maxLights,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.lightBuffer->map();
+
+			frame.clusterBuffer = std::make_unique<LveBuffer>(
+				lveDevice,
+				sizeof(glm::uvec2),
+				CLUSTER_TOTAL,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			frame.lightIndexBuffer = std::make_unique<LveBuffer>(
+				lveDevice,
+				sizeof(uint32_t),
+				CLUSTER_TOTAL * LIGHT_INDICES_PER_CLUSTER,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			frame.counterBuffer = std::make_unique<LveBuffer>(
+				lveDevice,
+				sizeof(uint32_t),
+				1,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			VkDescriptorBufferInfo lightInfo = frame.lightBuffer->descriptorInfo();
+			VkDescriptorBufferInfo clusterInfo = frame.clusterBuffer->descriptorInfo();
+			VkDescriptorBufferInfo lightIndexInfo = frame.lightIndexBuffer->descriptorInfo();
+			VkDescriptorBufferInfo counterInfo = frame.counterBuffer->descriptorInfo();
+			LveDescriptorWriter(*setLayout, *descriptorPool)
+				.writeBuffer(0, &lightInfo)
+				.writeBuffer(1, &clusterInfo)
+				.writeBuffer(2, &lightIndexInfo)
+				.writeBuffer(3, &counterInfo)
+				.build(frame.descriptorSet);
+		}
+	}
+
+	void LveLightClusters::createPipeline()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(LightClusterPushConstants);
+
+		VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create light cluster pipeline layout!");
+		}
+
+		pipeline = std::make_unique<LveComputePipeline>(lveDevice, "shaders/light_cluster.comp.spv", pipelineLayout);
+	}
+
+	void LveLightClusters::begin(int frame)
+	{
+		frameIndex = frame;
+		lightCount = 0;
+		lights = static_cast<PointLight*>(frames[frameIndex].lightBuffer->getMappedMemory());
+	}
+
+	void LveLightClusters::addLight(const glm::vec3& position, const glm::vec3& color, float intensity)
+	{
+		assert(lightCount < maxLights && "Point lights exceed maximum specified!");
+
+		// distance squared falloff of the brightest channel reaches the cutoff at the range
+		float brightness = glm::max(color.r, glm::max(color.g, color.b)) * intensity;
+		float range = std::sqrt(glm::max(brightness, 0.0f) / LIGHT_CUTOFF);
+
+		PointLight& light = lights[lightCount++];
+		light.position = glm::vec4(position, range);
+		light.color = glm::vec4(color, intensity);
+	}
+
+	void LveLightClusters::record(VkCommandBuffer commandBuffer, const LveCamera& camera, VkExtent2D extent, GlobalUbo& ubo)
+	{
+		assert(camera.isPerspective() && "Light clusters need a perspective camera!");
+
+		FrameResources& resources = frames[frameIndex];
+		if (lightCount > 0) {
+			resources.lightBuffer->flush(lightCount * sizeof(PointLight));
+		}
+
+		// slice of view depth z is log(z / near) / log(far / near) * slices
+		float nearPlane = camera.getNear();
+		float farPlane = camera.getFar();
+		float logDepthRange = std::log(farPlane / nearPlane);
+		ubo.clusterCount = { CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z, lightCount };
+		ubo.clusterScale = {
+			CLUSTER_COUNT_X / static_cast<float>(extent.width),
+			CLUSTER_COUNT_Y / static_cast<float>(extent.height),
+			CLUSTER_COUNT_Z / logDepthRange,
+			-CLUSTER_COUNT_Z * std::log(nearPlane) / logDepthRange };
+
+		vkCmdFillBuffer(commandBuffer, resources.counterBuffer->getBuffer(), 0, sizeof(uint32_t), 0);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		pipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayout,
+			0,
+			1,
+			&resources.descriptorSet,
+			0,
+			nullptr);
+
+		const glm::mat4& projection = camera.getProjection();
+		LightClusterPushConstants push{};
+		push.view = camera.getView();
+		push.projection = { projection[0][0], projection[1][1], nearPlane, farPlane };
+		push.clusterCount = ubo.clusterCount;
+		push.lightIndexCapacity = CLUSTER_TOTAL * LIGHT_INDICES_PER_CLUSTER;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(commandBuffer, (CLUSTER_TOTAL + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+} // namespace lve
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_camera.hpp"
+#include "lve_descriptors.h"
+#include "lve_device.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_pipeline.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+
+namespace lve {
+
+	// Shading features of the lit pipelines, baked in as specialization constants of simple_shader.frag and
+	// deferred_lighting.frag. Each render system builds a variant per light loop and picks the cheapest one that
+	// can handle the frame's lights.
+	struct LveLightingOptions
+	{
+		// constant_id of each value in the shaders
+		static constexpr uint32_t LIGHT_LOOP_BOUND_ID = 0;
+		static constexpr uint32_t SPECULAR_ID = 1;
+		static constexpr uint32_t SPECULAR_EXPONENT_ID = 2;
+
+		// the dynamic loop runs to the cluster's light count, the small one has a fixed trip count the compiler can
+		// unroll and is used while the frame has no more than SMALL_LIGHT_LOOP lights
+		static constexpr uint32_t DYNAMIC_LIGHT_LOOP = 0;
+		static constexpr uint32_t SMALL_LIGHT_LOOP_VARIANT = 1;
+		static constexpr uint32_t LIGHT_LOOP_VARIANT_COUNT = 2;
+		static constexpr uint32_t SMALL_LIGHT_LOOP = 8;
+
+		bool specular = true;
+		float specularExponent = 512.0f;
+
+		// sets the constants of the options and of the light loop variant
+		void specialize(PipelineConfigInfo& configInfo, uint32_t lightLoopVariant) const;
+		// light loop variant for the lights of frameInfo, any cluster holds at most all of them
+		static uint32_t selectLightLoop(const FrameInfo& frameInfo);
+	};
+
+	// Point lights of a frame in a storage buffer, binned by a compute pass into a grid of view space clusters: screen
+	// tiles split into depth slices, exponentially so near and far clusters have similar proportions. A fragment only
+	// evaluates the lights of its cluster, so the cost follows the lights that reach it rather than all of them.
+	//
+	// Per frame: begin(), addLight() for each light, then record() outside of the render pass. The buffers are
+	// bindings 1 to 3 of the global descriptor set, sized once for maxLights.
+	class LveLightClusters {
+
+	public:
+		static constexpr uint32_t CLUSTER_COUNT_X = 16;
+		static constexpr uint32_t CLUSTER_COUNT_Y = 9;
+		static constexpr uint32_t CLUSTER_COUNT_Z = 24;
+		static constexpr uint32_t DEFAULT_MAX_LIGHTS = 4096;
+		// average lights per cluster the index buffer has room for, crowded clusters drop the rest
+		static constexpr uint32_t LIGHT_INDICES_PER_CLUSTER = 64;
+		// light level at which a light's range ends, its falloff is windowed to reach zero there
+		static constexpr float LIGHT_CUTOFF = 0.005f;
+
+		explicit LveLightClusters(LveDevice& device, uint32_t maxLights = DEFAULT_MAX_LIGHTS);
+		~LveLightClusters();
+
+		LveLightClusters(const LveLightClusters&) = delete;
+		LveLightClusters& operator=(const LveLightClusters&) = delete;
+
+		void begin(int frameIndex);
+		void addLight(const glm::vec3& position, const glm::vec3& color, float intensity);
+		// records the binning and fills the cluster fields of ubo, the camera has to be perspective
+		void record(VkCommandBuffer commandBuffer, const LveCamera& camera, VkExtent2D extent, GlobalUbo& ubo);
+
+		VkDescriptorBufferInfo lightBufferInfo(int frameIndex) const { return frames[frameIndex].lightBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo clusterBufferInfo(int frameIndex) const { return frames[frameIndex].clusterBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo lightIndexBufferInfo(int frameIndex) const { return frames[frameIndex].lightIndexBuffer->descriptorInfo(); }
+
+		uint32_t getLightCount() const { return lightCount; }
+		uint32_t getMaxLights() const { return maxLights; }
+
+	private:
+		struct FrameResources
+		{
+			std::unique_ptr<LveBuffer> lightBuffer;
+			std::unique_ptr<LveBuffer> clusterBuffer;
+			std::unique_ptr<LveBuffer> lightIndexBuffer;
+			std::unique_ptr<LveBuffer> counterBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+
+		void createFrameResources();
+		void createPipeline();
+
+		LveDevice& lveDevice;
+		uint32_t maxLights;
+
+		std::unique_ptr<LveDescriptorSetLayout> setLayout;
+		std::unique_ptr<LveDescriptorPool> descriptorPool;
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<LveComputePipeline> pipeline;
+
+		std::vector<FrameResources> frames;
+
+		int frameIndex = 0;
+		uint32_t lightCount = 0;
+		PointLight* lights = nullptr;
+	};
+
+} // namespace lve
@@ -0,0 +1,263 @@
+#include "lve_memory_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace lve {
+
+	LveMemoryAllocator::LveMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : device{ device }
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		bufferImageGranularity = properties.limits.bufferImageGranularity;
+		nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+
+		pools.resize(memoryProperties.memoryTypeCount * 2);
+		for (uint32_t i = 0; i < pools.size(); i++)
+		{
+			uint32_t memoryTypeIndex = i / 2;
+			VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+			pools[i].memoryTypeIndex = memoryTypeIndex;
+			pools[i].optimalImages = i % 2 == 1;
+			// small heaps (e.g. the 256 MB host visible device local one) get smaller blocks
+			pools[i].blockSize = std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+		}
+	}
+
+	LveMemoryAllocator::~LveMemoryAllocator()
+	{
+		for (auto& pool : pools)
+		{
+			for (auto& block : pool.blocks)
+			{
+				if (!block->ranges.empty()) {
+					std::cerr << "Memory block destroyed with " << block->ranges.getAllocationCount() << " live allocations" << std::endl;
+				}
+				if (block->mapped) {
+					vkUnmapMemory(device, block->memory);
+				}
+				vkFreeMemory(device, block->memory, nullptr);
+			}
+		}
+	}
+
+	uint32_t LveMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	LveMemoryAllocator::Block* LveMemoryAllocator::createBlock(uint32_t poolIndex, VkDeviceSize size, bool dedicated)
+	{
+		Pool& pool = pools[poolIndex];
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate device memory block!");
+		}
+
+		// host visible blocks stay mapped, a VkDeviceMemory can only be mapped once at a time
+		void* mapped = nullptr;
+		if (memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+				vkFreeMemory(device, memory, nullptr);
+				throw std::runtime_error("failed to map device memory block!");
+			}
+		}
+
+		pool.blocks.push_back(std::make_unique<Block>(memory, size, mapped, poolIndex, dedicated));
+		return pool.blocks.back().get();
+	}
+
+	void LveMemoryAllocator::destroyBlock(Block* block)
+	{
+		if (block->mapped) {
+			vkUnmapMemory(device, block->memory);
+		}
+		vkFreeMemory(device, block->memory, nullptr);
+
+		auto& blocks = pools[block->poolIndex].blocks;
+		blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const auto& b) { return b.get() == block; }));
+	}
+
+	LveAllocation LveMemoryAllocator::allocate(
+		const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalImage)
+	{
+		uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+		VkMemoryPropertyFlags typeFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+
+		// with a granularity of 1 buffers and images can share blocks safely
+		bool separateImages = optimalImage && bufferImageGranularity > 1;
+		uint32_t poolIndex = memoryTypeIndex * 2 + (separateImages ? 1 : 0);
+		Pool& pool = pools[poolIndex];
+
+		// flushes and invalidates are rounded to whole atoms, keep them from touching a neighbour
+		VkDeviceSize alignment = requirements.alignment;
+		if ((typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		Block* block = nullptr;
+		uint64_t offset = 0;
+		LveRangeAllocator::Handle range = LveRangeAllocator::INVALID_HANDLE;
+
+		// large resources get a block of their own instead of fragmenting the shared ones
+		if (requirements.size > pool.blockSize / 2)
+		{
+			VkDeviceSize dedicatedSize = (requirements.size + LveRangeAllocator::MIN_ALIGNMENT - 1) /
+				LveRangeAllocator::MIN_ALIGNMENT * LveRangeAllocator::MIN_ALIGNMENT;
+			block = createBlock(poolIndex, dedicatedSize, true);
+			block->ranges.allocate(requirements.size, 1, offset, range);
+		}
+		else
+		{
+			for (auto& candidate : pool.blocks)
+			{
+				if (!candidate->dedicated && candidate->ranges.allocate(requirements.size, alignment, offset, range)) {
+					block = candidate.get();
+					break;
+				}
+			}
+			if (block == nullptr)
+			{
+				block = createBlock(poolIndex, pool.blockSize, false);
+				if (!block->ranges.allocate(requirements.size, alignment, offset, range)) {
+					throw std::runtime_error("failed to sub-allocate device memory!");
+				}
+			}
+		}
+
+		LveAllocation allocation{};
+		allocation.memory = block->memory;
+		allocation.offset = offset;
+		allocation.size = requirements.size;
+		allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.block = block;
+		allocation.range = range;
+		return allocation;
+	}
+
+	void LveMemoryAllocator::free(LveAllocation& allocation)
+	{
+		if (allocation.block == nullptr) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		Block* block = static_cast<Block*>(allocation.block);
+		block->ranges.free(allocation.range);
+
+		if (block->ranges.empty())
+		{
+			// keep one empty shared block per pool so short lived staging buffers do not reallocate it
+			const auto& blocks = pools[block->poolIndex].blocks;
+			bool otherEmptyBlock = std::any_of(blocks.begin(), blocks.end(), [block](const auto& b) {
+				return b.get() != block && !b->dedicated && b->ranges.empty();
+			});
+			if (block->dedicated || otherEmptyBlock) {
+				destroyBlock(block);
+			}
+		}
+
+		allocation = LveAllocation{};
+	}
+
+	VkMappedMemoryRange LveMemoryAllocator::mappedRange(
+		const LveAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+	{
+		assert(allocation.block != nullptr && "Flushing an empty allocation!");
+		const Block* block = static_cast<const Block*>(allocation.block);
+
+		VkDeviceSize begin = allocation.offset + offset;
+		VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+
+		// ranges must be multiples of nonCoherentAtomSize or reach the end of the memory
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+		end = (end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+		range.size = end >= block->size ? VK_WHOLE_SIZE : end - range.offset;
+		return range;
+	}
+
+	VkResult LveMemoryAllocator::flush(const LveAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+	{
+		VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+		return vkFlushMappedMemoryRanges(device, 1, &range);
+	}
+
+	VkResult LveMemoryAllocator::invalidate(const LveAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+	{
+		VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+		return vkInvalidateMappedMemoryRanges(device, 1, &range);
+	}
+
+	void LveMemoryAllocator::addPoolStats(const Pool& pool, LveMemoryStats& stats)
+	{
+		for (const auto& block : pool.blocks)
+		{
+			stats.blockCount++;
+			stats.allocationCount += block->ranges.getAllocationCount();
+			stats.blockBytes += block->size;
+			stats.usedBytes += block->ranges.getUsedSize();
+			stats.largestFreeRange = std::max(stats.largestFreeRange, block->ranges.getLargestFreeRange());
+		}
+	}
+
+	LveMemoryStats LveMemoryAllocator::getStats() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		LveMemoryStats stats{};
+		for (const auto& pool : pools) {
+			addPoolStats(pool, stats);
+		}
+		return stats;
+	}
+
+	void LveMemoryAllocator::printStats() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		constexpr float MB = 1024.0f * 1024.0f;
+		for (const auto& pool : pools)
+		{
+			if (pool.blocks.empty()) continue;
+
+			LveMemoryStats stats{};
+			addPoolStats(pool, stats);
+
+			std::cout << "Memory type " << pool.memoryTypeIndex << (pool.optimalImages ? " (images): " : ": ")
+				<< stats.allocationCount << " allocations in " << stats.blockCount << " blocks, "
+				<< std::fixed << std::setprecision(2) << stats.usedBytes / MB << " / " << stats.blockBytes / MB << " MB used ("
+				<< stats.utilization() * 100.0f << "%), fragmentation " << stats.fragmentation() * 100.0f << "%"
+				<< std::defaultfloat << std::endl;
+		}
+	}
+
+} // namespace lve
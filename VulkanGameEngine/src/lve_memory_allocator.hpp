@@ -0,0 +1,107 @@
+#pragma once
+
+#include "lve_range_allocator.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace lve {
+
+	// A sub-allocated range of a VkDeviceMemory block
+	struct LveAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr; // points at offset when the memory is host visible, blocks stay mapped
+		uint32_t memoryTypeIndex = 0;
+
+		// owner of the range, used by LveMemoryAllocator::free
+		void* block = nullptr;
+		LveRangeAllocator::Handle range = LveRangeAllocator::INVALID_HANDLE;
+	};
+
+	struct LveMemoryStats
+	{
+		uint32_t blockCount = 0;          // live vkAllocateMemory allocations
+		uint32_t allocationCount = 0;     // live sub-allocations
+		VkDeviceSize blockBytes = 0;      // memory reserved from the driver
+		VkDeviceSize usedBytes = 0;       // memory handed out, including alignment
+		VkDeviceSize largestFreeRange = 0;
+
+		VkDeviceSize freeBytes() const { return blockBytes - usedBytes; }
+		float utilization() const { return blockBytes > 0 ? static_cast<float>(usedBytes) / blockBytes : 0.0f; }
+		// 0 when all free memory is one range, towards 1 when it is scattered in small ranges
+		float fragmentation() const { return freeBytes() > 0 ? 1.0f - static_cast<float>(largestFreeRange) / freeBytes() : 0.0f; }
+	};
+
+	// Sub-allocates buffers and images from large VkDeviceMemory blocks, one pool per memory type.
+	// Optimal tiling images get their own pools when bufferImageGranularity requires it, so linear
+	// and non-linear resources never share a granularity page.
+	class LveMemoryAllocator {
+
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+		LveMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+		~LveMemoryAllocator();
+
+		LveMemoryAllocator(const LveMemoryAllocator&) = delete;
+		LveMemoryAllocator& operator=(const LveMemoryAllocator&) = delete;
+
+		LveAllocation allocate(
+			const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalImage);
+		void free(LveAllocation& allocation);
+
+		// offset and size are relative to the allocation, VK_WHOLE_SIZE covers the rest of it
+		VkResult flush(const LveAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+		VkResult invalidate(const LveAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+
+		LveMemoryStats getStats() const;
+		void printStats() const;
+
+	private:
+		struct Block
+		{
+			VkDeviceMemory memory;
+			VkDeviceSize size;
+			void* mapped;
+			uint32_t poolIndex;
+			bool dedicated;
+			LveRangeAllocator ranges;
+
+			Block(VkDeviceMemory memory, VkDeviceSize size, void* mapped, uint32_t poolIndex, bool dedicated)
+				: memory{ memory }, size{ size }, mapped{ mapped }, poolIndex{ poolIndex }, dedicated{ dedicated }, ranges{ size } {}
+		};
+
+		struct Pool
+		{
+			uint32_t memoryTypeIndex;
+			bool optimalImages;
+			VkDeviceSize blockSize;
+			std::vector<std::unique_ptr<Block>> blocks;
+		};
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		Block* createBlock(uint32_t poolIndex, VkDeviceSize size, bool dedicated);
+		void destroyBlock(Block* block);
+		static void addPoolStats(const Pool& pool, LveMemoryStats& stats);
+		VkMappedMemoryRange mappedRange(const LveAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize bufferImageGranularity;
+		VkDeviceSize nonCoherentAtomSize;
+
+		// indexed by memoryTypeIndex * 2 + optimal image
+		std::vector<Pool> pools;
+		mutable std::mutex mutex;
+	};
+
+} // namespace lve
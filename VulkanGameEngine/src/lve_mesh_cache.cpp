@@ -0,0 +1,191 @@
+#include "lve_mesh_cache.hpp"
+
+// std
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace lve {
+
+	static uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~uint64_t{ 15 };
+	}
+
+	LveMeshFile::LveMeshFile(const std::string& filepath)
+	{
+#ifdef _WIN32
+		fileHandle = CreateFileA(
+			filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			fileHandle = nullptr;
+			throw std::runtime_error("Failed to open mesh cache: " + filepath);
+		}
+
+		LARGE_INTEGER fileSize{};
+		GetFileSizeEx(fileHandle, &fileSize);
+		size = static_cast<size_t>(fileSize.QuadPart);
+
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr) {
+			CloseHandle(fileHandle);
+			throw std::runtime_error("Failed to map mesh cache: " + filepath);
+		}
+		data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr) {
+			CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			throw std::runtime_error("Failed to map mesh cache: " + filepath);
+		}
+#else
+		fileDescriptor = open(filepath.c_str(), O_RDONLY);
+		if (fileDescriptor < 0) {
+			throw std::runtime_error("Failed to open mesh cache: " + filepath);
+		}
+
+		struct stat fileStat{};
+		fstat(fileDescriptor, &fileStat);
+		size = static_cast<size_t>(fileStat.st_size);
+
+		void* mapping = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) : MAP_FAILED;
+		if (mapping == MAP_FAILED) {
+			close(fileDescriptor);
+			throw std::runtime_error("Failed to map mesh cache: " + filepath);
+		}
+		data = static_cast<const uint8_t*>(mapping);
+#endif
+
+		try {
+			validate(filepath);
+		}
+		catch (...) {
+			unmap();
+			throw;
+		}
+	}
+
+	LveMeshFile::~LveMeshFile()
+	{
+		unmap();
+	}
+
+	void LveMeshFile::unmap()
+	{
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mappingHandle) CloseHandle(mappingHandle);
+		if (fileHandle) CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		if (data) munmap(const_cast<uint8_t*>(data), size);
+		if (fileDescriptor >= 0) close(fileDescriptor);
+		fileDescriptor = -1;
+#endif
+		data = nullptr;
+	}
+
+	void LveMeshFile::validate(const std::string& filepath) const
+	{
+		if (size < sizeof(LveMeshHeader)) {
+			throw std::runtime_error("Mesh cache is truncated: " + filepath);
+		}
+
+		const LveMeshHeader& h = header();
+		if (h.magic != LVEMESH_MAGIC || h.version != LVEMESH_VERSION) {
+			throw std::runtime_error("Mesh cache has an unsupported version: " + filepath);
+		}
+		if (h.attributeCount > LVEMESH_MAX_ATTRIBUTES) {
+			throw std::runtime_error("Mesh cache has an invalid vertex layout: " + filepath);
+		}
+		if (h.lodCount > LVEMESH_MAX_LODS) {
+			throw std::runtime_error("Mesh cache is corrupt: " + filepath);
+		}
+		for (uint32_t i = 0; i < h.lodCount; i++)
+		{
+			if (uint64_t{ h.lods[i].firstIndex } + h.lods[i].indexCount > h.indexCount) {
+				throw std::runtime_error("Mesh cache is corrupt: " + filepath);
+			}
+		}
+
+		uint64_t vertexEnd = h.vertexDataOffset + uint64_t{ h.vertexStride } * h.vertexCount;
+		uint64_t indexEnd = h.indexDataOffset + sizeof(uint32_t) * uint64_t{ h.indexCount };
+		if (h.vertexDataOffset % 16 != 0 || h.indexDataOffset % 16 != 0 || vertexEnd > size || indexEnd > size) {
+			throw std::runtime_error("Mesh cache is corrupt: " + filepath);
+		}
+	}
+
+	void LveMeshFile::write(
+		const std::string& filepath,
+		LveMeshHeader header,
+		const void* vertexData,
+		const uint32_t* indexData)
+	{
+		uint64_t vertexBytes = uint64_t{ header.vertexStride } * header.vertexCount;
+		uint64_t indexBytes = sizeof(uint32_t) * uint64_t{ header.indexCount };
+
+		header.magic = LVEMESH_MAGIC;
+		header.version = LVEMESH_VERSION;
+		header.vertexDataOffset = alignOffset(sizeof(LveMeshHeader));
+		header.indexDataOffset = alignOffset(header.vertexDataOffset + vertexBytes);
+
+		std::vector<char> padding(16, 0);
+		std::string tempPath = filepath + ".tmp";
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			if (!file.is_open()) {
+				throw std::runtime_error("Failed to write mesh cache: " + tempPath);
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(padding.data(), header.vertexDataOffset - sizeof(header));
+			file.write(static_cast<const char*>(vertexData), vertexBytes);
+			file.write(padding.data(), header.indexDataOffset - (header.vertexDataOffset + vertexBytes));
+			file.write(reinterpret_cast<const char*>(indexData), indexBytes);
+
+			if (!file.good()) {
+				file.close();
+				std::remove(tempPath.c_str());
+				throw std::runtime_error("Failed to write mesh cache: " + tempPath);
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, filepath, error);
+		if (error) {
+			std::remove(tempPath.c_str());
+			throw std::runtime_error("Failed to replace mesh cache: " + filepath + " (" + error.message() + ")");
+		}
+	}
+
+	bool LveMeshFile::isUpToDate(const std::string& cachePath, const std::string& sourcePath)
+	{
+		std::error_code error;
+		auto cacheTime = std::filesystem::last_write_time(cachePath, error);
+		if (error) {
+			return false;
+		}
+
+		auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+		if (error) {
+			return true;
+		}
+
+		return cacheTime >= sourceTime;
+	}
+
+} // namespace lve
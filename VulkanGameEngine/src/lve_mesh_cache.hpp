@@ -0,0 +1,91 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace lve {
+
+	// Binary mesh cache (.lvemesh) written next to the source model.
+	// Layout: LveMeshHeader | vertex data | index data, each section 16 byte aligned.
+	constexpr uint32_t LVEMESH_MAGIC = 0x4D45564C; // "LVEM"
+	// version 2: vertex and index order are optimized by LveModel::Builder::optimize
+	// version 3: LOD index ranges
+	constexpr uint32_t LVEMESH_VERSION = 3;
+	constexpr uint32_t LVEMESH_MAX_ATTRIBUTES = 8;
+	constexpr uint32_t LVEMESH_MAX_LODS = 8;
+
+	struct LveMeshAttribute
+	{
+		uint32_t location;
+		uint32_t format; // VkFormat
+		uint32_t offset;
+	};
+
+	// range of the index data drawn for one level of detail, all levels share the vertex data
+	struct LveMeshLod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error; // largest geometric deviation from the full mesh, in model units
+	};
+
+	struct LveMeshHeader
+	{
+		uint32_t magic = LVEMESH_MAGIC;
+		uint32_t version = LVEMESH_VERSION;
+		uint32_t vertexStride = 0;
+		uint32_t attributeCount = 0;
+		LveMeshAttribute attributes[LVEMESH_MAX_ATTRIBUTES]{};
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		uint32_t lodCount = 0;
+		LveMeshLod lods[LVEMESH_MAX_LODS]{};
+		float boundsMin[3]{};
+		float boundsMax[3]{};
+		uint64_t vertexDataOffset = 0;
+		uint64_t indexDataOffset = 0;
+	};
+
+	// Read-only memory mapping of a .lvemesh file
+	class LveMeshFile {
+
+	public:
+		explicit LveMeshFile(const std::string& filepath);
+		~LveMeshFile();
+
+		LveMeshFile(const LveMeshFile&) = delete;
+		LveMeshFile& operator=(const LveMeshFile&) = delete;
+
+		const LveMeshHeader& header() const { return *reinterpret_cast<const LveMeshHeader*>(data); }
+		const void* vertexData() const { return data + header().vertexDataOffset; }
+		const uint32_t* indexData() const { return reinterpret_cast<const uint32_t*>(data + header().indexDataOffset); }
+
+		// Writes to a temporary file first and renames it, so readers never see a partial cache
+		static void write(
+			const std::string& filepath,
+			LveMeshHeader header,
+			const void* vertexData,
+			const uint32_t* indexData);
+
+		// True if the cache exists and is not older than its source (a missing source counts as fresh)
+		static bool isUpToDate(const std::string& cachePath, const std::string& sourcePath);
+
+	private:
+		void validate(const std::string& filepath) const;
+		void unmap();
+
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+
+} // namespace lve
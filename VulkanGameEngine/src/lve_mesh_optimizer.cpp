@@ -0,0 +1,599 @@
+#include "lve_mesh_optimizer.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+
+namespace lve {
+
+	namespace {
+
+		// FIFO cache modelled with timestamps: a vertex is cached while fewer than cacheSize vertices were added after it
+		class CacheSimulator
+		{
+		public:
+			CacheSimulator(size_t vertexCount, uint32_t cacheSize)
+				: timestamps(vertexCount, 0), cacheSize{ cacheSize }, time{ cacheSize + 1 } {}
+
+			// returns 1 on a miss
+			uint32_t access(uint32_t vertex)
+			{
+				if (time - timestamps[vertex] > cacheSize) {
+					timestamps[vertex] = time++;
+					return 1;
+				}
+				return 0;
+			}
+
+			// empties the cache without touching every vertex
+			void flush() { time += cacheSize + 1; }
+
+		private:
+			std::vector<uint32_t> timestamps;
+			uint32_t cacheSize;
+			uint32_t time;
+		};
+
+		struct TriangleAdjacency
+		{
+			std::vector<uint32_t> counts;
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> triangles;
+
+			TriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+				: counts(vertexCount, 0), offsets(vertexCount + 1, 0), triangles(indices.size())
+			{
+				for (uint32_t index : indices) {
+					counts[index]++;
+				}
+				for (size_t v = 0; v < vertexCount; v++) {
+					offsets[v + 1] = offsets[v] + counts[v];
+				}
+
+				std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); i++) {
+					triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+		};
+
+	} // namespace
+
+	LveVertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3!");
+
+		LveVertexCacheStats stats{};
+		if (indices.empty() || vertexCount == 0) {
+			return stats;
+		}
+
+		CacheSimulator cache{ vertexCount, cacheSize };
+		uint32_t misses = 0;
+		for (uint32_t index : indices) {
+			misses += cache.access(index);
+		}
+
+		stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+		return stats;
+	}
+
+	std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3!");
+
+		std::vector<uint32_t> clusters{};
+		if (indices.empty()) {
+			return clusters;
+		}
+
+		TriangleAdjacency adjacency{ indices, vertexCount };
+		std::vector<uint32_t>& liveTriangles = adjacency.counts;
+
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		std::vector<bool> emitted(indices.size() / 3, false);
+		std::vector<uint32_t> deadEndStack{};
+		std::vector<uint32_t> candidates{};
+		std::vector<uint32_t> result{};
+		result.reserve(indices.size());
+
+		uint32_t timestamp = cacheSize + 1;
+		uint32_t cursor = 0;
+		uint32_t current = 0;
+		clusters.push_back(0);
+
+		while (current != UINT32_MAX)
+		{
+			// emit every remaining triangle around the fanning vertex
+			candidates.clear();
+			for (uint32_t i = adjacency.offsets[current]; i < adjacency.offsets[current + 1]; i++)
+			{
+				uint32_t triangle = adjacency.triangles[i];
+				if (emitted[triangle]) continue;
+				emitted[triangle] = true;
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = indices[triangle * 3 + corner];
+					result.push_back(vertex);
+					deadEndStack.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+
+					if (timestamp - cacheTimestamps[vertex] > cacheSize) {
+						cacheTimestamps[vertex] = timestamp++;
+					}
+				}
+			}
+
+			// prefer the oldest vertex that will still be cached after fanning it out
+			uint32_t next = UINT32_MAX;
+			int bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveTriangles[vertex] == 0) continue;
+
+				int priority = 0;
+				if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+					priority = static_cast<int>(timestamp - cacheTimestamps[vertex]);
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = vertex;
+				}
+			}
+
+			if (next == UINT32_MAX)
+			{
+				// dead end, continue from the most recent vertex with work left, else from any vertex
+				while (!deadEndStack.empty() && next == UINT32_MAX)
+				{
+					uint32_t vertex = deadEndStack.back();
+					deadEndStack.pop_back();
+					if (liveTriangles[vertex] > 0) next = vertex;
+				}
+				while (cursor < vertexCount && next == UINT32_MAX)
+				{
+					if (liveTriangles[cursor] > 0) next = cursor;
+					cursor++;
+				}
+
+				uint32_t emittedTriangles = static_cast<uint32_t>(result.size() / 3);
+				if (next != UINT32_MAX && emittedTriangles != clusters.back()) {
+					clusters.push_back(emittedTriangles);
+				}
+			}
+
+			current = next;
+		}
+
+		assert(result.size() == indices.size() && "Tipsify must emit every triangle!");
+		indices.swap(result);
+		return clusters;
+	}
+
+	void optimizeOverdraw(
+		std::vector<uint32_t>& indices,
+		const std::vector<uint32_t>& clusters,
+		const float* positions,
+		size_t positionStride,
+		size_t vertexCount,
+		float threshold,
+		uint32_t cacheSize)
+	{
+		uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0 || clusters.empty()) {
+			return;
+		}
+
+		// soft boundaries: cut a hard cluster wherever the part so far already misses little enough
+		// that starting the rest with a cold cache keeps the cluster within threshold of its ACMR
+		std::vector<uint32_t> softClusters{};
+		CacheSimulator cache{ vertexCount, cacheSize };
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			uint32_t begin = clusters[c];
+			uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+			cache.flush();
+			uint32_t clusterMisses = 0;
+			for (uint32_t i = begin * 3; i < end * 3; i++) {
+				clusterMisses += cache.access(indices[i]);
+			}
+			float missThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+			softClusters.push_back(begin);
+			cache.flush();
+			uint32_t misses = 0;
+			uint32_t triangles = 0;
+			for (uint32_t triangle = begin; triangle < end; triangle++)
+			{
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					misses += cache.access(indices[triangle * 3 + corner]);
+				}
+				triangles++;
+
+				if (triangle + 1 < end && static_cast<float>(misses) <= missThreshold * static_cast<float>(triangles))
+				{
+					softClusters.push_back(triangle + 1);
+					cache.flush();
+					misses = 0;
+					triangles = 0;
+				}
+			}
+		}
+
+		auto position = [&](uint32_t vertex) {
+			const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+			return glm::vec3{ p[0], p[1], p[2] };
+		};
+
+		// area weighted centroid and normal per cluster
+		size_t clusterCount = softClusters.size();
+		std::vector<glm::vec3> centroids(clusterCount, glm::vec3{ 0.0f });
+		std::vector<glm::vec3> normals(clusterCount, glm::vec3{ 0.0f });
+		std::vector<float> areas(clusterCount, 0.0f);
+		glm::vec3 meshCentroid{ 0.0f };
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < clusterCount; c++)
+		{
+			uint32_t end = c + 1 < clusterCount ? softClusters[c + 1] : triangleCount;
+			for (uint32_t triangle = softClusters[c]; triangle < end; triangle++)
+			{
+				glm::vec3 p0 = position(indices[triangle * 3 + 0]);
+				glm::vec3 p1 = position(indices[triangle * 3 + 1]);
+				glm::vec3 p2 = position(indices[triangle * 3 + 2]);
+
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				float area = glm::length(normal);
+
+				centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+				normals[c] += normal;
+				areas[c] += area;
+			}
+			meshCentroid += centroids[c];
+			meshArea += areas[c];
+		}
+		meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3{ 0.0f };
+
+		std::vector<float> sortKeys(clusterCount);
+		for (size_t c = 0; c < clusterCount; c++)
+		{
+			glm::vec3 centroid = areas[c] > 0.0f ? centroids[c] / areas[c] : meshCentroid;
+			float normalLength = glm::length(normals[c]);
+			glm::vec3 normal = normalLength > 0.0f ? normals[c] / normalLength : glm::vec3{ 0.0f };
+			sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<uint32_t> result{};
+		result.reserve(indices.size());
+		for (uint32_t c : order)
+		{
+			uint32_t end = c + 1 < clusterCount ? softClusters[c + 1] : triangleCount;
+			result.insert(result.end(), indices.begin() + softClusters[c] * 3, indices.begin() + end * 3);
+		}
+		indices.swap(result);
+	}
+
+	namespace {
+
+		// symmetric 4x4 error quadric of summed planes, plus the total area weight
+		struct Quadric
+		{
+			double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+			double b0 = 0, b1 = 0, b2 = 0, c = 0;
+			double weight = 0;
+
+			void addPlane(const glm::dvec3& n, double d, double w)
+			{
+				a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+				a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+				b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+				c += w * d * d;
+				weight += w;
+			}
+
+			void add(const Quadric& o)
+			{
+				a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+				b0 += o.b0; b1 += o.b1; b2 += o.b2; c += o.c;
+				weight += o.weight;
+			}
+
+			// area weighted mean squared distance of p to the planes
+			double error(const glm::dvec3& p) const
+			{
+				double e =
+					a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+					2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+					2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+				return weight > 0.0 ? std::abs(e) / weight : 0.0;
+			}
+		};
+
+		struct Collapse
+		{
+			uint32_t from;
+			uint32_t to;
+			double error;
+		};
+
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				uint32_t bits[3];
+				std::memcpy(bits, &p, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+
+	} // namespace
+
+	std::vector<uint32_t> simplifyMesh(
+		const std::vector<uint32_t>& indices,
+		const float* positions,
+		const float* normals,
+		size_t vertexStride,
+		size_t vertexCount,
+		size_t targetIndexCount,
+		float& error)
+	{
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3!");
+		error = 0.0f;
+
+		auto attribute = [vertexStride](const float* base, uint32_t vertex) {
+			const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(base) + vertex * vertexStride);
+			return glm::vec3{ p[0], p[1], p[2] };
+		};
+
+		// weld copies of a position (normal or uv seams) into one collapse vertex
+		std::vector<uint32_t> welded(vertexCount);
+		std::vector<uint32_t> nextCopy(vertexCount, UINT32_MAX);
+		{
+			std::unordered_map<glm::vec3, uint32_t, PositionHash> firstCopy{};
+			firstCopy.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				auto inserted = firstCopy.emplace(attribute(positions, v), v);
+				uint32_t first = inserted.first->second;
+				welded[v] = first;
+				if (!inserted.second) {
+					nextCopy[v] = nextCopy[first];
+					nextCopy[first] = v;
+				}
+			}
+		}
+
+		size_t triangleCount = indices.size() / 3;
+		std::vector<uint32_t> triangles(indices.size());
+		std::vector<bool> alive(triangleCount, true);
+		size_t aliveCount = triangleCount;
+		for (size_t i = 0; i < indices.size(); i++) {
+			triangles[i] = welded[indices[i]];
+		}
+
+		// open or non-manifold edges lock their vertices
+		std::vector<bool> locked(vertexCount, false);
+		{
+			std::unordered_map<uint64_t, uint32_t> edgeUses{};
+			edgeUses.reserve(indices.size());
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t a = triangles[t * 3 + k];
+					uint32_t b = triangles[t * 3 + (k + 1) % 3];
+					if (a == b) continue;
+					edgeUses[(uint64_t{ std::min(a, b) } << 32) | std::max(a, b)]++;
+				}
+			}
+			for (const auto& edge : edgeUses)
+			{
+				if (edge.second != 2) {
+					locked[edge.first >> 32] = true;
+					locked[edge.first & UINT32_MAX] = true;
+				}
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t a = triangles[t * 3 + 0];
+			uint32_t b = triangles[t * 3 + 1];
+			uint32_t c = triangles[t * 3 + 2];
+			if (a == b || b == c || c == a) {
+				alive[t] = false;
+				aliveCount--;
+				continue;
+			}
+
+			glm::dvec3 p0 = attribute(positions, a);
+			glm::dvec3 normal = glm::cross(glm::dvec3{ attribute(positions, b) } - p0, glm::dvec3{ attribute(positions, c) } - p0);
+			double area = glm::length(normal);
+			if (area <= 0.0) continue;
+
+			normal /= area;
+			Quadric plane{};
+			plane.addPlane(normal, -glm::dot(normal, p0), area);
+			quadrics[a].add(plane);
+			quadrics[b].add(plane);
+			quadrics[c].add(plane);
+		}
+
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency{};
+		std::vector<Collapse> collapses{};
+		std::vector<bool> touched(vertexCount);
+		double maxError = 0.0;
+
+		// each pass collapses the cheapest edges whose one-rings do not overlap, then rebuilds adjacency
+		while (aliveCount * 3 > targetIndexCount)
+		{
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				if (!alive[t]) continue;
+				for (int k = 0; k < 3; k++) adjacencyOffsets[triangles[t * 3 + k] + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++) {
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			}
+			adjacency.resize(adjacencyOffsets[vertexCount]);
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				if (!alive[t]) continue;
+				for (int k = 0; k < 3; k++) adjacency[fill[triangles[t * 3 + k]]++] = static_cast<uint32_t>(t);
+			}
+
+			collapses.clear();
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				if (!alive[t]) continue;
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t a = triangles[t * 3 + k];
+					uint32_t b = triangles[t * 3 + (k + 1) % 3];
+					if (a > b && !locked[a] && !locked[b]) continue; // interior edges are seen from both sides
+
+					Quadric merged = quadrics[a];
+					merged.add(quadrics[b]);
+					double errorAtA = locked[b] ? std::numeric_limits<double>::max() : merged.error(attribute(positions, a));
+					double errorAtB = locked[a] ? std::numeric_limits<double>::max() : merged.error(attribute(positions, b));
+					if (locked[a] && locked[b]) continue;
+
+					collapses.push_back(errorAtB <= errorAtA ? Collapse{ a, b, errorAtB } : Collapse{ b, a, errorAtA });
+				}
+			}
+			if (collapses.empty()) break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.error < r.error; });
+
+			// one collapse removes about two triangles
+			size_t needed = (aliveCount * 3 - targetIndexCount) / 6 + 1;
+			std::fill(touched.begin(), touched.end(), false);
+			size_t performed = 0;
+
+			for (const Collapse& collapse : collapses)
+			{
+				if (performed >= needed || aliveCount * 3 <= targetIndexCount) break;
+				if (touched[collapse.from] || touched[collapse.to]) continue;
+
+				// reject collapses that flip a remaining triangle around the moved vertex
+				glm::vec3 target = attribute(positions, collapse.to);
+				bool flips = false;
+				for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1] && !flips; i++)
+				{
+					uint32_t t = adjacency[i];
+					glm::vec3 p[3];
+					glm::vec3 moved[3];
+					bool degenerates = false;
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t v = triangles[t * 3 + k];
+						degenerates = degenerates || v == collapse.to;
+						p[k] = attribute(positions, v);
+						moved[k] = v == collapse.from ? target : p[k];
+					}
+					if (degenerates) continue;
+
+					glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+					flips = glm::dot(before, after) <= 0.0f;
+				}
+				if (flips) continue;
+
+				for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; i++)
+				{
+					uint32_t t = adjacency[i];
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t& v = triangles[t * 3 + k];
+						touched[v] = true;
+						if (v == collapse.from) v = collapse.to;
+					}
+					if (triangles[t * 3] == triangles[t * 3 + 1] || triangles[t * 3 + 1] == triangles[t * 3 + 2] ||
+						triangles[t * 3 + 2] == triangles[t * 3])
+					{
+						alive[t] = false;
+						aliveCount--;
+					}
+				}
+
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				maxError = std::max(maxError, collapse.error);
+				performed++;
+			}
+
+			if (performed == 0) break;
+		}
+
+		// map corners back to the copy of the surviving position whose normal matches best
+		std::vector<uint32_t> result{};
+		result.reserve(aliveCount * 3);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (!alive[t]) continue;
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t original = indices[t * 3 + k];
+				uint32_t position = triangles[t * 3 + k];
+				if (welded[original] == position) {
+					result.push_back(original);
+					continue;
+				}
+
+				uint32_t best = position;
+				if (normals != nullptr)
+				{
+					glm::vec3 normal = attribute(normals, original);
+					float bestDot = -2.0f;
+					for (uint32_t copy = position; copy != UINT32_MAX; copy = nextCopy[copy])
+					{
+						float d = glm::dot(normal, attribute(normals, copy));
+						if (d > bestDot) {
+							bestDot = d;
+							best = copy;
+						}
+					}
+				}
+				result.push_back(best);
+			}
+		}
+
+		error = static_cast<float>(std::sqrt(maxError));
+		return result;
+	}
+
+	uint32_t optimizeVertexFetchRemap(std::vector<uint32_t>& remap, const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		remap.assign(vertexCount, UINT32_MAX);
+
+		uint32_t nextVertex = 0;
+		for (uint32_t index : indices)
+		{
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = nextVertex++;
+			}
+		}
+		return nextVertex;
+	}
+
+} // namespace lve
@@ -0,0 +1,60 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace lve {
+
+	// FIFO post-transform cache size the optimizer targets and reports against
+	constexpr uint32_t LVE_VERTEX_CACHE_SIZE = 16;
+
+	struct LveVertexCacheStats
+	{
+		float acmr = 0.0f; // average cache miss ratio, transformed vertices per triangle (0.5 is ideal, 3 is worst)
+		float atvr = 0.0f; // average transformed vertex ratio, transformed vertices per vertex (1 is ideal)
+	};
+
+	// Simulates a FIFO post-transform cache over an indexed triangle list
+	LveVertexCacheStats analyzeVertexCache(
+		const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = LVE_VERTEX_CACHE_SIZE);
+
+	// Reorders triangles for the post-transform cache with Tipsify (Sander, Nehab, Barczak 2007).
+	// Returns the first triangle of every cluster that starts after a jump in the traversal, for optimizeOverdraw.
+	std::vector<uint32_t> optimizeVertexCache(
+		std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = LVE_VERTEX_CACHE_SIZE);
+
+	// Splits the clusters further wherever that costs less than threshold x their ACMR, then draws
+	// outward facing clusters first so they occlude the rest from most view directions.
+	// positions points at the first float3 position, positionStride is the distance between vertices in bytes.
+	void optimizeOverdraw(
+		std::vector<uint32_t>& indices,
+		const std::vector<uint32_t>& clusters,
+		const float* positions,
+		size_t positionStride,
+		size_t vertexCount,
+		float threshold = 1.05f,
+		uint32_t cacheSize = LVE_VERTEX_CACHE_SIZE);
+
+	// Quadric error edge collapse (Garland, Heckbert 1997) down to about targetIndexCount indices.
+	// Vertices only collapse onto other existing vertices, so every LOD can share one vertex buffer.
+	// Vertices with the same position collapse together, picking the target copy with the closest normal
+	// (normals may be null), and open borders are kept in place so the silhouette does not tear.
+	// error receives the largest collapse error as a distance in model units.
+	std::vector<uint32_t> simplifyMesh(
+		const std::vector<uint32_t>& indices,
+		const float* positions,
+		const float* normals,
+		size_t vertexStride,
+		size_t vertexCount,
+		size_t targetIndexCount,
+		float& error);
+
+	// Fills remap[oldIndex] = newIndex so vertices are stored in the order the indices first use them,
+	// unreferenced vertices map to UINT32_MAX. Returns the number of referenced vertices.
+	uint32_t optimizeVertexFetchRemap(
+		std::vector<uint32_t>& remap, const std::vector<uint32_t>& indices, size_t vertexCount);
+
+} // namespace lve
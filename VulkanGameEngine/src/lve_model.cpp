@@ -1,5 +1,8 @@
 #include "lve_model.hpp"
 
+#include "lve_mesh_optimizer.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_upload_queue.hpp"
 #include "lve_utils.hpp"
 
 // libs
@@ -8,10 +11,16 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 // std
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <unordered_map>
 
@@ -36,113 +45,126 @@ namespace std
 
 namespace lve {
 
-	LveModel::LveModel(LveDevice& device, const LveModel::Builder& builder) : lveDevice{ device }
+	LveModel::LveModel(LveDevice& device, const LveModel::Builder& source)
+		: lveDevice{ device },
+		vertexFormat{ source.vertexFormat }
 	{
-		createVertexBuffers(builder.vertices);
-		createIndexBuffers(builder.indices);
+		const auto* vertices = static_cast<const Vertex*>(source.vertexData());
+
+		// hand built meshes may never have computed their bounds, which culling, LOD selection and packing need
+		if (source.boundsComputed)
+		{
+			boundsMin = source.boundsMin;
+			boundsMax = source.boundsMax;
+			boundingRadius = source.boundingRadius;
+		}
+		else {
+			Builder::computeBounds(vertices, source.vertexCount(), boundsMin, boundsMax, boundingRadius);
+		}
+
+		positionDecode = Builder::positionDecode(vertexFormat, boundsMin, boundsMax);
+		if (vertexFormat != VertexFormat::Float)
+		{
+			// quantized positions may round outwards by up to a step across the bounds
+			boundingRadius += glm::length(boundsMax - boundsMin) * (1.0f / 1024.0f);
+		}
+
+		if (vertexFormat == VertexFormat::Float)
+		{
+			createGeometry(vertices, sizeof(Vertex), source.vertexCount(), source.indexData(), source.indexCount());
+		}
+		else
+		{
+			std::vector<PackedVertex> packedVertices = Builder::packVertices(
+				vertices, source.vertexCount(), vertexFormat, boundsMin, boundsMax);
+			createGeometry(packedVertices.data(), sizeof(PackedVertex), source.vertexCount(), source.indexData(), source.indexCount());
+		}
+
+		lods = source.lods;
+		if (lods.empty() && hasIndexBuffer) {
+			lods.push_back({ 0, indexCount, 0.0f });
+		}
 	}
 
 	LveModel::~LveModel()
 	{
+		// the copies may still be reading into our buffers
+		if (!uploaded) {
+			lveDevice.uploadQueue().wait(uploadTicket);
+		}
+		lveDevice.geometry().free(geometry);
+	}
+
+	bool LveModel::isReady()
+	{
+		if (!uploaded) {
+			uploaded = lveDevice.uploadQueue().isComplete(uploadTicket);
+		}
+		return uploaded;
 	}
 
-	std::unique_ptr<LveModel> LveModel::createModelFromFile(LveDevice& device, const std::string& filepath)
+	std::unique_ptr<LveModel> LveModel::createModelFromFile(
+		LveDevice& device, const std::string& filepath, VertexFormat vertexFormat)
 	{
 		Builder builder{};
 		builder.loadModel(filepath);
+		builder.vertexFormat = vertexFormat;
 
-		std::cout << "Vertex count: " << builder.vertices.size() << std::endl;
+		std::cout << "Vertex count: " << builder.vertexCount()
+			<< " (" << builder.vertexCount() * getVertexStride(vertexFormat) / 1024 << " KB)" << std::endl;
 
 		return std::make_unique<LveModel>(device, builder);
 	}
 
-	void LveModel::createVertexBuffers(const std::vector<Vertex>& vertices)
+	void LveModel::createGeometry(
+		const void* vertices, uint32_t vertexSize, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
 	{
-		vertexCount = static_cast<uint32_t>(vertices.size());
+		this->vertexCount = vertexCount;
 		assert(vertexCount >= 3 && "Vertex count must be at least 3!");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-
-		uint32_t vertexSize = sizeof(vertices[0]);
-
-		LveBuffer stagingBuffer{
-			lveDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		};
-
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
-
-		vertexBuffer = std::make_unique<LveBuffer>(
-			lveDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		lveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
-	}
-
-	void LveModel::createIndexBuffers(const std::vector<uint32_t>& indices)
-	{
-		indexCount = static_cast<uint32_t>(indices.size());
 
+		this->indexCount = indexCount;
 		hasIndexBuffer = indexCount > 0;
 
-		if (!hasIndexBuffer)
-		{
-			return;
-		}
-
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-
-		uint32_t indexSize = sizeof(indices[0]);
-
-		LveBuffer stagingBuffer{
-			lveDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		};
-
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
-
-		indexBuffer = std::make_unique<LveBuffer>(
-			lveDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		lveDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		geometry = lveDevice.geometry().allocate(vertexSize, vertexCount, indexCount);
+		uploadTicket = lveDevice.geometry().upload(geometry, vertices, indices);
 	}
 
 	void LveModel::bind(VkCommandBuffer commandBuffer)
 	{
-		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		lveDevice.geometry().bindVertexArena(commandBuffer, geometry.vertexArena);
 
 		if (hasIndexBuffer)
 		{
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			lveDevice.geometry().bindIndexArena(commandBuffer, geometry.indexArena);
 		}
 	}
 
-	void LveModel::draw(VkCommandBuffer commandBuffer)
+	void LveModel::draw(VkCommandBuffer commandBuffer, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance)
 	{
 		if (hasIndexBuffer)
 		{
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			assert(lod < lods.size() && "LOD out of range!");
+			vkCmdDrawIndexed(
+				commandBuffer,
+				lods[lod].indexCount,
+				instanceCount,
+				geometry.firstIndex + lods[lod].firstIndex,
+				static_cast<int32_t>(geometry.firstVertex),
+				firstInstance);
 		}
 		else
 		{
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, geometry.firstVertex, firstInstance);
+		}
+	}
+
+	uint32_t LveModel::selectLod(float maxError) const
+	{
+		uint32_t lod = 0;
+		while (lod + 1 < lods.size() && lods[lod + 1].error <= maxError) {
+			lod++;
 		}
+		return lod;
 	}
 
 	std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getBindingDescriptions()
@@ -166,73 +188,723 @@ namespace lve {
 		return attributeDescriptions;
 	}
 
+	uint32_t LveModel::getVertexStride(VertexFormat format)
+	{
+		return format == VertexFormat::Float ? sizeof(Vertex) : sizeof(PackedVertex);
+	}
+
+	std::vector<VkVertexInputBindingDescription> LveModel::getBindingDescriptions(VertexFormat format)
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions = Vertex::getBindingDescriptions();
+		bindingDescriptions[0].stride = getVertexStride(format);
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> LveModel::getAttributeDescriptions(VertexFormat format)
+	{
+		if (format == VertexFormat::Float)
+		{
+			return Vertex::getAttributeDescriptions();
+		}
+
+		// same locations as Vertex, the shader reads the normal as an octahedral vec2
+		VkFormat positionFormat =
+			format == VertexFormat::PackedHalf ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R16G16B16A16_SNORM;
+
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+		attributeDescriptions.push_back({ 0, 0, positionFormat, offsetof(PackedVertex, position) });
+		attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color) });
+		attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal) });
+		attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv) });
+
+		return attributeDescriptions;
+	}
+
 	void LveModel::Builder::loadModel(const std::string& filepath)
 	{
 		std::string enginePath = ENGINE_DIR + filepath;
+		std::string cachePath = meshCachePath(enginePath);
 
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
+		if (LveMeshFile::isUpToDate(cachePath, enginePath))
+		{
+			try {
+				loadMeshCache(cachePath);
+				return;
+			}
+			catch (const std::exception& e) {
+				std::cerr << "Mesh cache rejected, rebuilding: " << e.what() << std::endl;
+			}
+		}
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, enginePath.c_str()))
+		loadObjFile(enginePath);
+		optimize();
+		generateLods();
+
+		try {
+			writeMeshCache(cachePath);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+
+	static LveModel::Vertex makeVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
+	{
+		LveModel::Vertex vertex{};
+
+		if (index.vertex_index >= 0)
 		{
-			throw std::runtime_error(warn + err);
+			vertex.position = {
+				attrib.vertices[3 * index.vertex_index + 0],
+				attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2],
+			};
+
+			vertex.color = {
+				attrib.colors[3 * index.vertex_index + 0],
+				attrib.colors[3 * index.vertex_index + 1],
+				attrib.colors[3 * index.vertex_index + 2],
+			};
 		}
 
-		vertices.clear();
-		indices.clear();
+		if (index.normal_index >= 0)
+		{
+			vertex.normal = {
+				attrib.normals[3 * index.normal_index + 0],
+				attrib.normals[3 * index.normal_index + 1],
+				attrib.normals[3 * index.normal_index + 2],
+			};
+		}
+
+		if (index.texcoord_index >= 0)
+		{
+			vertex.uv = {
+				attrib.texcoords[2 * index.texcoord_index + 0],
+				attrib.texcoords[2 * index.texcoord_index + 1],
+			};
+		}
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		return vertex;
+	}
+
+	static void dedupVerticesSerial(
+		const tinyobj::attrib_t& attrib,
+		const std::vector<tinyobj::shape_t>& shapes,
+		std::vector<LveModel::Vertex>& vertices,
+		std::vector<uint32_t>& indices)
+	{
+		std::unordered_map<LveModel::Vertex, uint32_t> uniqueVertices{};
 
 		for (const auto& shape : shapes)
 		{
 			for (const auto& index : shape.mesh.indices)
 			{
-				Vertex vertex{};
+				LveModel::Vertex vertex = makeVertex(attrib, index);
 
-				if (index.vertex_index >= 0)
+				if (uniqueVertices.count(vertex) == 0)
 				{
-					vertex.position = {
-						attrib.vertices[3 * index.vertex_index + 0],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2],
-					};
-
-					vertex.color = {
-						attrib.colors[3 * index.vertex_index + 0],
-						attrib.colors[3 * index.vertex_index + 1],
-						attrib.colors[3 * index.vertex_index + 2],
-					};
+					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(vertex);
 				}
 
-				if (index.normal_index >= 0)
+				indices.push_back(uniqueVertices[vertex]);
+			}
+		}
+	}
+
+	// Hashes the raw bits of all 11 floats, much cheaper than std::hash<glm::vec*> + hashCombine
+	static uint32_t hashVertex(const LveModel::Vertex& vertex)
+	{
+		static_assert(sizeof(LveModel::Vertex) == 11 * sizeof(float), "Vertex must be tightly packed floats");
+
+		float values[11];
+		std::memcpy(values, &vertex, sizeof(values));
+
+		uint32_t hash = 2166136261u;
+		for (float value : values)
+		{
+			value += 0.0f; // -0.0f compares equal to 0.0f, so it has to hash the same
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			hash = (hash ^ bits) * 16777619u;
+		}
+
+		// murmur3 finalizer, shard and slot selection both need well mixed bits
+		hash ^= hash >> 16;
+		hash *= 0x85ebca6bu;
+		hash ^= hash >> 13;
+		hash *= 0xc2b2ae35u;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	// Produces exactly the output of dedupVerticesSerial (first occurrence order), in three steps:
+	// 1. build and hash every face corner in parallel
+	// 2. route corners to hash shards (keeping corner order) and find the first equal corner
+	//    of each one through a per-shard open addressing table, one shard per task
+	// 3. number the first occurrences in corner order and emit the index buffer
+	static void dedupVerticesSharded(
+		const tinyobj::attrib_t& attrib,
+		const std::vector<tinyobj::shape_t>& shapes,
+		LveThreadPool& pool,
+		std::vector<LveModel::Vertex>& vertices,
+		std::vector<uint32_t>& indices)
+	{
+		constexpr uint32_t SHARD_BITS = 6;
+		constexpr uint32_t SHARD_COUNT = 1u << SHARD_BITS;
+		constexpr uint32_t EMPTY_SLOT = ~0u;
+
+		std::vector<const tinyobj::index_t*> corners{};
+		for (const auto& shape : shapes)
+		{
+			for (const auto& index : shape.mesh.indices)
+			{
+				corners.push_back(&index);
+			}
+		}
+		uint32_t cornerCount = static_cast<uint32_t>(corners.size());
+
+		std::vector<LveModel::Vertex> cornerVertices(cornerCount);
+		std::vector<uint32_t> cornerHashes(cornerCount);
+
+		// ranges are fixed up front so the scatter below sees the same partition
+		uint32_t rangeCount = pool.getThreadCount() * 4;
+		std::vector<uint32_t> shardCounts(rangeCount * SHARD_COUNT, 0);
+
+		pool.parallelFor(rangeCount, [&](uint32_t rangeBegin, uint32_t rangeEnd) {
+			for (uint32_t range = rangeBegin; range < rangeEnd; range++)
+			{
+				uint32_t begin = static_cast<uint32_t>(uint64_t{ cornerCount } * range / rangeCount);
+				uint32_t end = static_cast<uint32_t>(uint64_t{ cornerCount } * (range + 1) / rangeCount);
+				for (uint32_t i = begin; i < end; i++)
 				{
-					vertex.normal = {
-						attrib.normals[3 * index.normal_index + 0],
-						attrib.normals[3 * index.normal_index + 1],
-						attrib.normals[3 * index.normal_index + 2],
-					};
+					cornerVertices[i] = makeVertex(attrib, *corners[i]);
+					cornerHashes[i] = hashVertex(cornerVertices[i]);
+					shardCounts[range * SHARD_COUNT + (cornerHashes[i] >> (32 - SHARD_BITS))]++;
 				}
+			}
+		});
 
-				if (index.texcoord_index >= 0)
+		// shard-major prefix sum: shard s holds its corners from range 0, then range 1, ...
+		std::vector<uint32_t> shardOffsets(rangeCount * SHARD_COUNT);
+		std::vector<uint32_t> shardBegin(SHARD_COUNT + 1, 0);
+		uint32_t offset = 0;
+		for (uint32_t shard = 0; shard < SHARD_COUNT; shard++)
+		{
+			shardBegin[shard] = offset;
+			for (uint32_t range = 0; range < rangeCount; range++)
+			{
+				shardOffsets[range * SHARD_COUNT + shard] = offset;
+				offset += shardCounts[range * SHARD_COUNT + shard];
+			}
+		}
+		shardBegin[SHARD_COUNT] = offset;
+
+		std::vector<uint32_t> shardCorners(cornerCount);
+		pool.parallelFor(rangeCount, [&](uint32_t rangeBegin, uint32_t rangeEnd) {
+			for (uint32_t range = rangeBegin; range < rangeEnd; range++)
+			{
+				uint32_t* cursor = &shardOffsets[range * SHARD_COUNT];
+				uint32_t begin = static_cast<uint32_t>(uint64_t{ cornerCount } * range / rangeCount);
+				uint32_t end = static_cast<uint32_t>(uint64_t{ cornerCount } * (range + 1) / rangeCount);
+				for (uint32_t i = begin; i < end; i++)
 				{
-					vertex.uv = {
-						attrib.texcoords[2 * index.texcoord_index + 0],
-						attrib.texcoords[2 * index.texcoord_index + 1],
-					};
+					shardCorners[cursor[cornerHashes[i] >> (32 - SHARD_BITS)]++] = i;
 				}
+			}
+		});
 
+		std::vector<uint32_t> firstCorner(cornerCount);
+		pool.parallelFor(SHARD_COUNT, [&](uint32_t shardRangeBegin, uint32_t shardRangeEnd) {
+			std::vector<uint32_t> slots{};
+			for (uint32_t shard = shardRangeBegin; shard < shardRangeEnd; shard++)
+			{
+				uint32_t size = shardBegin[shard + 1] - shardBegin[shard];
+				uint32_t capacity = 16;
+				while (capacity < size * 2) capacity *= 2;
+				slots.assign(capacity, EMPTY_SLOT);
 
-				if (uniqueVertices.count(vertex) == 0)
+				for (uint32_t k = shardBegin[shard]; k < shardBegin[shard + 1]; k++)
 				{
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
+					uint32_t corner = shardCorners[k];
+					uint32_t hash = cornerHashes[corner];
+					uint32_t slot = hash & (capacity - 1);
+
+					while (true)
+					{
+						uint32_t existing = slots[slot];
+						if (existing == EMPTY_SLOT)
+						{
+							slots[slot] = corner;
+							firstCorner[corner] = corner;
+							break;
+						}
+						if (cornerHashes[existing] == hash && cornerVertices[existing] == cornerVertices[corner])
+						{
+							firstCorner[corner] = existing;
+							break;
+						}
+						slot = (slot + 1) & (capacity - 1);
+					}
 				}
+			}
+		}, 1);
 
-				indices.push_back(uniqueVertices[vertex]);
+		std::vector<uint32_t> vertexIds(cornerCount);
+		indices.resize(cornerCount);
+		for (uint32_t i = 0; i < cornerCount; i++)
+		{
+			if (firstCorner[i] == i)
+			{
+				vertexIds[i] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(cornerVertices[i]);
+			}
+			indices[i] = vertexIds[firstCorner[i]];
+		}
+	}
+
+	struct ObjChunk
+	{
+		std::vector<float> positions{};
+		std::vector<float> colors{};
+		std::vector<float> normals{};
+		std::vector<float> texcoords{};
+		std::vector<tinyobj::index_t> corners{}; // 1-based as written in the file
+	};
+
+	// Parses the lines in [begin, end), which are already null terminated. Returns false on
+	// anything the parallel path does not reproduce exactly (polygons, relative indices, ...)
+	static bool parseObjChunk(char* begin, char* end, ObjChunk& chunk)
+	{
+		for (char* line = begin; line < end; line += std::strlen(line) + 1)
+		{
+			const char* token = line + std::strspn(line, " \t");
+
+			if (token[0] == '\0' || token[0] == '#') continue;
+
+			if (token[0] == 'v' && (token[1] == ' ' || token[1] == '\t'))
+			{
+				token += 2;
+				float x, y, z, r, g, b;
+				tinyobj::parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+				chunk.positions.insert(chunk.positions.end(), { x, y, z });
+				chunk.colors.insert(chunk.colors.end(), { r, g, b });
+			}
+			else if (token[0] == 'v' && token[1] == 'n' && (token[2] == ' ' || token[2] == '\t'))
+			{
+				token += 3;
+				float x, y, z;
+				tinyobj::parseReal3(&x, &y, &z, &token);
+				chunk.normals.insert(chunk.normals.end(), { x, y, z });
+			}
+			else if (token[0] == 'v' && token[1] == 't' && (token[2] == ' ' || token[2] == '\t'))
+			{
+				token += 3;
+				float x, y;
+				tinyobj::parseReal2(&x, &y, &token);
+				chunk.texcoords.insert(chunk.texcoords.end(), { x, y });
+			}
+			else if (token[0] == 'f' && (token[1] == ' ' || token[1] == '\t'))
+			{
+				token += 2;
+				int cornerCount = 0;
+				while (true)
+				{
+					token += std::strspn(token, " \t\r");
+					if (token[0] == '\0') break;
+
+					tinyobj::vertex_index_t vi = tinyobj::parseRawTriple(&token);
+					if (vi.v_idx <= 0 || vi.vn_idx < 0 || vi.vt_idx < 0 || ++cornerCount > 3) {
+						return false;
+					}
+					chunk.corners.push_back({ vi.v_idx, vi.vn_idx, vi.vt_idx });
+				}
+				if (cornerCount != 3) {
+					return false;
+				}
+			}
+			else if (
+				std::strncmp(token, "o", 1) != 0 && std::strncmp(token, "g", 1) != 0 &&
+				std::strncmp(token, "s", 1) != 0 && std::strncmp(token, "mtllib", 6) != 0 &&
+				std::strncmp(token, "usemtl", 6) != 0)
+			{
+				return false;
 			}
 		}
+		return true;
+	}
+
+	// Parallel replacement for tinyobj::LoadObj covering the triangle-only subset our exporters
+	// produce. Uses tinyobj's own number parsing so the resulting attributes are bit identical.
+	static bool parseObjParallel(
+		const std::string& path,
+		LveThreadPool& pool,
+		tinyobj::attrib_t& attrib,
+		std::vector<tinyobj::shape_t>& shapes)
+	{
+		std::ifstream file{ path, std::ios::ate | std::ios::binary };
+		if (!file.is_open()) {
+			return false;
+		}
+
+		std::vector<char> text(static_cast<size_t>(file.tellg()) + 1, '\0');
+		file.seekg(0);
+		file.read(text.data(), text.size() - 1);
+
+		// split into chunks that each end just past a newline, then terminate every line in place
+		char* textEnd = text.data() + text.size() - 1;
+		uint32_t chunkCount = pool.getThreadCount() * 4;
+		std::vector<char*> chunkBounds{ text.data() };
+		for (uint32_t i = 1; i < chunkCount; i++)
+		{
+			char* split = std::max(chunkBounds.back(), text.data() + (text.size() - 1) * i / chunkCount);
+			while (split < textEnd && *split != '\n') split++;
+			chunkBounds.push_back(std::min(split + 1, textEnd));
+		}
+		chunkBounds.push_back(textEnd);
+
+		std::vector<ObjChunk> chunks(chunkCount);
+		std::atomic<bool> supported{ true };
+		pool.parallelFor(chunkCount, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end && supported; i++)
+			{
+				std::replace_if(chunkBounds[i], chunkBounds[i + 1], [](char c) { return c == '\n' || c == '\r'; }, '\0');
+				if (!parseObjChunk(chunkBounds[i], chunkBounds[i + 1], chunks[i])) {
+					supported = false;
+				}
+			}
+		}, 1);
+
+		if (!supported) {
+			return false;
+		}
+
+		attrib = {};
+		shapes.assign(1, {});
+		auto& corners = shapes[0].mesh.indices;
+		for (const auto& chunk : chunks)
+		{
+			attrib.vertices.insert(attrib.vertices.end(), chunk.positions.begin(), chunk.positions.end());
+			attrib.colors.insert(attrib.colors.end(), chunk.colors.begin(), chunk.colors.end());
+			attrib.normals.insert(attrib.normals.end(), chunk.normals.begin(), chunk.normals.end());
+			attrib.texcoords.insert(attrib.texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+			corners.insert(corners.end(), chunk.corners.begin(), chunk.corners.end());
+		}
+
+		int positionCount = static_cast<int>(attrib.vertices.size() / 3);
+		int normalCount = static_cast<int>(attrib.normals.size() / 3);
+		int texcoordCount = static_cast<int>(attrib.texcoords.size() / 2);
+		for (auto& corner : corners)
+		{
+			if (corner.vertex_index > positionCount || corner.normal_index > normalCount || corner.texcoord_index > texcoordCount) {
+				return false;
+			}
+			corner.vertex_index -= 1;
+			corner.normal_index -= 1;
+			corner.texcoord_index -= 1;
+		}
+
+		return true;
+	}
+
+	void LveModel::Builder::loadObjFile(const std::string& path, uint32_t threadCount)
+	{
+		meshFile.reset();
+
+		std::unique_ptr<LveThreadPool> localPool{};
+		if (threadCount > 1) {
+			localPool = std::make_unique<LveThreadPool>(threadCount - 1);
+		}
+		LveThreadPool& pool = localPool ? *localPool : LveThreadPool::shared();
+
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		bool parsed = threadCount != 1 && parseObjParallel(path, pool, attrib, shapes);
+		if (!parsed && !tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+		{
+			throw std::runtime_error(warn + err);
+		}
+
+		vertices.clear();
+		indices.clear();
+		lods.clear();
+
+		size_t cornerCount = 0;
+		for (const auto& shape : shapes)
+		{
+			cornerCount += shape.mesh.indices.size();
+		}
+
+		if (threadCount == 1 || cornerCount < PARALLEL_LOAD_MIN_CORNERS)
+		{
+			dedupVerticesSerial(attrib, shapes, vertices, indices);
+		}
+		else
+		{
+			dedupVerticesSharded(attrib, shapes, pool, vertices, indices);
+		}
+
+		computeBounds();
+	}
+
+	void LveModel::Builder::loadMeshCache(const std::string& path)
+	{
+		auto file = std::make_shared<LveMeshFile>(path);
+		const LveMeshHeader& header = file->header();
+
+		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		bool layoutMatches =
+			header.vertexStride == sizeof(Vertex) &&
+			header.attributeCount == attributeDescriptions.size();
+		for (uint32_t i = 0; layoutMatches && i < header.attributeCount; i++)
+		{
+			layoutMatches =
+				header.attributes[i].location == attributeDescriptions[i].location &&
+				header.attributes[i].format == static_cast<uint32_t>(attributeDescriptions[i].format) &&
+				header.attributes[i].offset == attributeDescriptions[i].offset;
+		}
+		if (!layoutMatches) {
+			throw std::runtime_error("Mesh cache vertex layout does not match: " + path);
+		}
+
+		vertices.clear();
+		indices.clear();
+		lods.assign(header.lods, header.lods + header.lodCount);
+		meshFile = std::move(file);
+		boundsMin = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+		boundsMax = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+		boundsComputed = true;
+		computeBoundingRadius();
+	}
+
+	void LveModel::Builder::writeMeshCache(const std::string& path) const
+	{
+		LveMeshHeader header{};
+		header.vertexStride = sizeof(Vertex);
+		header.vertexCount = vertexCount();
+		header.indexCount = indexCount();
+
+		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		assert(attributeDescriptions.size() <= LVEMESH_MAX_ATTRIBUTES && "Too many vertex attributes for mesh cache!");
+		header.attributeCount = static_cast<uint32_t>(attributeDescriptions.size());
+		for (uint32_t i = 0; i < header.attributeCount; i++)
+		{
+			header.attributes[i] = {
+				attributeDescriptions[i].location,
+				static_cast<uint32_t>(attributeDescriptions[i].format),
+				attributeDescriptions[i].offset };
+		}
+
+		assert(lods.size() <= LVEMESH_MAX_LODS && "Too many LODs for mesh cache!");
+		header.lodCount = static_cast<uint32_t>(lods.size());
+		std::copy(lods.begin(), lods.end(), header.lods);
+
+		for (int i = 0; i < 3; i++)
+		{
+			header.boundsMin[i] = boundsMin[i];
+			header.boundsMax[i] = boundsMax[i];
+		}
+
+		LveMeshFile::write(path, header, vertexData(), indexData());
+	}
+
+	// distance of the farthest vertex from the center of the bounds
+	static float radiusAround(const LveModel::Vertex* vertices, uint32_t count, const glm::vec3& center)
+	{
+		float radiusSquared = 0.0f;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			glm::vec3 offset = vertices[i].position - center;
+			radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+		}
+		return glm::sqrt(radiusSquared);
+	}
+
+	void LveModel::Builder::computeBounds()
+	{
+		computeBounds(static_cast<const Vertex*>(vertexData()), vertexCount(), boundsMin, boundsMax, boundingRadius);
+		boundsComputed = true;
+	}
+
+	void LveModel::Builder::computeBoundingRadius()
+	{
+		boundingRadius = radiusAround(static_cast<const Vertex*>(vertexData()), vertexCount(), (boundsMin + boundsMax) * 0.5f);
+	}
+
+	void LveModel::Builder::computeBounds(
+		const Vertex* vertices, uint32_t count, glm::vec3& boundsMin, glm::vec3& boundsMax, float& boundingRadius)
+	{
+		boundsMin = count > 0 ? vertices[0].position : glm::vec3{};
+		boundsMax = boundsMin;
+		for (uint32_t i = 1; i < count; i++)
+		{
+			boundsMin = glm::min(boundsMin, vertices[i].position);
+			boundsMax = glm::max(boundsMax, vertices[i].position);
+		}
+		boundingRadius = radiusAround(vertices, count, (boundsMin + boundsMax) * 0.5f);
+	}
+
+	void LveModel::Builder::optimize()
+	{
+		assert(!meshFile && "Cached meshes are already optimized!");
+		assert(lods.empty() && "Optimize before generating LODs!");
+		if (indices.empty()) {
+			return;
+		}
+
+		std::vector<uint32_t> clusters = optimizeVertexCache(indices, vertices.size());
+		optimizeOverdraw(indices, clusters, &vertices[0].position.x, sizeof(Vertex), vertices.size());
+
+		std::vector<uint32_t> remap{};
+		uint32_t usedVertexCount = optimizeVertexFetchRemap(remap, indices, vertices.size());
+
+		std::vector<Vertex> remappedVertices(usedVertexCount);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			if (remap[i] != UINT32_MAX) {
+				remappedVertices[remap[i]] = vertices[i];
+			}
+		}
+		for (uint32_t& index : indices) {
+			index = remap[index];
+		}
+		vertices.swap(remappedVertices);
+	}
+
+	void LveModel::Builder::generateLods()
+	{
+		assert(!meshFile && "Cached meshes already contain their LODs!");
+		lods.clear();
+		if (indices.empty()) {
+			return;
+		}
+
+		const std::vector<uint32_t> fullIndices = indices;
+		lods.push_back({ 0, static_cast<uint32_t>(fullIndices.size()), 0.0f });
+
+		while (lods.size() < LVEMESH_MAX_LODS)
+		{
+			size_t targetIndexCount = lods.back().indexCount / 6 * 3;
+			if (targetIndexCount < MIN_LOD_TRIANGLES * 3) break;
+
+			// always simplify the full mesh so errors are measured against it
+			float error = 0.0f;
+			std::vector<uint32_t> lodIndices = simplifyMesh(
+				fullIndices, &vertices[0].position.x, &vertices[0].normal.x, sizeof(Vertex), vertices.size(), targetIndexCount, error);
+
+			// stop once the borders and seams the simplifier keeps dominate
+			if (lodIndices.size() > lods.back().indexCount * 3 / 4) break;
+
+			optimizeVertexCache(lodIndices, vertices.size());
+			lods.push_back({
+				static_cast<uint32_t>(indices.size()),
+				static_cast<uint32_t>(lodIndices.size()),
+				std::max(error, lods.back().error) });
+			indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+		}
+	}
+
+	// half size of the bounds, kept above zero so flat meshes do not divide by zero
+	static glm::vec3 quantizationExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		return glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3{ 1e-6f });
+	}
+
+	// maps a unit vector onto the octahedron unfolded into [-1, 1]^2, see the decode in simple_shader_packed.vert
+	static glm::vec2 octahedralEncode(const glm::vec3& normal)
+	{
+		float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		if (length == 0.0f) {
+			return glm::vec2{ 0.0f };
+		}
+
+		glm::vec2 encoded = glm::vec2{ normal.x, normal.y } / length;
+		if (normal.z < 0.0f)
+		{
+			glm::vec2 signs{ encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f };
+			encoded = (1.0f - glm::abs(glm::vec2{ encoded.y, encoded.x })) * signs;
+		}
+		return encoded;
+	}
+
+	std::vector<LveModel::PackedVertex> LveModel::Builder::packVertices(
+		const Vertex* vertices, uint32_t count, VertexFormat format, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay tightly packed");
+		assert(format != VertexFormat::Float && "Float vertices are uploaded unpacked!");
+
+		std::vector<PackedVertex> packed(count);
+
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		glm::vec3 inverseExtent = 1.0f / quantizationExtent(boundsMin, boundsMax);
+		bool halfPositions = format == VertexFormat::PackedHalf;
+
+		LveThreadPool::shared().parallelFor(count, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const Vertex& vertex = vertices[i];
+				PackedVertex& out = packed[i];
+
+				glm::vec3 position = glm::clamp((vertex.position - center) * inverseExtent, -1.0f, 1.0f);
+				for (int c = 0; c < 3; c++) {
+					out.position[c] = halfPositions ? glm::packHalf1x16(position[c]) : glm::packSnorm1x16(position[c]);
+				}
+				out.position[3] = 0;
+
+				glm::vec2 normal = octahedralEncode(vertex.normal);
+				out.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+				out.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+
+				for (int c = 0; c < 3; c++) {
+					out.color[c] = glm::packUnorm1x8(vertex.color[c]);
+				}
+				out.color[3] = 255;
+
+				out.uv[0] = glm::packHalf1x16(vertex.uv.x);
+				out.uv[1] = glm::packHalf1x16(vertex.uv.y);
+			}
+		}, 4096);
+
+		return packed;
+	}
+
+	glm::mat4 LveModel::Builder::positionDecode(VertexFormat format, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		if (format == VertexFormat::Float) {
+			return glm::mat4{ 1.0f };
+		}
+
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		return glm::scale(glm::translate(glm::mat4{ 1.0f }, center), quantizationExtent(boundsMin, boundsMax));
+	}
+
+	const void* LveModel::Builder::vertexData() const
+	{
+		return meshFile ? meshFile->vertexData() : vertices.data();
+	}
+
+	uint32_t LveModel::Builder::vertexCount() const
+	{
+		return meshFile ? meshFile->header().vertexCount : static_cast<uint32_t>(vertices.size());
+	}
+
+	const uint32_t* LveModel::Builder::indexData() const
+	{
+		return meshFile ? meshFile->indexData() : indices.data();
+	}
+
+	uint32_t LveModel::Builder::indexCount() const
+	{
+		return meshFile ? meshFile->header().indexCount : static_cast<uint32_t>(indices.size());
+	}
+
+	std::string LveModel::Builder::meshCachePath(const std::string& sourcePath)
+	{
+		return std::filesystem::path{ sourcePath }.replace_extension(".lvemesh").string();
 	}
 
 } // namespace lve
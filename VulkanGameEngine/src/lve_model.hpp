@@ -2,6 +2,8 @@
 
 #include "lve_device.hpp"
 #include "lve_buffer.hpp"
+#include "lve_geometry_buffer.hpp"
+#include "lve_mesh_cache.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -10,6 +12,7 @@
 
 // std
 #include <memory>
+#include <string>
 #include <vector>
 
 
@@ -34,11 +37,72 @@ namespace lve {
 			}
 		};
 
+		// Vertex layouts a model can be uploaded with, chosen per model when it is built
+		enum class VertexFormat : uint32_t {
+			Float,         // Vertex, 44 bytes
+			PackedHalf,    // PackedVertex with half float positions
+			PackedSnorm16, // PackedVertex with snorm16 positions
+		};
+		static constexpr uint32_t VERTEX_FORMAT_COUNT = 3;
+
+		// 20 byte vertex, positions are normalized to the mesh bounds and expanded again by getPositionDecode()
+		struct PackedVertex {
+			uint16_t position[4]; // xyz in [-1, 1] across the bounds, w unused
+			int16_t normal[2];    // octahedral encoded, snorm16
+			uint8_t color[4];     // unorm8, a unused
+			uint16_t uv[2];       // half float
+		};
+
 		struct Builder {
+			// smaller models are deduplicated on the calling thread
+			static constexpr size_t PARALLEL_LOAD_MIN_CORNERS = 1 << 14;
+			// LOD generation stops before a level would drop below this many triangles
+			static constexpr size_t MIN_LOD_TRIANGLES = 128;
+
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
+			// ranges of indices drawn per level of detail, empty means one level with all indices
+			std::vector<LveMeshLod> lods{};
+
+			// set when loaded from a .lvemesh cache, vertex and index data then stay in the mapping
+			std::shared_ptr<LveMeshFile> meshFile{};
 
+			glm::vec3 boundsMin{};
+			glm::vec3 boundsMax{};
+			// bounding sphere around the center of the bounds, usually well inside half the diagonal
+			float boundingRadius = 0.0f;
+			// false until computeBounds or a mesh cache set the bounds, LveModel computes them from the vertices then
+			bool boundsComputed = false;
+
+			VertexFormat vertexFormat = VertexFormat::Float;
+
+			// loads from the .lvemesh cache next to the model, regenerating it if the source is newer
 			void loadModel(const std::string& filepath);
+			// threadCount 0 uses the shared thread pool, 1 the single threaded tinyobj + std::unordered_map path
+			void loadObjFile(const std::string& path, uint32_t threadCount = 0);
+			void loadMeshCache(const std::string& path);
+			void writeMeshCache(const std::string& path) const;
+			void computeBounds();
+			void computeBoundingRadius();
+			static void computeBounds(
+				const Vertex* vertices, uint32_t count, glm::vec3& boundsMin, glm::vec3& boundsMax, float& boundingRadius);
+			// reorders triangles for the post-transform cache and overdraw, then vertices for fetch locality
+			void optimize();
+			// appends simplified copies of the indices, halving the triangle count per level
+			void generateLods();
+
+			// quantizes the vertices for the packed formats, relative to the given bounds
+			static std::vector<PackedVertex> packVertices(
+				const Vertex* vertices, uint32_t count, VertexFormat format, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+			// maps packed positions back to model space, identity for VertexFormat::Float
+			static glm::mat4 positionDecode(VertexFormat format, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+			const void* vertexData() const;
+			uint32_t vertexCount() const;
+			const uint32_t* indexData() const;
+			uint32_t indexCount() const;
+
+			static std::string meshCachePath(const std::string& sourcePath);
 		};
 
 		LveModel(LveDevice& device, const LveModel::Builder& builder);
@@ -47,23 +111,57 @@ namespace lve {
 		LveModel(const LveModel&) = delete;
 		LveModel& operator=(const LveModel&) = delete;
 
-		static std::unique_ptr<LveModel> createModelFromFile(LveDevice& device, const std::string& filepath);
-
+		static std::unique_ptr<LveModel> createModelFromFile(
+			LveDevice& device, const std::string& filepath, VertexFormat vertexFormat = VertexFormat::Float);
+
+		static uint32_t getVertexStride(VertexFormat format);
+		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat format);
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format);
+
+		VertexFormat getVertexFormat() const { return vertexFormat; }
+		uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+		// index range of a level, relative to the model's geometry allocation
+		const LveMeshLod& getLod(uint32_t lod) const { return lods[lod]; }
+		// coarsest level of detail whose error stays within maxError model units
+		uint32_t selectLod(float maxError) const;
+		// model space bounding box and sphere of the full resolution mesh
+		const glm::vec3& getBoundsMin() const { return boundsMin; }
+		const glm::vec3& getBoundsMax() const { return boundsMax; }
+		glm::vec3 getBoundingCenter() const { return (boundsMin + boundsMax) * 0.5f; }
+		float getBoundingRadius() const { return boundingRadius; }
+		// applied in front of the model matrix, the packed formats store positions relative to the mesh bounds
+		const glm::mat4& getPositionDecode() const { return positionDecode; }
+
+		// false until the vertex and index uploads have reached the GPU, skip drawing until then
+		bool isReady();
+
+		const LveGeometryAllocation& getGeometry() const { return geometry; }
+
+		// binds the geometry arenas holding this model, draw loops that share arenas can bind them once instead
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
 
 	private:
-		void createVertexBuffers(const std::vector<Vertex>& vertices);
-		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void createGeometry(const void* vertices, uint32_t vertexSize, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
 
 		LveDevice& lveDevice;
 
-		std::unique_ptr<LveBuffer> vertexBuffer;
+		VertexFormat vertexFormat;
+		glm::mat4 positionDecode{ 1.0f };
+		glm::vec3 boundsMin{};
+		glm::vec3 boundsMax{};
+		float boundingRadius;
+
+		// sub-range of the device's geometry buffer
+		LveGeometryAllocation geometry;
 		uint32_t vertexCount;
 
 		bool hasIndexBuffer = false;
-		std::unique_ptr<LveBuffer> indexBuffer;
 		uint32_t indexCount;
+		std::vector<LveMeshLod> lods;
+
+		uint64_t uploadTicket = 0;
+		bool uploaded = false;
 
 	};
 
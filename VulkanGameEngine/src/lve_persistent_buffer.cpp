@@ -0,0 +1,140 @@
+#include "lve_persistent_buffer.hpp"
+
+#include "lve_swap_chain.hpp"
+
+// std
+#include <cassert>
+
+
+namespace lve {
+
+	static constexpr uint32_t MIN_CAPACITY = 64;
+
+	LvePersistentBuffer::LvePersistentBuffer(LveDevice& device, VkDeviceSize elementSize, VkBufferUsageFlags usage)
+		: lveDevice{ device },
+		elementSize{ elementSize },
+		usage{ usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT }
+	{
+		stagingBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		retiredBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		buffer = std::make_unique<LveBuffer>(lveDevice, elementSize, MIN_CAPACITY, this->usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	void LvePersistentBuffer::begin(int frame, uint32_t newCount)
+	{
+		frameIndex = frame;
+		retiredBuffers[frameIndex].reset();
+		keptCount = 0;
+		stagedSize = 0;
+		copies.clear();
+
+		if (newCount > buffer->getInstanceCount())
+		{
+			uint32_t capacity = buffer->getInstanceCount();
+			while (capacity < newCount) {
+				capacity *= 2;
+			}
+
+			// the other frames in flight may still read the old buffer
+			keptCount = count;
+			retiredBuffers[frameIndex] = std::move(buffer);
+			buffer = std::make_unique<LveBuffer>(lveDevice, elementSize, capacity, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			generation++;
+		}
+		count = newCount;
+	}
+
+	void* LvePersistentBuffer::stage(const std::vector<uint32_t>& indices)
+	{
+		assert(stagedSize == 0 && "Elements are staged once per frame!");
+
+		uint32_t stagedCount = static_cast<uint32_t>(indices.size());
+		std::unique_ptr<LveBuffer>& staging = stagingBuffers[frameIndex];
+		if (staging == nullptr || staging->getInstanceCount() < stagedCount)
+		{
+			uint32_t capacity = staging != nullptr ? staging->getInstanceCount() : MIN_CAPACITY;
+			while (capacity < stagedCount) {
+				capacity *= 2;
+			}
+
+			// the frame that last used the staging buffer has finished
+			staging = std::make_unique<LveBuffer>(
+				lveDevice, elementSize, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			staging->map();
+		}
+
+		// neighbouring elements changed together, like a moving subtree, become one copy
+		for (uint32_t i = 0; i < stagedCount; i++)
+		{
+			assert(indices[i] < count && "Staged element is outside of the buffer!");
+			VkDeviceSize dstOffset = indices[i] * elementSize;
+			if (!copies.empty() && copies.back().dstOffset + copies.back().size == dstOffset) {
+				copies.back().size += elementSize;
+			}
+			else {
+				copies.push_back({ i * elementSize, dstOffset, elementSize });
+			}
+		}
+
+		stagedSize = stagedCount * elementSize;
+		return staging->getMappedMemory();
+	}
+
+	void LvePersistentBuffer::record(VkCommandBuffer commandBuffer, VkPipelineStageFlags readerStages, VkAccessFlags readerAccess)
+	{
+		if (keptCount == 0 && copies.empty()) {
+			return;
+		}
+
+		// after the earlier frames read the buffer and copied into it
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			readerStages | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		if (keptCount > 0)
+		{
+			VkBufferCopy copyRegion{ 0, 0, keptCount * elementSize };
+			vkCmdCopyBuffer(commandBuffer, retiredBuffers[frameIndex]->getBuffer(), buffer->getBuffer(), 1, &copyRegion);
+
+			// the staged elements overwrite some of the kept ones
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0,
+				1, &barrier,
+				0, nullptr,
+				0, nullptr);
+		}
+
+		if (!copies.empty())
+		{
+			LveBuffer& staging = *stagingBuffers[frameIndex];
+			staging.flush(stagedSize);
+			vkCmdCopyBuffer(
+				commandBuffer, staging.getBuffer(), buffer->getBuffer(), static_cast<uint32_t>(copies.size()), copies.data());
+		}
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = readerAccess;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			readerStages,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+} // namespace lve
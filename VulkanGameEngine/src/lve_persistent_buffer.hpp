@@ -0,0 +1,58 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+
+namespace lve {
+
+	// Device local array whose contents stay from frame to frame, so only the elements that changed are uploaded.
+	// Each frame in flight stages its writes in a host visible buffer of its own, and record() copies them over.
+	// Growing copies the contents on the GPU, and the replaced buffer is kept until its frame index comes round again.
+	//
+	// Per frame: begin(), stage() the changed elements, then record() outside of the render pass, also when nothing
+	// was staged, since growing needs the copy too.
+	class LvePersistentBuffer {
+
+	public:
+		LvePersistentBuffer(LveDevice& device, VkDeviceSize elementSize, VkBufferUsageFlags usage);
+
+		LvePersistentBuffer(const LvePersistentBuffer&) = delete;
+		LvePersistentBuffer& operator=(const LvePersistentBuffer&) = delete;
+
+		// the last frame with this index has finished, the first count elements are used from now on
+		void begin(int frameIndex, uint32_t count);
+		// staging memory for indices.size() elements, element i is copied to indices[i], once per frame
+		void* stage(const std::vector<uint32_t>& indices);
+		// records the copies, after the reads of earlier frames in readerStages and before the reads of this one
+		void record(VkCommandBuffer commandBuffer, VkPipelineStageFlags readerStages, VkAccessFlags readerAccess);
+
+		LveBuffer& getBuffer() { return *buffer; }
+		uint32_t getCount() const { return count; }
+		// changes whenever begin() replaced the buffer, descriptors of it need rewriting
+		uint32_t getGeneration() const { return generation; }
+
+	private:
+		LveDevice& lveDevice;
+		VkDeviceSize elementSize;
+		VkBufferUsageFlags usage;
+
+		std::unique_ptr<LveBuffer> buffer;
+		uint32_t count = 0;
+		uint32_t generation = 0;
+
+		int frameIndex = 0;
+		std::vector<std::unique_ptr<LveBuffer>> stagingBuffers;
+		// replaced buffers by the frame index that replaced them, the copy out of them may still be running
+		std::vector<std::unique_ptr<LveBuffer>> retiredBuffers;
+		// elements to copy from the buffer replaced this frame
+		uint32_t keptCount = 0;
+		VkDeviceSize stagedSize = 0;
+		std::vector<VkBufferCopy> copies;
+	};
+
+} // namespace lve
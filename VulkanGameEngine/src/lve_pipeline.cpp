@@ -1,7 +1,9 @@
 #include "lve_pipeline.hpp"
 
 #include "lve_model.hpp"
+#include "lve_pipeline_registry.hpp"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -18,21 +20,26 @@ namespace lve {
         LveDevice& device,
         const std::string& vertFilepath,
         const std::string& fragFilepath,
-        const PipelineConfigInfo& configInfo)
+        const PipelineConfigInfo& configInfo,
+        bool background)
         : lveDevice(device)
     {
-        createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+        variant = lveDevice.pipelines().requestGraphics(vertFilepath, fragFilepath, configInfo, background);
     }
 
-    LvePipeline::~LvePipeline()
+    // the variant is destroyed with its last user
+    LvePipeline::~LvePipeline() {}
+
+    bool LvePipeline::isReady() const
     {
-        vkDestroyShaderModule(lveDevice.device(), vertShaderModule, nullptr);
-        vkDestroyShaderModule(lveDevice.device(), fragShaderModule, nullptr);
-        vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
+        return variant->isReady();
     }
 
     void LvePipeline::bind(VkCommandBuffer commandBuffer)
     {
+        VkPipeline graphicsPipeline = variant->isReady() && variant->pipeline != VK_NULL_HANDLE
+            ? variant->pipeline
+            : lveDevice.pipelines().wait(*variant);
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
     }
 
@@ -56,102 +63,6 @@ namespace lve {
         return buffer;
     }
 
-    void LvePipeline::createGraphicsPipeline(
-        const std::string& vertFilepath,
-        const std::string& fragFilepath,
-        const PipelineConfigInfo& configInfo)
-    {
-        assert(
-            configInfo.pipelineLayout != VK_NULL_HANDLE && 
-            "Cannot create graphics pipeline: no pipelineLayout provided in configInfo!");
-
-        assert(
-            configInfo.renderPass != VK_NULL_HANDLE &&
-            "Cannot create graphics pipeline: no renderPass provided in configInfo!");
-
-        auto vertCode = readFile(vertFilepath);
-        auto fragCode = readFile(fragFilepath);
-
-        createShaderModule(vertCode, &vertShaderModule);
-        createShaderModule(fragCode, &fragShaderModule);
-
-        VkPipelineShaderStageCreateInfo shaderStages[2];
-
-        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-        shaderStages[0].module = vertShaderModule;
-        shaderStages[0].pName = "main";
-        shaderStages[0].flags = 0;
-        shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
-
-        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        shaderStages[1].module = fragShaderModule;
-        shaderStages[1].pName = "main";
-        shaderStages[1].flags = 0;
-        shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
-
-        // auto bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
-        // auto attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
-
-        auto& bindingDescriptions = configInfo.bindingDescriptions;
-        auto& attributeDescriptions = configInfo.attributeDescriptions;
-
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
-        pipelineInfo.pViewportState = &configInfo.viewportInfo;
-        pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
-        pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-        pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
-        pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
-        pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
-
-        pipelineInfo.layout = configInfo.pipelineLayout;
-        pipelineInfo.renderPass = configInfo.renderPass;
-        pipelineInfo.subpass = configInfo.subpass;
-
-        pipelineInfo.basePipelineIndex = -1;
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-        if (vkCreateGraphicsPipelines(
-            lveDevice.device(),
-            VK_NULL_HANDLE,
-            1,
-            &pipelineInfo,
-            nullptr,
-            &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create graphics pipeline!");
-        }
-
-
-
-    }
-
-    void LvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
-    {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-        if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create shader module!");
-        }
-    }
-
     void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
     {
         configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -239,4 +150,48 @@ namespace lve {
         configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
     }
 
+    void LvePipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value)
+    {
+        for (size_t i = 0; i < configInfo.specializationEntries.size(); i++)
+        {
+            if (configInfo.specializationEntries[i].constantID == constantId) {
+                configInfo.specializationData[i] = value;
+                return;
+            }
+        }
+
+        VkSpecializationMapEntry entry{};
+        entry.constantID = constantId;
+        entry.offset = static_cast<uint32_t>(configInfo.specializationData.size() * sizeof(uint32_t));
+        entry.size = sizeof(uint32_t);
+        configInfo.specializationEntries.push_back(entry);
+        configInfo.specializationData.push_back(value);
+    }
+
+    void LvePipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        setSpecializationConstant(configInfo, constantId, bits);
+    }
+
+    void LvePipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, bool value)
+    {
+        // SPIR-V booleans are specialized with a VkBool32
+        setSpecializationConstant(configInfo, constantId, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+    }
+
+    LveComputePipeline::LveComputePipeline(LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+        : lveDevice(device)
+    {
+        variant = lveDevice.pipelines().requestCompute(compFilepath, pipelineLayout);
+    }
+
+    LveComputePipeline::~LveComputePipeline() {}
+
+    void LveComputePipeline::bind(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, variant->pipeline);
+    }
+
 } // namespace lve
@@ -2,12 +2,15 @@
 
 #include "lve_device.hpp"
 
+#include <memory>
 #include <string>
 #include <vector>
 
 
 namespace lve {
 
+	struct LvePipelineVariant;
+
 	struct PipelineConfigInfo {
 		PipelineConfigInfo() = default;
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -21,6 +24,8 @@ namespace lve {
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo;
 		VkPipelineMultisampleStateCreateInfo multisampleInfo;
 		VkPipelineColorBlendAttachmentState colorBlendAttachment;
+		// color attachments of the subpass, all blended like colorBlendAttachment
+		uint32_t colorAttachmentCount = 1;
 		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 		std::vector<VkDynamicState> dynamicStateEnables;
@@ -28,8 +33,14 @@ namespace lve {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// specialization constants of both stages by constant_id, each a 4 byte value in specializationData
+		std::vector<VkSpecializationMapEntry> specializationEntries{};
+		std::vector<uint32_t> specializationData{};
 	};
 
+	// A graphics pipeline from the device's LvePipelineRegistry, shared with every other LvePipeline built from the
+	// same shaders and config. With background set it compiles on the shared thread pool and the constructor
+	// returns right away.
 	class LvePipeline {
 
 	public:
@@ -37,31 +48,48 @@ namespace lve {
 			LveDevice& device,
 			const std::string& vertFilepath,
 			const std::string& fragFilepath,
-			const PipelineConfigInfo& configInfo);
+			const PipelineConfigInfo& configInfo,
+			bool background = false);
 		~LvePipeline();
 
 		LvePipeline(const LvePipeline&) = delete;
 		LvePipeline& operator=(const LvePipeline&) = delete;
 
+		// false while compiling in the background, draws may be skipped until then instead of waiting in bind
+		bool isReady() const;
+		// waits for a background compile that has not finished yet
 		void bind(VkCommandBuffer commandBuffer);
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 		static void enableAlphaBlending(PipelineConfigInfo& configInfo);
+		// sets the value of a constant_id, every value is a different variant of the pipeline
+		static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value);
+		static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, float value);
+		static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, bool value);
 
-	private:
+		// reads a file relative to the engine directory, like the .spv shaders
 		static std::vector<char> readFile(const std::string& filepath);
 
-		void createGraphicsPipeline(
-			const std::string& vertFilepath,
-			const std::string& fragFilepath,
-			const PipelineConfigInfo& configInfo);
+	private:
+		LveDevice& lveDevice;
+		std::shared_ptr<LvePipelineVariant> variant;
+
+	};
+
+	class LveComputePipeline {
+
+	public:
+		LveComputePipeline(LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+		~LveComputePipeline();
 
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		LveComputePipeline(const LveComputePipeline&) = delete;
+		LveComputePipeline& operator=(const LveComputePipeline&) = delete;
 
+		void bind(VkCommandBuffer commandBuffer);
+
+	private:
 		LveDevice& lveDevice;
-		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		std::shared_ptr<LvePipelineVariant> variant;
 
 	};
 
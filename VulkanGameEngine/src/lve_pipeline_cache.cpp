@@ -0,0 +1,170 @@
+#include "lve_pipeline_cache.hpp"
+
+// std
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+
+namespace lve {
+
+	// leads the data of every pipeline cache, layout given by the Vulkan spec for VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+	struct PipelineCacheDataHeader
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	LvePipelineCache::LvePipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filepath)
+		: device{ device }, properties{ properties }, cachePath{ ENGINE_DIR + filepath }
+	{
+		std::vector<char> data = load();
+
+		VkPipelineCacheCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = data.size();
+		createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		VkResult result = vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache);
+		if (result != VK_SUCCESS && !data.empty())
+		{
+			// the driver has the last word on its own data, start over without it
+			std::cerr << "Pipeline cache rejected by the driver: " << cachePath << std::endl;
+			createInfo.initialDataSize = 0;
+			createInfo.pInitialData = nullptr;
+			data.clear();
+			result = vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache);
+		}
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+
+		loadedBytes = data.size();
+	}
+
+	LvePipelineCache::~LvePipelineCache()
+	{
+		try {
+			save();
+		}
+		catch (const std::exception& e) {
+			// the next run just starts cold
+			std::cerr << e.what() << std::endl;
+		}
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
+	}
+
+	std::vector<char> LvePipelineCache::load() const
+	{
+		std::ifstream file{ cachePath, std::ios::binary | std::ios::ate };
+		if (!file.is_open()) {
+			return {};
+		}
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		LvePipelineCacheHeader header{};
+		if (fileSize < sizeof(header)) {
+			std::cerr << "Pipeline cache rejected, truncated: " << cachePath << std::endl;
+			return {};
+		}
+
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		// written for another device, driver or cache version, expected after driver updates so not reported
+		if (!isCompatible(header)) {
+			return {};
+		}
+		if (header.dataSize != fileSize - sizeof(header)) {
+			std::cerr << "Pipeline cache rejected, size does not match its header: " << cachePath << std::endl;
+			return {};
+		}
+
+		std::vector<char> data(header.dataSize);
+		file.read(data.data(), data.size());
+		if (!file.good()) {
+			std::cerr << "Pipeline cache rejected, failed to read: " << cachePath << std::endl;
+			return {};
+		}
+
+		// the driver's own header leads the data, some drivers do not check it themselves
+		PipelineCacheDataHeader dataHeader{};
+		if (data.size() < sizeof(dataHeader)) {
+			return {};
+		}
+		std::memcpy(&dataHeader, data.data(), sizeof(dataHeader));
+		if (dataHeader.headerSize < sizeof(dataHeader) ||
+			dataHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+			dataHeader.vendorID != properties.vendorID ||
+			dataHeader.deviceID != properties.deviceID ||
+			std::memcmp(dataHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			std::cerr << "Pipeline cache rejected, data does not match the device: " << cachePath << std::endl;
+			return {};
+		}
+
+		return data;
+	}
+
+	bool LvePipelineCache::isCompatible(const LvePipelineCacheHeader& header) const
+	{
+		return header.magic == LVE_PIPELINE_CACHE_MAGIC &&
+			header.version == LVE_PIPELINE_CACHE_VERSION &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			header.driverVersion == properties.driverVersion &&
+			std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	void LvePipelineCache::save() const
+	{
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+			return;
+		}
+		std::vector<char> data(dataSize);
+		if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to get pipeline cache data!");
+		}
+
+		LvePipelineCacheHeader header{};
+		header.dataSize = dataSize;
+		header.vendorID = properties.vendorID;
+		header.deviceID = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+		std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			if (!file.is_open()) {
+				throw std::runtime_error("Failed to write pipeline cache: " + tempPath);
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(data.data(), dataSize);
+
+			if (!file.good()) {
+				file.close();
+				std::remove(tempPath.c_str());
+				throw std::runtime_error("Failed to write pipeline cache: " + tempPath);
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error) {
+			std::remove(tempPath.c_str());
+			throw std::runtime_error("Failed to replace pipeline cache: " + cachePath + " (" + error.message() + ")");
+		}
+	}
+
+} // namespace lve
@@ -0,0 +1,61 @@
+#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace lve {
+
+	// Pipeline cache file: LvePipelineCacheHeader | vkGetPipelineCacheData bytes
+	constexpr uint32_t LVE_PIPELINE_CACHE_MAGIC = 0x4350564C; // "LVPC"
+	constexpr uint32_t LVE_PIPELINE_CACHE_VERSION = 1;
+
+	struct LvePipelineCacheHeader
+	{
+		uint32_t magic = LVE_PIPELINE_CACHE_MAGIC;
+		uint32_t version = LVE_PIPELINE_CACHE_VERSION;
+		uint64_t dataSize = 0;
+		// the data is only valid for the device and driver that produced it
+		uint32_t vendorID = 0;
+		uint32_t deviceID = 0;
+		uint32_t driverVersion = 0;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE]{};
+	};
+
+	// VkPipelineCache that all pipelines are created with, loaded from disk when the file was written for the same
+	// device and driver and saved back when destroyed. A missing, stale or damaged file only costs a cold start.
+	class LvePipelineCache {
+
+	public:
+		// filepath is relative to the engine directory, like the shaders
+		LvePipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filepath);
+		~LvePipelineCache();
+
+		LvePipelineCache(const LvePipelineCache&) = delete;
+		LvePipelineCache& operator=(const LvePipelineCache&) = delete;
+
+		VkPipelineCache getPipelineCache() const { return pipelineCache; }
+		// true when the pipelines of an earlier run were loaded
+		bool isWarm() const { return loadedBytes > 0; }
+
+		// writes to a temporary file first and renames it, so a crash never leaves a partial cache behind
+		void save() const;
+
+	private:
+		// empty when the file is missing or was written for another device or driver
+		std::vector<char> load() const;
+		bool isCompatible(const LvePipelineCacheHeader& header) const;
+
+		VkDevice device;
+		VkPhysicalDeviceProperties properties;
+		std::string cachePath;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		size_t loadedBytes = 0;
+	};
+
+} // namespace lve
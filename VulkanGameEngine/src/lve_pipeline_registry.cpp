@@ -0,0 +1,372 @@
+#include "lve_pipeline_registry.hpp"
+
+#include "lve_thread_pool.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+
+namespace lve {
+
+	// Appends the bytes of each value to a key. Only fields that reach the pipeline are appended, never pointers,
+	// so equal keys mean equal pipelines.
+	class PipelineKeyWriter {
+
+	public:
+		template<typename T>
+		PipelineKeyWriter& add(const T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Pipeline keys are built from plain values");
+			key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+			return *this;
+		}
+
+		template<typename T>
+		PipelineKeyWriter& addAll(const std::vector<T>& values)
+		{
+			add(static_cast<uint32_t>(values.size()));
+			for (const T& value : values) {
+				add(value);
+			}
+			return *this;
+		}
+
+		PipelineKeyWriter& addString(const std::string& value)
+		{
+			add(static_cast<uint32_t>(value.size()));
+			key += value;
+			return *this;
+		}
+
+		std::string key;
+	};
+
+	static std::string graphicsPipelineKey(
+		const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo)
+	{
+		PipelineKeyWriter writer{};
+		writer.addString(vertFilepath).addString(fragFilepath);
+
+		// the description structs hold plain integers only
+		writer.addAll(configInfo.bindingDescriptions).addAll(configInfo.attributeDescriptions);
+
+		const auto& inputAssembly = configInfo.inputAssemblyInfo;
+		writer.add(inputAssembly.topology).add(inputAssembly.primitiveRestartEnable);
+
+		writer.add(configInfo.viewportInfo.viewportCount).add(configInfo.viewportInfo.scissorCount);
+
+		const auto& rasterization = configInfo.rasterizationInfo;
+		writer.add(rasterization.depthClampEnable).add(rasterization.rasterizerDiscardEnable)
+			.add(rasterization.polygonMode).add(rasterization.cullMode).add(rasterization.frontFace)
+			.add(rasterization.depthBiasEnable).add(rasterization.depthBiasConstantFactor)
+			.add(rasterization.depthBiasClamp).add(rasterization.depthBiasSlopeFactor).add(rasterization.lineWidth);
+
+		const auto& multisample = configInfo.multisampleInfo;
+		assert(multisample.pSampleMask == nullptr && "Sample masks are not part of pipeline keys!");
+		writer.add(multisample.rasterizationSamples).add(multisample.sampleShadingEnable)
+			.add(multisample.minSampleShading).add(multisample.alphaToCoverageEnable).add(multisample.alphaToOneEnable);
+
+		writer.add(configInfo.colorBlendAttachment).add(configInfo.colorAttachmentCount);
+		writer.add(configInfo.colorBlendInfo.logicOpEnable).add(configInfo.colorBlendInfo.logicOp)
+			.add(configInfo.colorBlendInfo.blendConstants);
+
+		const auto& depthStencil = configInfo.depthStencilInfo;
+		writer.add(depthStencil.depthTestEnable).add(depthStencil.depthWriteEnable).add(depthStencil.depthCompareOp)
+			.add(depthStencil.depthBoundsTestEnable).add(depthStencil.stencilTestEnable)
+			.add(depthStencil.front).add(depthStencil.back)
+			.add(depthStencil.minDepthBounds).add(depthStencil.maxDepthBounds);
+
+		writer.addAll(configInfo.dynamicStateEnables);
+
+		writer.add(configInfo.pipelineLayout).add(configInfo.renderPass).add(configInfo.subpass);
+		writer.addAll(configInfo.specializationEntries).addAll(configInfo.specializationData);
+		return writer.key;
+	}
+
+	// PipelineConfigInfo points into itself, so a copy has to point into the copy
+	static void copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst)
+	{
+		dst.bindingDescriptions = src.bindingDescriptions;
+		dst.attributeDescriptions = src.attributeDescriptions;
+		dst.viewportInfo = src.viewportInfo;
+		dst.inputAssemblyInfo = src.inputAssemblyInfo;
+		dst.rasterizationInfo = src.rasterizationInfo;
+		dst.multisampleInfo = src.multisampleInfo;
+		dst.colorBlendAttachment = src.colorBlendAttachment;
+		dst.colorAttachmentCount = src.colorAttachmentCount;
+		dst.colorBlendInfo = src.colorBlendInfo;
+		dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+		dst.depthStencilInfo = src.depthStencilInfo;
+		dst.dynamicStateEnables = src.dynamicStateEnables;
+		dst.dynamicStateInfo = src.dynamicStateInfo;
+		dst.dynamicStateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+		dst.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dst.dynamicStateEnables.size());
+		dst.pipelineLayout = src.pipelineLayout;
+		dst.renderPass = src.renderPass;
+		dst.subpass = src.subpass;
+		dst.specializationEntries = src.specializationEntries;
+		dst.specializationData = src.specializationData;
+	}
+
+	LvePipelineVariant::~LvePipelineVariant()
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+
+	LvePipelineRegistry::LvePipelineRegistry(LveDevice& device)
+		: lveDevice{ device }
+	{
+	}
+
+	LvePipelineRegistry::~LvePipelineRegistry()
+	{
+		waitIdle();
+		for (auto& kv : shaderModules) {
+			vkDestroyShaderModule(lveDevice.device(), kv.second, nullptr);
+		}
+	}
+
+	bool LvePipelineRegistry::findOrInsert(const std::string& key, std::shared_ptr<LvePipelineVariant>& variant)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto it = variants.find(key);
+		if (it != variants.end()) {
+			variant = it->second.lock();
+			if (variant != nullptr) {
+				reuseCount.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		}
+
+		// not ready until whoever inserted it compiled it
+		variant = std::make_shared<LvePipelineVariant>(lveDevice.device());
+		variant->pending.store(1, std::memory_order_relaxed);
+		variants[key] = variant;
+		compileCount.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	std::shared_ptr<LvePipelineVariant> LvePipelineRegistry::requestGraphics(
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		const PipelineConfigInfo& configInfo,
+		bool background)
+	{
+		assert(
+			configInfo.pipelineLayout != VK_NULL_HANDLE &&
+			"Cannot create graphics pipeline: no pipelineLayout provided in configInfo!");
+
+		assert(
+			configInfo.renderPass != VK_NULL_HANDLE &&
+			"Cannot create graphics pipeline: no renderPass provided in configInfo!");
+
+		std::shared_ptr<LvePipelineVariant> variant;
+		if (!findOrInsert(graphicsPipelineKey(vertFilepath, fragFilepath, configInfo), variant))
+		{
+			if (!background) {
+				wait(*variant);
+			}
+			return variant;
+		}
+
+		if (!background) {
+			compileGraphics(*variant, vertFilepath, fragFilepath, configInfo);
+			wait(*variant);
+			return variant;
+		}
+
+		// the caller's config may be gone by the time the task runs
+		auto config = std::make_shared<PipelineConfigInfo>();
+		copyConfigInfo(configInfo, *config);
+		LveThreadPool::shared().submit([this, variant, vertFilepath, fragFilepath, config] {
+			compileGraphics(*variant, vertFilepath, fragFilepath, *config);
+		}, pendingCompiles);
+		return variant;
+	}
+
+	std::shared_ptr<LvePipelineVariant> LvePipelineRegistry::requestCompute(const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+		PipelineKeyWriter writer{};
+		writer.addString("compute").addString(compFilepath).add(pipelineLayout);
+
+		std::shared_ptr<LvePipelineVariant> variant;
+		if (findOrInsert(writer.key, variant))
+		{
+			try {
+				VkComputePipelineCreateInfo pipelineInfo{};
+				pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+				pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+				pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+				pipelineInfo.stage.module = getShaderModule(compFilepath);
+				pipelineInfo.stage.pName = "main";
+				pipelineInfo.layout = pipelineLayout;
+				pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+				pipelineInfo.basePipelineIndex = -1;
+
+				if (vkCreateComputePipelines(lveDevice.device(), lveDevice.pipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &variant->pipeline) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create compute pipeline!");
+				}
+			}
+			catch (const std::exception& e) {
+				variant->pipeline = VK_NULL_HANDLE;
+				variant->error = e.what();
+			}
+			variant->pending.store(0, std::memory_order_release);
+		}
+
+		wait(*variant);
+		return variant;
+	}
+
+	VkPipeline LvePipelineRegistry::wait(const LvePipelineVariant& variant)
+	{
+		while (!variant.isReady())
+		{
+			if (pendingCompiles.load(std::memory_order_acquire) > 0) {
+				LveThreadPool::shared().wait(pendingCompiles);
+			}
+			else {
+				// being compiled on the thread that requested it first
+				std::this_thread::yield();
+			}
+		}
+
+		if (variant.pipeline == VK_NULL_HANDLE) {
+			throw std::runtime_error(variant.error);
+		}
+		return variant.pipeline;
+	}
+
+	void LvePipelineRegistry::waitIdle()
+	{
+		LveThreadPool::shared().wait(pendingCompiles);
+	}
+
+	VkShaderModule LvePipelineRegistry::getShaderModule(const std::string& filepath)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			auto it = shaderModules.find(filepath);
+			if (it != shaderModules.end()) {
+				return it->second;
+			}
+		}
+
+		// read outside of the lock, another thread may create the same module meanwhile
+		auto code = LvePipeline::readFile(filepath);
+
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shader module!");
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto inserted = shaderModules.emplace(filepath, shaderModule);
+		if (!inserted.second) {
+			vkDestroyShaderModule(lveDevice.device(), shaderModule, nullptr);
+		}
+		return inserted.first->second;
+	}
+
+	void LvePipelineRegistry::compileGraphics(
+		LvePipelineVariant& variant,
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		const PipelineConfigInfo& configInfo)
+	{
+		// may run on a worker, failures are handed to whoever waits for the variant
+		try {
+			VkSpecializationInfo specializationInfo{};
+			specializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.specializationEntries.size());
+			specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+			specializationInfo.dataSize = configInfo.specializationData.size() * sizeof(uint32_t);
+			specializationInfo.pData = configInfo.specializationData.data();
+			// both stages share the constants, ids a stage does not declare are ignored
+			const VkSpecializationInfo* stageSpecialization =
+				configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
+
+			VkPipelineShaderStageCreateInfo shaderStages[2];
+
+			shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+			shaderStages[0].module = getShaderModule(vertFilepath);
+			shaderStages[0].pName = "main";
+			shaderStages[0].flags = 0;
+			shaderStages[0].pNext = nullptr;
+			shaderStages[0].pSpecializationInfo = stageSpecialization;
+
+			shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			shaderStages[1].module = getShaderModule(fragFilepath);
+			shaderStages[1].pName = "main";
+			shaderStages[1].flags = 0;
+			shaderStages[1].pNext = nullptr;
+			shaderStages[1].pSpecializationInfo = stageSpecialization;
+
+			auto& bindingDescriptions = configInfo.bindingDescriptions;
+			auto& attributeDescriptions = configInfo.attributeDescriptions;
+
+			VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+			vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+			vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+			vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+
+			std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(
+				configInfo.colorAttachmentCount, configInfo.colorBlendAttachment);
+			VkPipelineColorBlendStateCreateInfo colorBlendInfo = configInfo.colorBlendInfo;
+			colorBlendInfo.attachmentCount = configInfo.colorAttachmentCount;
+			colorBlendInfo.pAttachments = colorBlendAttachments.data();
+
+			VkGraphicsPipelineCreateInfo pipelineInfo{};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineInfo.stageCount = 2;
+			pipelineInfo.pStages = shaderStages;
+			pipelineInfo.pVertexInputState = &vertexInputInfo;
+			pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
+			pipelineInfo.pViewportState = &configInfo.viewportInfo;
+			pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
+			pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+			pipelineInfo.pColorBlendState = &colorBlendInfo;
+			pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
+			pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
+
+			pipelineInfo.layout = configInfo.pipelineLayout;
+			pipelineInfo.renderPass = configInfo.renderPass;
+			pipelineInfo.subpass = configInfo.subpass;
+
+			pipelineInfo.basePipelineIndex = -1;
+			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+			// the pipeline cache is internally synchronized, so workers can share it
+			if (vkCreateGraphicsPipelines(
+				lveDevice.device(),
+				lveDevice.pipelineCache().getPipelineCache(),
+				1,
+				&pipelineInfo,
+				nullptr,
+				&variant.pipeline) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create graphics pipeline!");
+			}
+		}
+		catch (const std::exception& e) {
+			variant.pipeline = VK_NULL_HANDLE;
+			variant.error = e.what();
+		}
+
+		variant.pending.store(0, std::memory_order_release);
+	}
+
+} // namespace lve
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+// std
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+namespace lve {
+
+	// A pipeline shared by every LvePipeline asking for the same shaders and state, destroyed with the last of them
+	struct LvePipelineVariant
+	{
+		LvePipelineVariant(VkDevice device) : device{ device } {}
+		~LvePipelineVariant();
+
+		LvePipelineVariant(const LvePipelineVariant&) = delete;
+		LvePipelineVariant& operator=(const LvePipelineVariant&) = delete;
+
+		bool isReady() const { return pending.load(std::memory_order_acquire) == 0; }
+
+		VkDevice device;
+		// set once before pending drops to zero, stays null when compiling failed
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::string error;
+		std::atomic<uint32_t> pending{ 0 };
+	};
+
+	// Deduplicates pipelines and shader modules for a device. A graphics pipeline is identified by its shader files
+	// and every field of PipelineConfigInfo that reaches vkCreateGraphicsPipelines, so systems asking for the same
+	// variant share one VkPipeline, and each SPIR-V file is read and turned into a VkShaderModule once.
+	//
+	// New variants can compile on the shared thread pool: the request returns right away and the variant is ready
+	// later. Callers can skip draws until then, or wait for it, which helps with queued work instead of idling.
+	class LvePipelineRegistry {
+
+	public:
+		explicit LvePipelineRegistry(LveDevice& device);
+		// waits for variants still compiling, then releases the shader modules
+		~LvePipelineRegistry();
+
+		LvePipelineRegistry(const LvePipelineRegistry&) = delete;
+		LvePipelineRegistry& operator=(const LvePipelineRegistry&) = delete;
+
+		// existing variant or a new one, compiled before returning unless background is set
+		std::shared_ptr<LvePipelineVariant> requestGraphics(
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			const PipelineConfigInfo& configInfo,
+			bool background);
+		std::shared_ptr<LvePipelineVariant> requestCompute(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+
+		// blocks until variant compiled, throws if it failed
+		VkPipeline wait(const LvePipelineVariant& variant);
+		// blocks until every background compile finished
+		void waitIdle();
+
+		// module of a SPIR-V file relative to the engine directory, kept until the registry is destroyed
+		VkShaderModule getShaderModule(const std::string& filepath);
+
+		// variants that were requested again and shared instead of compiled
+		uint32_t getReuseCount() const { return reuseCount.load(std::memory_order_relaxed); }
+		uint32_t getCompileCount() const { return compileCount.load(std::memory_order_relaxed); }
+
+	private:
+		// first request of key inserts it and returns true, later ones share the variant and return false
+		bool findOrInsert(const std::string& key, std::shared_ptr<LvePipelineVariant>& variant);
+		void compileGraphics(
+			LvePipelineVariant& variant,
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			const PipelineConfigInfo& configInfo);
+
+		LveDevice& lveDevice;
+
+		std::mutex mutex;
+		std::unordered_map<std::string, std::weak_ptr<LvePipelineVariant>> variants;
+		std::unordered_map<std::string, VkShaderModule> shaderModules;
+
+		// background compiles still queued or running
+		std::atomic<uint32_t> pendingCompiles{ 0 };
+		std::atomic<uint32_t> reuseCount{ 0 };
+		std::atomic<uint32_t> compileCount{ 0 };
+	};
+
+} // namespace lve
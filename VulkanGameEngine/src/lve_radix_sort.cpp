@@ -0,0 +1,66 @@
+#include "lve_radix_sort.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <utility>
+
+
+namespace lve {
+
+	static constexpr uint32_t RADIX_BITS = 8;
+	static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+	static constexpr uint32_t PASS_COUNT = 32 / RADIX_BITS;
+
+	void LveRadixSort::sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+	{
+		assert(keys.size() == values.size() && "Radix sort needs a value per key!");
+
+		size_t count = keys.size();
+		if (count < 2) {
+			return;
+		}
+
+		// all histograms in one read of the keys
+		std::array<std::array<uint32_t, RADIX_SIZE>, PASS_COUNT> histograms{};
+		for (uint32_t key : keys)
+		{
+			for (uint32_t pass = 0; pass < PASS_COUNT; pass++) {
+				histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+			}
+		}
+
+		scratchKeys.resize(count);
+		scratchValues.resize(count);
+
+		for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+		{
+			auto& histogram = histograms[pass];
+			uint32_t shift = pass * RADIX_BITS;
+
+			// one bucket holding everything would only copy
+			if (histogram[(keys[0] >> shift) & (RADIX_SIZE - 1)] == count) {
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t& bucket : histogram)
+			{
+				uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t destination = histogram[(keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+				scratchKeys[destination] = keys[i];
+				scratchValues[destination] = values[i];
+			}
+
+			keys.swap(scratchKeys);
+			values.swap(scratchValues);
+		}
+	}
+
+} // namespace lve
@@ -0,0 +1,34 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+namespace lve {
+
+	// Stable LSD radix sort of 32 bit keys carrying a 32 bit value each, 8 bits per pass. Passes in which every key
+	// has the same digit are skipped, so keys that only differ in their low bits take fewer passes.
+	// Keeps its scratch arrays between calls, so sorting every frame does not allocate once they are big enough.
+	class LveRadixSort {
+
+	public:
+		// key whose unsigned order is the order of value, for any value except NaN
+		static uint32_t floatKey(float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			// negative floats reverse their order and go below the positive ones
+			return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+		}
+
+		// sorts keys ascending and moves values along, elements with equal keys keep their order
+		void sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values);
+
+	private:
+		std::vector<uint32_t> scratchKeys;
+		std::vector<uint32_t> scratchValues;
+	};
+
+} // namespace lve
@@ -0,0 +1,258 @@
+#include "lve_range_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace lve {
+
+	static uint32_t lowestBit(uint64_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return static_cast<uint32_t>(index);
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(mask));
+#endif
+	}
+
+	static uint32_t highestBit(uint64_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, mask);
+		return static_cast<uint32_t>(index);
+#else
+		return static_cast<uint32_t>(63 - __builtin_clzll(mask));
+#endif
+	}
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	LveRangeAllocator::LveRangeAllocator(uint64_t size) : size{ size / MIN_ALIGNMENT * MIN_ALIGNMENT }
+	{
+		for (auto& lists : freeLists) {
+			std::fill(std::begin(lists), std::end(lists), NONE);
+		}
+
+		if (this->size > 0) {
+			insertFree(createBlock(0, this->size));
+		}
+	}
+
+	void LveRangeAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+	{
+		// sizes are at least MIN_ALIGNMENT == SL_COUNT, so the top SL_LOG2 + 1 bits always exist
+		uint32_t msb = highestBit(size);
+		fl = msb - SL_LOG2;
+		sl = static_cast<uint32_t>(size >> (msb - SL_LOG2)) - SL_COUNT;
+	}
+
+	uint32_t LveRangeAllocator::createBlock(uint64_t offset, uint64_t size)
+	{
+		uint32_t block;
+		if (!unusedBlocks.empty()) {
+			block = unusedBlocks.back();
+			unusedBlocks.pop_back();
+		}
+		else {
+			block = static_cast<uint32_t>(blocks.size());
+			blocks.emplace_back();
+		}
+		blocks[block] = { offset, size, NONE, NONE, NONE, NONE, false };
+		return block;
+	}
+
+	void LveRangeAllocator::releaseBlock(uint32_t block)
+	{
+		unusedBlocks.push_back(block);
+	}
+
+	void LveRangeAllocator::insertFree(uint32_t block)
+	{
+		uint32_t fl, sl;
+		mapping(blocks[block].size, fl, sl);
+
+		Block& b = blocks[block];
+		b.free = true;
+		b.prevFree = NONE;
+		b.nextFree = freeLists[fl][sl];
+		if (b.nextFree != NONE) {
+			blocks[b.nextFree].prevFree = block;
+		}
+		freeLists[fl][sl] = block;
+
+		flBitmap |= uint64_t{ 1 } << fl;
+		slBitmaps[fl] |= 1u << sl;
+		freeRangeCount++;
+	}
+
+	void LveRangeAllocator::removeFree(uint32_t block)
+	{
+		uint32_t fl, sl;
+		mapping(blocks[block].size, fl, sl);
+
+		Block& b = blocks[block];
+		if (b.prevFree != NONE) {
+			blocks[b.prevFree].nextFree = b.nextFree;
+		}
+		else {
+			freeLists[fl][sl] = b.nextFree;
+		}
+		if (b.nextFree != NONE) {
+			blocks[b.nextFree].prevFree = b.prevFree;
+		}
+
+		if (freeLists[fl][sl] == NONE)
+		{
+			slBitmaps[fl] &= ~(1u << sl);
+			if (slBitmaps[fl] == 0) {
+				flBitmap &= ~(uint64_t{ 1 } << fl);
+			}
+		}
+		b.free = false;
+		freeRangeCount--;
+	}
+
+	uint32_t LveRangeAllocator::findFree(uint64_t size) const
+	{
+		// round up to the next list so every block found is large enough
+		uint32_t msb = highestBit(size);
+		size += (uint64_t{ 1 } << (msb - SL_LOG2)) - 1;
+		if (size < (uint64_t{ 1 } << msb)) {
+			return NONE; // overflowed
+		}
+
+		uint32_t fl, sl;
+		mapping(size, fl, sl);
+
+		uint32_t slMap = slBitmaps[fl] & (~0u << sl);
+		if (slMap == 0)
+		{
+			uint64_t flMap = fl + 1 < 64 ? flBitmap & (~uint64_t{ 0 } << (fl + 1)) : 0;
+			if (flMap == 0) {
+				return NONE;
+			}
+			fl = lowestBit(flMap);
+			slMap = slBitmaps[fl];
+		}
+		return freeLists[fl][lowestBit(slMap)];
+	}
+
+	bool LveRangeAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset, Handle& handle)
+	{
+		assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two!");
+
+		size = alignUp(std::max<uint64_t>(size, 1), MIN_ALIGNMENT);
+		alignment = std::max(alignment, MIN_ALIGNMENT);
+
+		// block offsets are MIN_ALIGNMENT aligned, so this much extra always covers the alignment padding
+		uint64_t searchSize = size + alignment - MIN_ALIGNMENT;
+		if (searchSize < size || searchSize > this->size) {
+			return false;
+		}
+
+		uint32_t block = findFree(searchSize);
+		if (block == NONE) {
+			return false;
+		}
+		removeFree(block);
+
+		// return the alignment padding in front as its own free range
+		uint64_t alignedOffset = alignUp(blocks[block].offset, alignment);
+		uint64_t padding = alignedOffset - blocks[block].offset;
+		if (padding > 0)
+		{
+			uint32_t front = createBlock(blocks[block].offset, padding);
+			blocks[front].prevPhysical = blocks[block].prevPhysical;
+			blocks[front].nextPhysical = block;
+			if (blocks[front].prevPhysical != NONE) {
+				blocks[blocks[front].prevPhysical].nextPhysical = front;
+			}
+			blocks[block].prevPhysical = front;
+			blocks[block].offset += padding;
+			blocks[block].size -= padding;
+			insertFree(front);
+		}
+
+		// and the unused tail
+		if (blocks[block].size > size)
+		{
+			uint32_t back = createBlock(blocks[block].offset + size, blocks[block].size - size);
+			blocks[back].prevPhysical = block;
+			blocks[back].nextPhysical = blocks[block].nextPhysical;
+			if (blocks[back].nextPhysical != NONE) {
+				blocks[blocks[back].nextPhysical].prevPhysical = back;
+			}
+			blocks[block].nextPhysical = back;
+			blocks[block].size = size;
+			insertFree(back);
+		}
+
+		usedSize += size;
+		allocationCount++;
+		offset = blocks[block].offset;
+		handle = block;
+		return true;
+	}
+
+	void LveRangeAllocator::free(Handle handle)
+	{
+		assert(handle < blocks.size() && !blocks[handle].free && "Freeing a range that is not allocated!");
+
+		uint32_t block = handle;
+		usedSize -= blocks[block].size;
+		allocationCount--;
+
+		uint32_t prev = blocks[block].prevPhysical;
+		if (prev != NONE && blocks[prev].free)
+		{
+			removeFree(prev);
+			blocks[prev].size += blocks[block].size;
+			blocks[prev].nextPhysical = blocks[block].nextPhysical;
+			if (blocks[prev].nextPhysical != NONE) {
+				blocks[blocks[prev].nextPhysical].prevPhysical = prev;
+			}
+			releaseBlock(block);
+			block = prev;
+		}
+
+		uint32_t next = blocks[block].nextPhysical;
+		if (next != NONE && blocks[next].free)
+		{
+			removeFree(next);
+			blocks[block].size += blocks[next].size;
+			blocks[block].nextPhysical = blocks[next].nextPhysical;
+			if (blocks[block].nextPhysical != NONE) {
+				blocks[blocks[block].nextPhysical].prevPhysical = block;
+			}
+			releaseBlock(next);
+		}
+
+		insertFree(block);
+	}
+
+	uint64_t LveRangeAllocator::getLargestFreeRange() const
+	{
+		if (flBitmap == 0) {
+			return 0;
+		}
+
+		uint32_t fl = highestBit(flBitmap);
+		uint64_t largest = 0;
+		for (uint32_t block = freeLists[fl][highestBit(slBitmaps[fl])]; block != NONE; block = blocks[block].nextFree) {
+			largest = std::max(largest, blocks[block].size);
+		}
+		return largest;
+	}
+
+} // namespace lve
@@ -0,0 +1,77 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <vector>
+
+
+namespace lve {
+
+	// Two level segregated fit (TLSF) allocator over an abstract [0, size) range.
+	// Allocation and free are O(1), adjacent free ranges are merged on free.
+	// It only hands out offsets, so it can manage device memory blocks as well as ranges inside a buffer.
+	class LveRangeAllocator {
+
+	public:
+		using Handle = uint32_t;
+		static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+		// every offset and size is a multiple of this
+		static constexpr uint64_t MIN_ALIGNMENT = 16;
+
+		explicit LveRangeAllocator(uint64_t size);
+
+		LveRangeAllocator(const LveRangeAllocator&) = delete;
+		LveRangeAllocator& operator=(const LveRangeAllocator&) = delete;
+
+		// alignment must be a power of two; returns false if no free range fits
+		bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset, Handle& handle);
+		void free(Handle handle);
+
+		uint64_t getSize() const { return size; }
+		uint64_t getUsedSize() const { return usedSize; }
+		uint64_t getAllocationSize(Handle handle) const { return blocks[handle].size; }
+		uint32_t getAllocationCount() const { return allocationCount; }
+		uint32_t getFreeRangeCount() const { return freeRangeCount; }
+		uint64_t getLargestFreeRange() const;
+		bool empty() const { return allocationCount == 0; }
+
+	private:
+		static constexpr uint32_t SL_LOG2 = 4;
+		static constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+		static constexpr uint32_t FL_COUNT = 64 - SL_LOG2;
+		static constexpr uint32_t NONE = UINT32_MAX;
+
+		struct Block
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint32_t prevPhysical;
+			uint32_t nextPhysical;
+			uint32_t prevFree;
+			uint32_t nextFree;
+			bool free;
+		};
+
+		static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+
+		uint32_t createBlock(uint64_t offset, uint64_t size);
+		void releaseBlock(uint32_t block);
+		void insertFree(uint32_t block);
+		void removeFree(uint32_t block);
+		uint32_t findFree(uint64_t size) const;
+
+		uint64_t size;
+		uint64_t usedSize = 0;
+		uint32_t allocationCount = 0;
+		uint32_t freeRangeCount = 0;
+
+		std::vector<Block> blocks;
+		std::vector<uint32_t> unusedBlocks;
+
+		uint64_t flBitmap = 0;
+		uint32_t slBitmaps[FL_COUNT]{};
+		uint32_t freeLists[FL_COUNT][SL_COUNT];
+	};
+
+} // namespace lve
@@ -1,21 +1,37 @@
 #include "lve_renderer.hpp"
 
+#include "lve_geometry_buffer.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_upload_queue.hpp"
+
 // std
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 
 
 namespace lve {
 
-	LveRenderer::LveRenderer(LveWindow& window, LveDevice& device)
-		: lveWindow{ window }, lveDevice{ device }
+	LveRenderer::LveRenderer(LveWindow& window, LveDevice& device, LveRenderPath path)
+		: lveWindow{ window }, lveDevice{ device }, renderPath{ path }
 	{
+		if (renderPath == LveRenderPath::Deferred)
+		{
+			gBufferSetLayout = LveDescriptorSetLayout::Builder(lveDevice)
+				.addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+				.build();
+		}
+
 		recreateSwapChain();
 		createCommandBuffers();
+		createSecondaryCommandPools();
 	}
 
 	LveRenderer::~LveRenderer()
 	{
+		destroySecondaryCommandPools();
 		freeCommandBuffers();
 	}
 
@@ -31,7 +47,7 @@ namespace lve {
 		vkDeviceWaitIdle(lveDevice.device());
 
 		if (lveSwapChain == nullptr) {
-			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent);
+			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, renderPath);
 		}
 		else {
 			std::shared_ptr<LveSwapChain> oldSwapChain = std::move(lveSwapChain);
@@ -42,7 +58,35 @@ namespace lve {
 			}
 		}
 
-		// we'll come back to this in just a moment
+		depthPyramid = std::make_unique<LveDepthPyramid>(lveDevice, *lveSwapChain);
+
+		if (renderPath == LveRenderPath::Deferred) {
+			createGBufferDescriptorSets();
+		}
+	}
+
+	void LveRenderer::createGBufferDescriptorSets()
+	{
+		uint32_t imageCount = static_cast<uint32_t>(lveSwapChain->imageCount());
+
+		// the device is idle, so the sets of the previous swap chain go with their pool
+		gBufferDescriptorPool = LveDescriptorPool::Builder(lveDevice)
+			.setMaxSets(imageCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3 * imageCount)
+			.build();
+
+		gBufferDescriptorSets.resize(imageCount);
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			VkDescriptorImageInfo albedoInfo{ VK_NULL_HANDLE, lveSwapChain->getGBufferAlbedoView(i), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			VkDescriptorImageInfo normalInfo{ VK_NULL_HANDLE, lveSwapChain->getGBufferNormalView(i), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			VkDescriptorImageInfo depthInfo{ VK_NULL_HANDLE, lveSwapChain->getDepthImageView(i), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+			LveDescriptorWriter(*gBufferSetLayout, *gBufferDescriptorPool)
+				.writeImage(0, &albedoInfo)
+				.writeImage(1, &normalInfo)
+				.writeImage(2, &depthInfo)
+				.build(gBufferDescriptorSets[i]);
+		}
 	}
 
 	void LveRenderer::createCommandBuffers()
@@ -71,10 +115,121 @@ namespace lve {
 		commandBuffers.clear();
 	}
 
+	void LveRenderer::createSecondaryCommandPools()
+	{
+		uint32_t slotCount = LveThreadPool::shared().getThreadCount();
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+		// the whole pool is reset once per frame instead of its command buffers one by one
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		secondaryCommandPools.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& framePools : secondaryCommandPools)
+		{
+			framePools.resize(slotCount);
+			for (auto& pool : framePools)
+			{
+				if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create secondary command pool!");
+				}
+			}
+		}
+	}
+
+	void LveRenderer::destroySecondaryCommandPools()
+	{
+		for (auto& framePools : secondaryCommandPools)
+		{
+			for (auto& pool : framePools) {
+				vkDestroyCommandPool(lveDevice.device(), pool.commandPool, nullptr);
+			}
+		}
+		secondaryCommandPools.clear();
+	}
+
+	VkCommandBuffer LveRenderer::acquireSecondaryCommandBuffer(uint32_t slot)
+	{
+		SecondaryCommandPool& pool = secondaryCommandPools[currentFrameIndex][slot];
+
+		if (pool.usedCount == pool.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = pool.commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate secondary command buffer!");
+			}
+			pool.commandBuffers.push_back(commandBuffer);
+		}
+
+		return pool.commandBuffers[pool.usedCount++];
+	}
+
+	void LveRenderer::recordSecondary(uint32_t count, const RecordFunction& record, uint32_t minSliceSize)
+	{
+		assert(isFrameStarted && "Can't record secondary command buffers if frame is not in progress");
+		assert(currentSubpassContents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS &&
+			"Render pass was not begun for secondary command buffers");
+
+		if (count == 0) {
+			return;
+		}
+
+		uint32_t slotCount = static_cast<uint32_t>(secondaryCommandPools[currentFrameIndex].size());
+		uint32_t sliceCount = std::min(slotCount, (count + minSliceSize - 1) / std::max(1u, minSliceSize));
+		std::vector<VkCommandBuffer> commandBuffers(sliceCount);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = lveSwapChain->getRenderPass();
+		inheritanceInfo.subpass = currentSubpass;
+		inheritanceInfo.framebuffer = lveSwapChain->getFrameBuffer(currentImageIndex);
+
+		// each slice has a slot of its own, so no two threads share a command pool
+		LveThreadPool::shared().parallelFor(sliceCount, [&](uint32_t firstSlice, uint32_t lastSlice) {
+			for (uint32_t slice = firstSlice; slice < lastSlice; slice++)
+			{
+				VkCommandBuffer commandBuffer = acquireSecondaryCommandBuffer(slice);
+
+				VkCommandBufferBeginInfo beginInfo{};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				beginInfo.pInheritanceInfo = &inheritanceInfo;
+				if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to begin recording secondary command buffer!");
+				}
+
+				// dynamic state is not inherited from the primary command buffer
+				vkCmdSetViewport(commandBuffer, 0, 1, &currentViewport);
+				vkCmdSetScissor(commandBuffer, 0, 1, &currentScissor);
+
+				uint64_t begin = uint64_t{ count } * slice / sliceCount;
+				uint64_t end = uint64_t{ count } * (slice + 1) / sliceCount;
+				record(commandBuffer, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to record secondary command buffer!");
+				}
+				commandBuffers[slice] = commandBuffer;
+			}
+		});
+
+		vkCmdExecuteCommands(getCurrentCommandBuffer(), sliceCount, commandBuffers.data());
+	}
+
 	VkCommandBuffer LveRenderer::beginFrame()
 	{
 		assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
+		// everything uploaded since the last frame goes out as one batch
+		lveDevice.uploadQueue().submit();
+
 		auto result = lveSwapChain->acquireNextImage(&currentImageIndex);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
@@ -85,6 +240,14 @@ namespace lve {
 			throw std::runtime_error("Failed to acquire swap chain image!");
 		}
 
+		// acquiring waited for the frame that last used this slot
+		lveDevice.geometry().beginFrame();
+		for (auto& pool : secondaryCommandPools[currentFrameIndex])
+		{
+			vkResetCommandPool(lveDevice.device(), pool.commandPool, 0);
+			pool.usedCount = 0;
+		}
+
 		isFrameStarted = true;
 
 		auto commandBuffer = getCurrentCommandBuffer();
@@ -121,7 +284,7 @@ namespace lve {
 		currentFrameIndex = (currentFrameIndex + 1) % LveSwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 	{
 		assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
@@ -134,13 +297,18 @@ namespace lve {
 		renderPassInfo.renderArea.offset = { 0, 0 };
 		renderPassInfo.renderArea.extent = lveSwapChain->getSwapChainExtent();
 
-		std::array<VkClearValue, 2> clearValues{};
+		// the G-buffer clear values are only used on the deferred path
+		std::array<VkClearValue, 4> clearValues{};
 		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
 		clearValues[1].depthStencil = { 1.0f, 0 };
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		clearValues[2].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+		clearValues[3].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+		renderPassInfo.clearValueCount = renderPath == LveRenderPath::Deferred ? 4 : 2;
 		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		currentSubpass = 0;
+		currentSubpassContents = contents;
 
 		VkViewport viewport{};
 		viewport.x = 0.0f;
@@ -150,8 +318,32 @@ namespace lve {
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
 		VkRect2D scissor{ {0, 0}, lveSwapChain->getSwapChainExtent() };
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		currentViewport = viewport;
+		currentScissor = scissor;
+
+		// only secondary command buffers may be recorded into the pass then, they set their own
+		if (contents == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		}
+	}
+
+	void LveRenderer::nextSubpass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+	{
+		assert(isFrameStarted && "Can't call nextSubpass if frame is not in progress");
+		assert(commandBuffer == getCurrentCommandBuffer() && "Can't change subpass on command buffer from a different frame");
+
+		vkCmdNextSubpass(commandBuffer, contents);
+		currentSubpass++;
+		currentSubpassContents = contents;
+
+		// dynamic state carries over between subpasses, but not from before secondary command buffers were executed
+		if (contents == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			vkCmdSetViewport(commandBuffer, 0, 1, &currentViewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &currentScissor);
+		}
 	}
 
 	void LveRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
@@ -162,4 +354,12 @@ namespace lve {
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
+	void LveRenderer::buildDepthPyramid(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection)
+	{
+		assert(isFrameStarted && "Can't build the depth pyramid if frame is not in progress");
+		assert(commandBuffer == getCurrentCommandBuffer() && "Can't build the depth pyramid on command buffer from a different frame");
+
+		depthPyramid->build(commandBuffer, currentImageIndex, viewProjection);
+	}
+
 } // namespace lve
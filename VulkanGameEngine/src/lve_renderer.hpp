@@ -1,13 +1,16 @@
 #pragma once
 
+#include "lve_depth_pyramid.hpp"
+#include "lve_descriptors.h"
 #include "lve_device.hpp"
 #include "lve_swap_chain.hpp"
 #include "lve_window.hpp"
 
 // std
+#include <cassert>
+#include <functional>
 #include <memory>
 #include <vector>
-#include <cassert>
 
 
 namespace lve {
@@ -15,7 +18,7 @@ namespace lve {
 	class LveRenderer {
 
 	public:
-		LveRenderer(LveWindow& window, LveDevice& device);
+		LveRenderer(LveWindow& window, LveDevice& device, LveRenderPath renderPath = LveRenderPath::Forward);
 		~LveRenderer();
 
 		LveRenderer(const LveRenderer&) = delete;
@@ -23,6 +26,9 @@ namespace lve {
 
 		VkRenderPass getSwapChainRenderPass() const { return lveSwapChain->getRenderPass(); }
 		float getAspectRatio() const { return lveSwapChain->extentAspectRatio(); };
+		VkExtent2D getSwapChainExtent() const { return lveSwapChain->getSwapChainExtent(); }
+		LveRenderPath getRenderPath() const { return renderPath; }
+		uint32_t getLightingSubpass() const { return lveSwapChain->getLightingSubpass(); }
 		bool isFrameInProgress() const { return isFrameStarted; };
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
@@ -34,24 +40,73 @@ namespace lve {
 			return currentFrameIndex;
 		}
 
+		using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS all drawing in the pass goes through recordSecondary
+		void beginSwapChainRenderPass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		// moves on to the next subpass of the swap chain render pass, the lighting subpass on the deferred path
+		void nextSubpass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// set 1 of the deferred lighting pass: albedo, normal and depth input attachments, deferred path only
+		VkDescriptorSetLayout getGBufferSetLayout() const { return gBufferSetLayout->getDescriptorSetLayout(); }
+		VkDescriptorSet getGBufferDescriptorSet() const {
+			assert(isFrameStarted && "Cannot get G-buffer descriptor set when frame not in progress");
+			return gBufferDescriptorSets[currentImageIndex];
+		}
+
+		// reduces the depth the swap chain render pass just wrote into the depth pyramid, call after the pass ended
+		void buildDepthPyramid(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection);
+		// depth of the last frame that built it, recreated with the swap chain
+		LveDepthPyramid* getDepthPyramid() const { return depthPyramid.get(); }
+
+		// Splits [0, count) into slices of at least minSliceSize, records each slice into a secondary command buffer
+		// on the shared thread pool and executes them in order in the current render pass.
+		// Viewport and scissor are already set in each secondary command buffer, everything else is up to record.
+		void recordSecondary(uint32_t count, const RecordFunction& record, uint32_t minSliceSize = 1);
+
 	private:
+		// One per worker slot and frame in flight, command pools must only be used by one thread at a time
+		struct SecondaryCommandPool
+		{
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCount = 0;
+		};
+
 		void createCommandBuffers();
 		void freeCommandBuffers();
+		void createSecondaryCommandPools();
+		void destroySecondaryCommandPools();
+		VkCommandBuffer acquireSecondaryCommandBuffer(uint32_t slot);
 		void recreateSwapChain();
+		void createGBufferDescriptorSets();
 
 		LveWindow& lveWindow;
 		LveDevice& lveDevice;
+		LveRenderPath renderPath;
 		std::unique_ptr<LveSwapChain> lveSwapChain;
+		std::unique_ptr<LveDepthPyramid> depthPyramid;
 		std::vector<VkCommandBuffer> commandBuffers;
 
+		// indexed by swap chain image, rebuilt with the swap chain
+		std::unique_ptr<LveDescriptorSetLayout> gBufferSetLayout;
+		std::unique_ptr<LveDescriptorPool> gBufferDescriptorPool;
+		std::vector<VkDescriptorSet> gBufferDescriptorSets;
+
+		// indexed by frame in flight, then worker slot
+		std::vector<std::vector<SecondaryCommandPool>> secondaryCommandPools;
+
 		uint32_t currentImageIndex = 0;
 		int currentFrameIndex = 0;
 		bool isFrameStarted = false;
+		uint32_t currentSubpass = 0;
+		VkSubpassContents currentSubpassContents = VK_SUBPASS_CONTENTS_INLINE;
+		VkViewport currentViewport{};
+		VkRect2D currentScissor{};
 
 	};
 
@@ -0,0 +1,178 @@
+#include "lve_scene_graph.hpp"
+
+#include "lve_thread_pool.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+
+namespace lve {
+
+	// below this many roots the update stays on the calling thread
+	static constexpr uint32_t PARALLEL_MIN_ROOTS = 16;
+
+	LveSceneGraph::LveSceneGraph(LveEntityRegistry& registry) : registry{ registry } {}
+
+	void LveSceneGraph::attach(LveEntity entity, LveEntity parent)
+	{
+		assert(registry.isAlive(entity) && "Attaching a destroyed entity!");
+		assert(registry.has<TransformComponent>(entity) && "Scene graph entities need a TransformComponent!");
+		assert((parent.isNull() || contains(parent)) && "Parent is not in the scene graph!");
+
+		// an entity can not become a descendant of itself
+		for (LveEntity ancestor = parent; !ancestor.isNull(); ancestor = links[ancestor.index].parent) {
+			assert(ancestor != entity && "Attaching an entity below itself!");
+		}
+
+		if (contains(entity)) {
+			unlink(entity.index);
+		}
+		else
+		{
+			if (entity.index >= links.size()) {
+				links.resize(entity.index + 1);
+			}
+			links[entity.index].entity = entity;
+			if (!registry.has<WorldTransformComponent>(entity)) {
+				registry.add<WorldTransformComponent>(entity);
+			}
+		}
+
+		links[entity.index].parent = parent;
+		if (parent.isNull()) {
+			roots.push_back(entity.index);
+		}
+		else {
+			links[parent.index].children.push_back(entity.index);
+		}
+		structureChanged = true;
+	}
+
+	void LveSceneGraph::detach(LveEntity entity)
+	{
+		assert(contains(entity) && "Entity is not in the scene graph!");
+
+		unlink(entity.index);
+
+		std::vector<uint32_t> subtree{ entity.index };
+		while (!subtree.empty())
+		{
+			Link& link = links[subtree.back()];
+			subtree.pop_back();
+			subtree.insert(subtree.end(), link.children.begin(), link.children.end());
+
+			if (registry.isAlive(link.entity) && registry.has<WorldTransformComponent>(link.entity)) {
+				registry.remove<WorldTransformComponent>(link.entity);
+			}
+			link = Link{};
+		}
+		structureChanged = true;
+	}
+
+	LveEntity LveSceneGraph::getParent(LveEntity entity) const
+	{
+		assert(contains(entity) && "Entity is not in the scene graph!");
+		return links[entity.index].parent;
+	}
+
+	void LveSceneGraph::unlink(uint32_t entityIndex)
+	{
+		LveEntity parent = links[entityIndex].parent;
+		std::vector<uint32_t>& siblings = parent.isNull() ? roots : links[parent.index].children;
+		siblings.erase(std::find(siblings.begin(), siblings.end(), entityIndex));
+	}
+
+	void LveSceneGraph::buildNodes()
+	{
+		nodeEntities.clear();
+		nodeParents.clear();
+		rootFirstNodes.clear();
+
+		// depth first with an explicit stack, children are pushed in reverse to keep their order
+		std::vector<std::pair<uint32_t, uint32_t>> stack; // entity index and parent node
+		for (uint32_t root : roots)
+		{
+			rootFirstNodes.push_back(static_cast<uint32_t>(nodeEntities.size()));
+			stack.push_back({ root, NO_PARENT });
+			while (!stack.empty())
+			{
+				auto [entityIndex, parentNode] = stack.back();
+				stack.pop_back();
+
+				const Link& link = links[entityIndex];
+				uint32_t node = static_cast<uint32_t>(nodeEntities.size());
+				nodeEntities.push_back(link.entity);
+				nodeParents.push_back(parentNode);
+				for (auto child = link.children.rbegin(); child != link.children.rend(); ++child) {
+					stack.push_back({ *child, node });
+				}
+			}
+		}
+		rootFirstNodes.push_back(static_cast<uint32_t>(nodeEntities.size()));
+
+		size_t nodeCount = nodeEntities.size();
+		nodeRevisions.assign(nodeCount, 0);
+		nodeDirty.assign(nodeCount, 0);
+		worldMatrices.resize(nodeCount);
+		worldNormalMatrices.resize(nodeCount);
+		rebuildAll = true;
+		structureChanged = false;
+	}
+
+	void LveSceneGraph::update()
+	{
+		if (structureChanged) {
+			buildNodes();
+		}
+
+		LveComponentPool<TransformComponent>& transforms = registry.pool<TransformComponent>();
+		LveComponentPool<WorldTransformComponent>& worlds = registry.pool<WorldTransformComponent>();
+
+		updatedCount.store(0, std::memory_order_relaxed);
+		worldRevision++;
+		uint32_t rootCount = static_cast<uint32_t>(roots.size());
+
+		// each task owns whole subtrees, so parents are always done before their children on the same thread
+		LveThreadPool::shared().parallelFor(rootCount, [&](uint32_t begin, uint32_t end) {
+			uint32_t updated = 0;
+			for (uint32_t node = rootFirstNodes[begin]; node < rootFirstNodes[end]; node++)
+			{
+				LveEntity entity = nodeEntities[node];
+				assert(registry.isAlive(entity) && "Entities have to be detached from the scene graph before they are destroyed!");
+
+				TransformComponent& transform = transforms.get(entity.index);
+				uint32_t revision = transform.getRevision();
+				uint32_t parent = nodeParents[node];
+
+				bool dirty = rebuildAll || revision != nodeRevisions[node] || (parent != NO_PARENT && nodeDirty[parent]);
+				nodeDirty[node] = dirty;
+				if (!dirty) continue;
+
+				nodeRevisions[node] = revision;
+				if (parent == NO_PARENT)
+				{
+					worldMatrices[node] = transform.mat4();
+					worldNormalMatrices[node] = transform.normalMatrix();
+				}
+				else
+				{
+					// the inverse transpose of a product is the product of the inverse transposes
+					worldMatrices[node] = worldMatrices[parent] * transform.mat4();
+					worldNormalMatrices[node] = worldNormalMatrices[parent] * transform.normalMatrix();
+				}
+
+				WorldTransformComponent& world = worlds.get(entity.index);
+				world.matrix = worldMatrices[node];
+				world.normalMatrix = worldNormalMatrices[node];
+				world.revision = worldRevision;
+				updated++;
+			}
+			updatedCount.fetch_add(updated, std::memory_order_relaxed);
+		}, PARALLEL_MIN_ROOTS);
+
+		rebuildAll = false;
+	}
+
+} // namespace lve
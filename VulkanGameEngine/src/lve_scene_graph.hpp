@@ -0,0 +1,92 @@
+#pragma once
+
+#include "lve_entity_registry.hpp"
+#include "lve_game_object.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+
+namespace lve {
+
+	// Parent-child hierarchy of entities of a registry. The TransformComponent of an entity in the graph is relative
+	// to its parent, and update() writes the composed world matrices to its WorldTransformComponent.
+	//
+	// The hierarchy is kept as arrays in depth first order, rebuilt after attach or detach: parents come before their
+	// children and each root's subtree is one contiguous range. A node's world matrix is only recomputed when its
+	// own transform or one of its ancestors' changed, and separate roots are updated on the shared thread pool.
+	//
+	// Entities have to be detached before they are destroyed.
+	class LveSceneGraph {
+
+	public:
+		explicit LveSceneGraph(LveEntityRegistry& registry);
+
+		LveSceneGraph(const LveSceneGraph&) = delete;
+		LveSceneGraph& operator=(const LveSceneGraph&) = delete;
+
+		// Adds entity under parent, or as a root when parent is null. An entity already in the graph moves with its
+		// subtree. The entity needs a TransformComponent and gets a WorldTransformComponent.
+		void attach(LveEntity entity, LveEntity parent = LveEntity{});
+		// removes entity and its subtree from the graph along with their WorldTransformComponent
+		void detach(LveEntity entity);
+
+		bool contains(LveEntity entity) const
+		{
+			return entity.index < links.size() && links[entity.index].entity == entity;
+		}
+		// null for roots
+		LveEntity getParent(LveEntity entity) const;
+
+		// recomputes the world matrices of the changed branches
+		void update();
+
+		uint32_t getNodeCount() const { return static_cast<uint32_t>(nodeEntities.size()); }
+		// nodes whose world matrices the last update recomputed
+		uint32_t getUpdatedCount() const { return updatedCount.load(std::memory_order_relaxed); }
+
+	private:
+		static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+		// structure by entity index, entity is null for indices not in the graph
+		struct Link
+		{
+			LveEntity entity{};
+			LveEntity parent{};
+			std::vector<uint32_t> children;
+		};
+
+		void unlink(uint32_t entityIndex);
+		void buildNodes();
+
+		LveEntityRegistry& registry;
+
+		std::vector<Link> links;
+		std::vector<uint32_t> roots;
+		bool structureChanged = false;
+
+		// nodes in depth first order, the subtree of root r spans rootFirstNodes[r] to rootFirstNodes[r + 1]
+		std::vector<LveEntity> nodeEntities;
+		std::vector<uint32_t> nodeParents;
+		std::vector<uint32_t> rootFirstNodes;
+		// the transform revision each world matrix was built from, and whether the last update rebuilt it
+		std::vector<uint32_t> nodeRevisions;
+		std::vector<uint8_t> nodeDirty;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<glm::mat3> worldNormalMatrices;
+		// set when the nodes were rebuilt, whose revisions are then unknown
+		bool rebuildAll = false;
+		// counts the updates, the world matrices written by one carry its count as their revision
+		uint32_t worldRevision = 0;
+
+		std::atomic<uint32_t> updatedCount{ 0 };
+	};
+
+} // namespace lve
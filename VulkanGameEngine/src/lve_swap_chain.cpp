@@ -11,14 +11,14 @@
 
 namespace lve {
 
-LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent)
-    : device{ deviceRef }, windowExtent{ extent }
+LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent, LveRenderPath path)
+    : device{ deviceRef }, windowExtent{ extent }, renderPath{ path }
 {
     init();
 }
 
 LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, std::shared_ptr<LveSwapChain> previous)
-    : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{ previous }
+    : device{ deviceRef }, windowExtent{ extent }, renderPath{ previous->renderPath }, oldSwapChain{ previous }
 {
     init();
 
@@ -30,7 +30,13 @@ void LveSwapChain::init()
 {
     createSwapChain();
     createImageViews();
-    createRenderPass();
+    if (renderPath == LveRenderPath::Deferred) {
+        createDeferredRenderPass();
+        createGBufferResources();
+    }
+    else {
+        createRenderPass();
+    }
     createDepthResources();
     createFramebuffers();
     createSyncObjects();
@@ -50,7 +56,16 @@ LveSwapChain::~LveSwapChain() {
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    device.freeMemory(depthImageMemorys[i]);
+  }
+
+  for (size_t i = 0; i < gBufferImages.size(); i++) {
+    vkDestroyImage(device.device(), gBufferImages[i], nullptr);
+    device.freeMemory(gBufferImageMemorys[i]);
+  }
+  for (size_t i = 0; i < gBufferAlbedoViews.size(); i++) {
+    vkDestroyImageView(device.device(), gBufferAlbedoViews[i], nullptr);
+    vkDestroyImageView(device.device(), gBufferNormalViews[i], nullptr);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
@@ -226,7 +241,8 @@ void LveSwapChain::createRenderPass() {
   depthAttachment.format = findDepthFormat();
   depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  // kept for the depth pyramid the next frame culls against
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -280,10 +296,124 @@ void LveSwapChain::createRenderPass() {
   }
 }
 
+void LveSwapChain::createDeferredRenderPass() {
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = getSwapChainImageFormat();
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = findDepthFormat();
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  // kept for the depth pyramid the next frame culls against
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  // the G-buffer only lives within the render pass, so it is never stored
+  VkAttachmentDescription albedoAttachment = {};
+  albedoAttachment.format = GBUFFER_ALBEDO_FORMAT;
+  albedoAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  albedoAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  albedoAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  albedoAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  albedoAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  albedoAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  albedoAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkAttachmentDescription normalAttachment = albedoAttachment;
+  normalAttachment.format = GBUFFER_NORMAL_FORMAT;
+
+  // subpass 0 fills the G-buffer and depth
+  std::array<VkAttachmentReference, 2> gBufferOutputRefs{};
+  gBufferOutputRefs[0].attachment = 2;
+  gBufferOutputRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  gBufferOutputRefs[1].attachment = 3;
+  gBufferOutputRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 1;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  // subpass 1 shades into the swap chain image, reading the G-buffer and depth of the same pixel
+  VkAttachmentReference colorAttachmentRef = {};
+  colorAttachmentRef.attachment = 0;
+  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  std::array<VkAttachmentReference, 3> gBufferInputRefs{};
+  gBufferInputRefs[0].attachment = 2;
+  gBufferInputRefs[0].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  gBufferInputRefs[1].attachment = 3;
+  gBufferInputRefs[1].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  gBufferInputRefs[2].attachment = 1;
+  gBufferInputRefs[2].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  // read only depth still tests the lights drawn after the lighting pass
+  VkAttachmentReference depthReadOnlyRef{};
+  depthReadOnlyRef.attachment = 1;
+  depthReadOnlyRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  std::array<VkSubpassDescription, 2> subpasses{};
+  subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gBufferOutputRefs.size());
+  subpasses[0].pColorAttachments = gBufferOutputRefs.data();
+  subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+
+  subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[1].colorAttachmentCount = 1;
+  subpasses[1].pColorAttachments = &colorAttachmentRef;
+  subpasses[1].inputAttachmentCount = static_cast<uint32_t>(gBufferInputRefs.size());
+  subpasses[1].pInputAttachments = gBufferInputRefs.data();
+  subpasses[1].pDepthStencilAttachment = &depthReadOnlyRef;
+
+  std::array<VkSubpassDependency, 2> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // by region, a pixel of the lighting pass only waits for the same pixel of the G-buffer pass
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = 1;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  std::array<VkAttachmentDescription, 4> attachments = {colorAttachment, depthAttachment, albedoAttachment, normalAttachment};
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create deferred render pass!");
+  }
+}
+
 void LveSwapChain::createFramebuffers() {
   swapChainFramebuffers.resize(imageCount());
   for (size_t i = 0; i < imageCount(); i++) {
-    std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
+    std::vector<VkImageView> attachments = {swapChainImageViews[i], depthImageViews[i]};
+    if (renderPath == LveRenderPath::Deferred) {
+      attachments.push_back(gBufferAlbedoViews[i]);
+      attachments.push_back(gBufferNormalViews[i]);
+    }
 
     VkExtent2D swapChainExtent = getSwapChainExtent();
     VkFramebufferCreateInfo framebufferInfo = {};
@@ -326,7 +456,10 @@ void LveSwapChain::createDepthResources() {
     imageInfo.format = depthFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (renderPath == LveRenderPath::Deferred) {
+      imageInfo.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    }
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
@@ -354,6 +487,60 @@ void LveSwapChain::createDepthResources() {
   }
 }
 
+void LveSwapChain::createGBufferResources() {
+  VkExtent2D swapChainExtent = getSwapChainExtent();
+
+  // transient attachments can stay in tile memory without ever being backed, where the device allows it
+  VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if (device.hasMemoryType(VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+    memoryProperties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  }
+
+  gBufferImages.resize(2 * imageCount());
+  gBufferImageMemorys.resize(2 * imageCount());
+  gBufferAlbedoViews.resize(imageCount());
+  gBufferNormalViews.resize(imageCount());
+
+  for (size_t i = 0; i < gBufferImages.size(); i++) {
+    VkFormat format = i % 2 == 0 ? GBUFFER_ALBEDO_FORMAT : GBUFFER_NORMAL_FORMAT;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = swapChainExtent.width;
+    imageInfo.extent.height = swapChainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    device.createImageWithInfo(imageInfo, memoryProperties, gBufferImages[i], gBufferImageMemorys[i]);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = gBufferImages[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    VkImageView& view = i % 2 == 0 ? gBufferAlbedoViews[i / 2] : gBufferNormalViews[i / 2];
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create G-buffer image view!");
+    }
+  }
+}
+
 void LveSwapChain::createSyncObjects() {
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -430,7 +617,7 @@ VkFormat LveSwapChain::findDepthFormat() {
   return device.findSupportedFormat(
       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
       VK_IMAGE_TILING_OPTIMAL,
-      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 }  // namespace lve
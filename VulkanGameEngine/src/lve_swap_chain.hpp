@@ -13,11 +13,18 @@
 
 namespace lve {
 
+// Forward shades in a single subpass. Deferred writes albedo and normals to a G-buffer in subpass 0 and shades in
+// subpass 1 from input attachments, so the G-buffer can stay in tile memory on tile based GPUs.
+enum class LveRenderPath { Forward, Deferred };
+
 class LveSwapChain {
 public:
     static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    static constexpr VkFormat GBUFFER_ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr VkFormat GBUFFER_NORMAL_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
 
-    LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent);
+    LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, LveRenderPath renderPath = LveRenderPath::Forward);
+    // keeps the render path of previous
     LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> previous);
     ~LveSwapChain();
 
@@ -27,6 +34,14 @@ public:
     VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
     VkRenderPass getRenderPass() { return renderPass; }
     VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+    VkImage getDepthImage(int index) { return depthImages[index]; }
+    VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+    VkFormat getDepthFormat() { return swapChainDepthFormat; }
+    VkImageView getGBufferAlbedoView(int index) { return gBufferAlbedoViews[index]; }
+    VkImageView getGBufferNormalView(int index) { return gBufferNormalViews[index]; }
+    LveRenderPath getRenderPath() const { return renderPath; }
+    // subpass lights and transparent objects are drawn in, after the G-buffer one when deferred
+    uint32_t getLightingSubpass() const { return renderPath == LveRenderPath::Deferred ? 1 : 0; }
     size_t imageCount() { return swapChainImages.size(); }
     VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
     VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -44,7 +59,8 @@ public:
     bool compareSwapFormats(const LveSwapChain& swapChain) const {
         return
             swapChain.swapChainDepthFormat == swapChainDepthFormat &&
-            swapChain.swapChainImageFormat == swapChainImageFormat;
+            swapChain.swapChainImageFormat == swapChainImageFormat &&
+            swapChain.renderPath == renderPath;
     }
 
     private:
@@ -52,7 +68,9 @@ public:
         void createSwapChain();
         void createImageViews();
         void createDepthResources();
+        void createGBufferResources();
         void createRenderPass();
+        void createDeferredRenderPass();
         void createFramebuffers();
         void createSyncObjects();
 
@@ -71,13 +89,19 @@ public:
     VkRenderPass renderPass;
 
     std::vector<VkImage> depthImages;
-    std::vector<VkDeviceMemory> depthImageMemorys;
+    std::vector<LveAllocation> depthImageMemorys;
     std::vector<VkImageView> depthImageViews;
+    // albedo and normal of each swap chain image, only created for the deferred path
+    std::vector<VkImage> gBufferImages;
+    std::vector<LveAllocation> gBufferImageMemorys;
+    std::vector<VkImageView> gBufferAlbedoViews;
+    std::vector<VkImageView> gBufferNormalViews;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
 
     LveDevice &device;
     VkExtent2D windowExtent;
+    LveRenderPath renderPath;
 
     VkSwapchainKHR swapChain;
     std::shared_ptr<LveSwapChain> oldSwapChain;
@@ -0,0 +1,170 @@
+#include "lve_task_graph.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+
+namespace lve {
+
+	LveTaskGraph::TaskId LveTaskGraph::addTask(
+		std::string name,
+		std::function<void()> fn,
+		std::vector<const void*> reads,
+		std::vector<const void*> writes)
+	{
+		return add(std::move(name), std::move(fn), std::move(reads), std::move(writes), false);
+	}
+
+	LveTaskGraph::TaskId LveTaskGraph::addMainThreadTask(
+		std::string name,
+		std::function<void()> fn,
+		std::vector<const void*> reads,
+		std::vector<const void*> writes)
+	{
+		return add(std::move(name), std::move(fn), std::move(reads), std::move(writes), true);
+	}
+
+	LveTaskGraph::TaskId LveTaskGraph::add(
+		std::string name,
+		std::function<void()> fn,
+		std::vector<const void*> reads,
+		std::vector<const void*> writes,
+		bool mainThread)
+	{
+		Task task{};
+		task.name = std::move(name);
+		task.fn = std::move(fn);
+		task.reads = std::move(reads);
+		task.writes = std::move(writes);
+		task.mainThread = mainThread;
+
+		TaskId id = static_cast<TaskId>(tasks.size());
+		auto touches = [](const std::vector<const void*>& data, const void* address) {
+			return std::find(data.begin(), data.end(), address) != data.end();
+		};
+
+		// after every earlier task writing what this one reads, or touching what it writes
+		for (TaskId earlier = 0; earlier < id; earlier++)
+		{
+			Task& other = tasks[earlier];
+			bool conflict = false;
+			for (const void* address : task.reads) {
+				conflict = conflict || touches(other.writes, address);
+			}
+			for (const void* address : task.writes) {
+				conflict = conflict || touches(other.reads, address) || touches(other.writes, address);
+			}
+			if (conflict)
+			{
+				other.dependents.push_back(id);
+				task.dependencyCount++;
+			}
+		}
+
+		tasks.push_back(std::move(task));
+		timings.resize(tasks.size());
+		return id;
+	}
+
+	void LveTaskGraph::addDependency(TaskId before, TaskId after)
+	{
+		assert(before < after && after < tasks.size() && "Dependencies have to point at tasks added later!");
+
+		std::vector<TaskId>& dependents = tasks[before].dependents;
+		if (std::find(dependents.begin(), dependents.end(), after) == dependents.end())
+		{
+			dependents.push_back(after);
+			tasks[after].dependencyCount++;
+		}
+	}
+
+	void LveTaskGraph::run()
+	{
+		uint32_t taskCount = getTaskCount();
+		if (taskCount == 0) {
+			return;
+		}
+
+		if (remainingDependencies.size() != taskCount) {
+			remainingDependencies = std::vector<std::atomic<uint32_t>>(taskCount);
+		}
+		for (TaskId i = 0; i < taskCount; i++) {
+			remainingDependencies[i].store(tasks[i].dependencyCount, std::memory_order_relaxed);
+		}
+		remainingTasks.store(taskCount, std::memory_order_relaxed);
+		mainThreadReadyCount.store(0, std::memory_order_relaxed);
+		mainThreadReady.clear();
+		runStart = std::chrono::high_resolution_clock::now();
+
+		for (TaskId i = 0; i < taskCount; i++) {
+			if (tasks[i].dependencyCount == 0) {
+				schedule(i);
+			}
+		}
+
+		// run main thread tasks as they become ready, and pool tasks in between
+		while (remainingTasks.load(std::memory_order_acquire) > 0)
+		{
+			pool.waitUntil([this] {
+				return mainThreadReadyCount.load(std::memory_order_acquire) > 0
+					|| remainingTasks.load(std::memory_order_acquire) == 0;
+			});
+
+			while (mainThreadReadyCount.load(std::memory_order_acquire) > 0)
+			{
+				TaskId task;
+				{
+					std::lock_guard<std::mutex> lock{ mainThreadMutex };
+					task = mainThreadReady.back();
+					mainThreadReady.pop_back();
+					mainThreadReadyCount.fetch_sub(1, std::memory_order_relaxed);
+				}
+				execute(task);
+			}
+		}
+		// the last task may still be returning to the pool
+		pool.wait(poolPending);
+
+		if (timingCallback) {
+			for (const TaskTiming& timing : timings) {
+				timingCallback(timing);
+			}
+		}
+	}
+
+	void LveTaskGraph::schedule(TaskId task)
+	{
+		if (tasks[task].mainThread)
+		{
+			std::lock_guard<std::mutex> lock{ mainThreadMutex };
+			mainThreadReady.push_back(task);
+			mainThreadReadyCount.fetch_add(1, std::memory_order_release);
+		}
+		else {
+			pool.submit([this, task] { execute(task); }, poolPending);
+		}
+	}
+
+	void LveTaskGraph::execute(TaskId task)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		tasks[task].fn();
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		using Milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>;
+		timings[task] = TaskTiming{
+			&tasks[task].name,
+			pool.getCurrentThreadIndex(),
+			Milliseconds(startTime - runStart).count(),
+			Milliseconds(endTime - startTime).count() };
+
+		for (TaskId dependent : tasks[task].dependents) {
+			if (remainingDependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				schedule(dependent);
+			}
+		}
+		remainingTasks.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+} // namespace lve
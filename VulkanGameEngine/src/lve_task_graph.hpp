@@ -0,0 +1,105 @@
+#pragma once
+
+#include "lve_thread_pool.hpp"
+
+// std
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace lve {
+
+	// Per frame systems as tasks with the data they read and write, run on a thread pool as soon as the tasks they
+	// depend on finished. Data is named by its address, e.g. &camera or &registry.pool<TransformComponent>().
+	//
+	// A task depends on the earlier added tasks writing what it reads, and on those reading or writing what it
+	// writes, so running the graph has the same effect as running the tasks one after another in the order they were
+	// added. The graph is built once and run every frame, and tasks must not throw.
+	class LveTaskGraph {
+
+	public:
+		using TaskId = uint32_t;
+
+		struct TaskTiming
+		{
+			const std::string* name;
+			// as in LveThreadPool::getCurrentThreadIndex, 0 is the thread calling run()
+			uint32_t threadIndex;
+			// milliseconds since run() was called
+			float start;
+			float duration;
+		};
+
+		explicit LveTaskGraph(LveThreadPool& pool = LveThreadPool::shared()) : pool{ pool } {}
+
+		LveTaskGraph(const LveTaskGraph&) = delete;
+		LveTaskGraph& operator=(const LveTaskGraph&) = delete;
+
+		TaskId addTask(
+			std::string name,
+			std::function<void()> fn,
+			std::vector<const void*> reads = {},
+			std::vector<const void*> writes = {});
+		// same as addTask, for work that has to stay on the thread calling run(), like polling input
+		TaskId addMainThreadTask(
+			std::string name,
+			std::function<void()> fn,
+			std::vector<const void*> reads = {},
+			std::vector<const void*> writes = {});
+		// an ordering the data does not show, before has to be added first
+		void addDependency(TaskId before, TaskId after);
+
+		// runs every task once and returns when all of them finished
+		void run();
+
+		uint32_t getTaskCount() const { return static_cast<uint32_t>(tasks.size()); }
+		// timings of the last run, by task id
+		const std::vector<TaskTiming>& getTimings() const { return timings; }
+		// called on the thread calling run() for each task after it, in task order
+		void setTimingCallback(std::function<void(const TaskTiming&)> callback) { timingCallback = std::move(callback); }
+
+	private:
+		struct Task
+		{
+			std::string name;
+			std::function<void()> fn;
+			std::vector<const void*> reads;
+			std::vector<const void*> writes;
+			bool mainThread = false;
+			std::vector<TaskId> dependents;
+			// tasks this one waits for
+			uint32_t dependencyCount = 0;
+		};
+
+		TaskId add(
+			std::string name,
+			std::function<void()> fn,
+			std::vector<const void*> reads,
+			std::vector<const void*> writes,
+			bool mainThread);
+		// queues a task whose dependencies finished, to the pool or the calling thread
+		void schedule(TaskId task);
+		void execute(TaskId task);
+
+		LveThreadPool& pool;
+		std::vector<Task> tasks;
+
+		// state of the current run
+		std::vector<std::atomic<uint32_t>> remainingDependencies;
+		std::atomic<uint32_t> remainingTasks{ 0 };
+		std::atomic<uint32_t> poolPending{ 0 };
+		std::mutex mainThreadMutex;
+		std::vector<TaskId> mainThreadReady;
+		std::atomic<uint32_t> mainThreadReadyCount{ 0 };
+		std::chrono::high_resolution_clock::time_point runStart;
+
+		std::vector<TaskTiming> timings;
+		std::function<void(const TaskTiming&)> timingCallback;
+	};
+
+} // namespace lve
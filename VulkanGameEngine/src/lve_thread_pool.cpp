@@ -0,0 +1,206 @@
+#include "lve_thread_pool.hpp"
+
+// std
+#include <algorithm>
+
+
+namespace lve {
+
+	// the pool the current thread works for and its index there, so tasks queue to their own worker's deque
+	static thread_local const LveThreadPool* currentPool = nullptr;
+	static thread_local uint32_t currentWorker = 0;
+
+	LveThreadPool::LveThreadPool(uint32_t workerCount)
+	{
+		queues.reserve(workerCount + 1);
+		for (uint32_t i = 0; i <= workerCount; i++) {
+			queues.push_back(std::make_unique<Queue>());
+		}
+
+		workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++) {
+			workers.emplace_back([this, i] { workerLoop(i); });
+		}
+	}
+
+	LveThreadPool::~LveThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+			stopping = true;
+		}
+		taskAvailable.notify_all();
+
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	LveThreadPool& LveThreadPool::shared()
+	{
+		static LveThreadPool pool{ std::max(1u, std::thread::hardware_concurrency()) - 1 };
+		return pool;
+	}
+
+	uint32_t LveThreadPool::getCurrentThreadIndex() const
+	{
+		return currentPool == this ? currentWorker + 1 : 0;
+	}
+
+	void LveThreadPool::parallelFor(
+		uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& fn, uint32_t minRangeSize)
+	{
+		if (count == 0) {
+			return;
+		}
+
+		// a few ranges per thread so uneven ranges still balance out
+		uint32_t rangeCount = std::min(getThreadCount() * 4, (count + minRangeSize - 1) / std::max(1u, minRangeSize));
+		if (rangeCount <= 1) {
+			fn(0, count);
+			return;
+		}
+
+		// queued back to front, so this thread pops the ranges next to the first one while the others steal the far end
+		std::atomic<uint32_t> pending{ rangeCount - 1 };
+		std::vector<Task> batch;
+		batch.reserve(rangeCount - 1);
+		for (uint32_t i = rangeCount - 1; i >= 1; i--) {
+			uint32_t begin = static_cast<uint32_t>(uint64_t{ count } * i / rangeCount);
+			uint32_t end = static_cast<uint32_t>(uint64_t{ count } * (i + 1) / rangeCount);
+			batch.push_back({ [&fn, begin, end] { fn(begin, end); }, &pending });
+		}
+		push(batch);
+
+		fn(0, static_cast<uint32_t>(uint64_t{ count } / rangeCount));
+
+		wait(pending);
+	}
+
+	void LveThreadPool::submit(std::function<void()> fn, std::atomic<uint32_t>& pending)
+	{
+		pending.fetch_add(1, std::memory_order_relaxed);
+		std::vector<Task> batch;
+		batch.push_back({ std::move(fn), &pending });
+		push(batch);
+	}
+
+	void LveThreadPool::wait(const std::atomic<uint32_t>& pending)
+	{
+		waitUntil([&pending] { return pending.load(std::memory_order_acquire) == 0; });
+	}
+
+	void LveThreadPool::waitUntil(const std::function<bool()>& done)
+	{
+		// help with queued work instead of idling until our tasks are done
+		while (!done()) {
+			if (!runPendingTask()) {
+				std::unique_lock<std::mutex> lock{ sleepMutex };
+				taskFinished.wait(lock, [&] { return done() || queuedCount.load(std::memory_order_acquire) > 0; });
+			}
+		}
+	}
+
+	LveThreadPool::Queue& LveThreadPool::localQueue()
+	{
+		return currentPool == this ? *queues[currentWorker] : *queues.back();
+	}
+
+	void LveThreadPool::push(std::vector<Task>& batch)
+	{
+		Queue& queue = localQueue();
+		{
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			for (Task& task : batch) {
+				queue.tasks.push_back(std::move(task));
+			}
+			// counted before a thief can take them, so the count never drops below the tasks taken
+			queuedCount.fetch_add(static_cast<uint32_t>(batch.size()), std::memory_order_release);
+		}
+
+		{
+			// taken so a thread checking queuedCount before going to sleep can not miss the notification
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+		}
+		if (batch.size() == 1) {
+			taskAvailable.notify_one();
+		}
+		else {
+			taskAvailable.notify_all();
+		}
+	}
+
+	bool LveThreadPool::popTask(Task& task)
+	{
+		if (queuedCount.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+
+		// newest of our own tasks first
+		Queue& own = localQueue();
+		{
+			std::lock_guard<std::mutex> lock{ own.mutex };
+			if (!own.tasks.empty())
+			{
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				queuedCount.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		// then the oldest task of another deque, the victims taken in turn starting after our own
+		uint32_t queueCount = static_cast<uint32_t>(queues.size());
+		uint32_t ownIndex = static_cast<uint32_t>(&own == queues.back().get() ? queueCount - 1 : currentWorker);
+		for (uint32_t i = 1; i < queueCount; i++)
+		{
+			Queue& victim = *queues[(ownIndex + i) % queueCount];
+			std::lock_guard<std::mutex> lock{ victim.mutex };
+			if (!victim.tasks.empty())
+			{
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				queuedCount.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool LveThreadPool::runPendingTask()
+	{
+		Task task;
+		if (!popTask(task)) {
+			return false;
+		}
+
+		task.fn();
+
+		{
+			// decrement under the lock so a waiter cannot miss the notification
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+			task.pending->fetch_sub(1, std::memory_order_release);
+		}
+		taskFinished.notify_all();
+		return true;
+	}
+
+	void LveThreadPool::workerLoop(uint32_t workerIndex)
+	{
+		currentPool = this;
+		currentWorker = workerIndex;
+
+		while (true) {
+			if (runPendingTask()) {
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock{ sleepMutex };
+			taskAvailable.wait(lock, [this] { return stopping || queuedCount.load(std::memory_order_acquire) > 0; });
+			if (stopping && queuedCount.load(std::memory_order_acquire) == 0) {
+				return;
+			}
+		}
+	}
+
+} // namespace lve
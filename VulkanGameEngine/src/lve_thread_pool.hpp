@@ -0,0 +1,78 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace lve {
+
+	// Work stealing thread pool. Each worker has a deque of its own, pushing and popping the tasks it queues at the
+	// back, so nested work stays on the thread that has its data in cache. Idle workers steal from the front of the
+	// others' deques, and threads outside the pool queue to a shared deque the workers steal from.
+	class LveThreadPool {
+
+	public:
+		// workerCount excludes the calling thread, which always helps while waiting
+		explicit LveThreadPool(uint32_t workerCount);
+		~LveThreadPool();
+
+		LveThreadPool(const LveThreadPool&) = delete;
+		LveThreadPool& operator=(const LveThreadPool&) = delete;
+
+		// pool sized to the machine, shared by loaders and systems
+		static LveThreadPool& shared();
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+		// 1 + worker index on the pool's workers, 0 on every other thread
+		uint32_t getCurrentThreadIndex() const;
+
+		// Splits [0, count) into contiguous ranges and blocks until fn(begin, end) ran for all of them
+		void parallelFor(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& fn, uint32_t minRangeSize = 1);
+
+		// Queues fn without waiting for it, pending is decremented once it returned. fn must not throw.
+		void submit(std::function<void()> fn, std::atomic<uint32_t>& pending);
+		// runs queued tasks until pending reaches zero, so waiting never stalls a pool without workers
+		void wait(const std::atomic<uint32_t>& pending);
+		// Runs queued tasks until done returns true. done is checked under a lock each time a task finishes, so it
+		// has to be cheap and may only become true through the pool's tasks or the calling thread.
+		void waitUntil(const std::function<bool()>& done);
+
+	private:
+		struct Task {
+			std::function<void()> fn;
+			std::atomic<uint32_t>* pending;
+		};
+
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		void workerLoop(uint32_t workerIndex);
+		// the calling worker's deque, or the shared one for threads outside the pool
+		Queue& localQueue();
+		void push(std::vector<Task>& batch);
+		bool popTask(Task& task);
+		bool runPendingTask();
+
+		std::vector<std::thread> workers;
+		// one per worker, the last is shared by the threads outside the pool
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::atomic<uint32_t> queuedCount{ 0 };
+
+		// idle threads sleep here, workers until a task is queued and waiters until a task finished
+		std::mutex sleepMutex;
+		std::condition_variable taskAvailable;
+		std::condition_variable taskFinished;
+		bool stopping = false;
+	};
+
+} // namespace lve
@@ -0,0 +1,250 @@
+#include "lve_transform_batch.hpp"
+
+// std
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+#define LVE_TRANSFORM_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LVE_TRANSFORM_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define LVE_TRANSFORM_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace lve {
+
+	namespace {
+
+#if defined(LVE_TRANSFORM_AVX2)
+		// the few operations the kernel needs, so it is written once for every instruction set
+		struct Lanes
+		{
+			static constexpr uint32_t COUNT = 8;
+			using Float = __m256;
+			using Int = __m256i;
+			using Mask = __m256;
+
+			static Float load(const float* p) { return _mm256_loadu_ps(p); }
+			static void store(float* p, Float a) { _mm256_storeu_ps(p, a); }
+			static Float set(float a) { return _mm256_set1_ps(a); }
+			static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+			static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+			static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+			static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+			static Float neg(Float a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+			static Int roundToInt(Float a) { return _mm256_cvtps_epi32(a); }
+			static Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+			static Int addInt(Int a, int b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+			static Mask hasBit(Int a, int bit)
+			{
+				__m256i b = _mm256_set1_epi32(bit);
+				return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, b), b));
+			}
+			static Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+			static Float negateIf(Mask m, Float a) { return _mm256_xor_ps(a, _mm256_and_ps(m, _mm256_set1_ps(-0.0f))); }
+		};
+#elif defined(LVE_TRANSFORM_SSE)
+		struct Lanes
+		{
+			static constexpr uint32_t COUNT = 4;
+			using Float = __m128;
+			using Int = __m128i;
+			using Mask = __m128;
+
+			static Float load(const float* p) { return _mm_loadu_ps(p); }
+			static void store(float* p, Float a) { _mm_storeu_ps(p, a); }
+			static Float set(float a) { return _mm_set1_ps(a); }
+			static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+			static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+			static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+			static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+			static Float neg(Float a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+			static Int roundToInt(Float a) { return _mm_cvtps_epi32(a); }
+			static Float toFloat(Int a) { return _mm_cvtepi32_ps(a); }
+			static Int addInt(Int a, int b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+			static Mask hasBit(Int a, int bit)
+			{
+				__m128i b = _mm_set1_epi32(bit);
+				return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, b), b));
+			}
+			static Float select(Mask m, Float a, Float b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+			static Float negateIf(Mask m, Float a) { return _mm_xor_ps(a, _mm_and_ps(m, _mm_set1_ps(-0.0f))); }
+		};
+#elif defined(LVE_TRANSFORM_NEON)
+		struct Lanes
+		{
+			static constexpr uint32_t COUNT = 4;
+			using Float = float32x4_t;
+			using Int = int32x4_t;
+			using Mask = uint32x4_t;
+
+			static Float load(const float* p) { return vld1q_f32(p); }
+			static void store(float* p, Float a) { vst1q_f32(p, a); }
+			static Float set(float a) { return vdupq_n_f32(a); }
+			static Float add(Float a, Float b) { return vaddq_f32(a, b); }
+			static Float sub(Float a, Float b) { return vsubq_f32(a, b); }
+			static Float mul(Float a, Float b) { return vmulq_f32(a, b); }
+			static Float div(Float a, Float b) { return vdivq_f32(a, b); }
+			static Float neg(Float a) { return vnegq_f32(a); }
+			static Int roundToInt(Float a) { return vcvtnq_s32_f32(a); }
+			static Float toFloat(Int a) { return vcvtq_f32_s32(a); }
+			static Int addInt(Int a, int b) { return vaddq_s32(a, vdupq_n_s32(b)); }
+			static Mask hasBit(Int a, int bit) { return vtstq_s32(a, vdupq_n_s32(bit)); }
+			static Float select(Mask m, Float a, Float b) { return vbslq_f32(m, a, b); }
+			static Float negateIf(Mask m, Float a)
+			{
+				return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vandq_u32(m, vdupq_n_u32(0x80000000u))));
+			}
+		};
+#endif
+
+#if defined(LVE_TRANSFORM_AVX2) || defined(LVE_TRANSFORM_SSE) || defined(LVE_TRANSFORM_NEON)
+		// Sine and cosine of the same angles. The angle is reduced to [-pi/4, pi/4] around the nearest multiple of pi/2,
+		// with pi/2 split in three parts to keep the reduction exact, then each is a minimax polynomial (from Cephes).
+		void sinCos(Lanes::Float x, Lanes::Float& sine, Lanes::Float& cosine)
+		{
+			Lanes::Int quadrant = Lanes::roundToInt(Lanes::mul(x, Lanes::set(0.636619772367581343f)));
+			Lanes::Float q = Lanes::toFloat(quadrant);
+			Lanes::Float r = Lanes::sub(x, Lanes::mul(q, Lanes::set(1.5703125f)));
+			r = Lanes::sub(r, Lanes::mul(q, Lanes::set(4.837512969970703125e-4f)));
+			r = Lanes::sub(r, Lanes::mul(q, Lanes::set(7.54978995489188216e-8f)));
+			Lanes::Float r2 = Lanes::mul(r, r);
+
+			Lanes::Float s = Lanes::add(Lanes::mul(Lanes::set(-1.9515295891e-4f), r2), Lanes::set(8.3321608736e-3f));
+			s = Lanes::add(Lanes::mul(s, r2), Lanes::set(-1.6666654611e-1f));
+			s = Lanes::add(Lanes::mul(Lanes::mul(s, r2), r), r);
+
+			Lanes::Float c = Lanes::add(Lanes::mul(Lanes::set(2.443315711809948e-5f), r2), Lanes::set(-1.388731625493765e-3f));
+			c = Lanes::add(Lanes::mul(c, r2), Lanes::set(4.166664568298827e-2f));
+			c = Lanes::add(Lanes::mul(Lanes::mul(c, r2), r2), Lanes::sub(Lanes::set(1.0f), Lanes::mul(r2, Lanes::set(0.5f))));
+
+			// odd quadrants swap the two, sine is negative in quadrants 2 and 3, cosine in 1 and 2
+			Lanes::Mask swap = Lanes::hasBit(quadrant, 1);
+			sine = Lanes::negateIf(Lanes::hasBit(quadrant, 2), Lanes::select(swap, c, s));
+			cosine = Lanes::negateIf(Lanes::hasBit(Lanes::addInt(quadrant, 1), 2), Lanes::select(swap, s, c));
+		}
+#endif
+
+	} // namespace
+
+	void LveTransformBatch::resize(uint32_t newCount)
+	{
+		count = newCount;
+
+		uint32_t paddedCount = count + LANE_COUNT;
+		translationX.resize(paddedCount);
+		translationY.resize(paddedCount);
+		translationZ.resize(paddedCount);
+		rotationX.resize(paddedCount);
+		rotationY.resize(paddedCount);
+		rotationZ.resize(paddedCount);
+		scaleX.resize(paddedCount, 1.0f);
+		scaleY.resize(paddedCount, 1.0f);
+		scaleZ.resize(paddedCount, 1.0f);
+	}
+
+	void LveTransformBatch::build(uint32_t begin, uint32_t end, glm::mat4* modelMatrices, glm::mat3* normalMatrices) const
+	{
+		assert(end <= count && "Transform range is past the end of the batch!");
+
+#if defined(LVE_TRANSFORM_AVX2) || defined(LVE_TRANSFORM_SSE) || defined(LVE_TRANSFORM_NEON)
+		// rotation columns, then the model and normal matrix columns, one lane per object
+		float model[12][Lanes::COUNT];
+		float normal[9][Lanes::COUNT];
+
+		for (uint32_t i = begin; i < end; i += Lanes::COUNT)
+		{
+			Lanes::Float s1, c1, s2, c2, s3, c3;
+			sinCos(Lanes::load(&rotationY[i]), s1, c1);
+			sinCos(Lanes::load(&rotationX[i]), s2, c2);
+			sinCos(Lanes::load(&rotationZ[i]), s3, c3);
+
+			// same products in the same order as TransformComponent
+			Lanes::Float s1s2 = Lanes::mul(s1, s2);
+			Lanes::Float c1s2 = Lanes::mul(c1, s2);
+			Lanes::Float rotation[9] = {
+				Lanes::add(Lanes::mul(c1, c3), Lanes::mul(s1s2, s3)),
+				Lanes::mul(c2, s3),
+				Lanes::sub(Lanes::mul(c1s2, s3), Lanes::mul(c3, s1)),
+				Lanes::sub(Lanes::mul(Lanes::mul(c3, s1), s2), Lanes::mul(c1, s3)),
+				Lanes::mul(c2, c3),
+				Lanes::add(Lanes::mul(Lanes::mul(c1, c3), s2), Lanes::mul(s1, s3)),
+				Lanes::mul(c2, s1),
+				Lanes::neg(s2),
+				Lanes::mul(c1, c2),
+			};
+
+			Lanes::Float scale[3] = { Lanes::load(&scaleX[i]), Lanes::load(&scaleY[i]), Lanes::load(&scaleZ[i]) };
+			const Lanes::Float one = Lanes::set(1.0f);
+			for (int column = 0; column < 3; column++)
+			{
+				Lanes::Float invScale = Lanes::div(one, scale[column]);
+				for (int row = 0; row < 3; row++)
+				{
+					Lanes::store(model[column * 3 + row], Lanes::mul(scale[column], rotation[column * 3 + row]));
+					Lanes::store(normal[column * 3 + row], Lanes::mul(invScale, rotation[column * 3 + row]));
+				}
+			}
+			Lanes::store(model[9], Lanes::load(&translationX[i]));
+			Lanes::store(model[10], Lanes::load(&translationY[i]));
+			Lanes::store(model[11], Lanes::load(&translationZ[i]));
+
+			uint32_t laneCount = end - i < Lanes::COUNT ? end - i : Lanes::COUNT;
+			for (uint32_t lane = 0; lane < laneCount; lane++)
+			{
+				if (modelMatrices != nullptr)
+				{
+					glm::mat4& m = modelMatrices[i + lane];
+					m[0] = { model[0][lane], model[1][lane], model[2][lane], 0.0f };
+					m[1] = { model[3][lane], model[4][lane], model[5][lane], 0.0f };
+					m[2] = { model[6][lane], model[7][lane], model[8][lane], 0.0f };
+					m[3] = { model[9][lane], model[10][lane], model[11][lane], 1.0f };
+				}
+				if (normalMatrices != nullptr)
+				{
+					glm::mat3& n = normalMatrices[i + lane];
+					n[0] = { normal[0][lane], normal[1][lane], normal[2][lane] };
+					n[1] = { normal[3][lane], normal[4][lane], normal[5][lane] };
+					n[2] = { normal[6][lane], normal[7][lane], normal[8][lane] };
+				}
+			}
+		}
+#else
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const float c3 = std::cos(rotationZ[i]);
+			const float s3 = std::sin(rotationZ[i]);
+			const float c2 = std::cos(rotationX[i]);
+			const float s2 = std::sin(rotationX[i]);
+			const float c1 = std::cos(rotationY[i]);
+			const float s1 = std::sin(rotationY[i]);
+
+			const glm::mat3 rotation{
+				{ c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1 },
+				{ c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3 },
+				{ c2 * s1, -s2, c1 * c2 },
+			};
+			const glm::vec3 scale{ scaleX[i], scaleY[i], scaleZ[i] };
+			const glm::vec3 invScale = 1.0f / scale;
+
+			if (modelMatrices != nullptr)
+			{
+				modelMatrices[i] = glm::mat4{
+					glm::vec4{ scale.x * rotation[0], 0.0f },
+					glm::vec4{ scale.y * rotation[1], 0.0f },
+					glm::vec4{ scale.z * rotation[2], 0.0f },
+					glm::vec4{ translationX[i], translationY[i], translationZ[i], 1.0f } };
+			}
+			if (normalMatrices != nullptr) {
+				normalMatrices[i] = glm::mat3{ invScale.x * rotation[0], invScale.y * rotation[1], invScale.z * rotation[2] };
+			}
+		}
+#endif
+	}
+
+} // namespace lve
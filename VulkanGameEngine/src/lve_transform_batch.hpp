@@ -0,0 +1,62 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+
+namespace lve {
+
+	// Translations, Euler rotations and scales of many objects as structure of arrays, turned into model and normal
+	// matrices several objects at a time: 8 with AVX2, 4 with SSE2 or NEON. Uses the convention of
+	// TransformComponent::mat4 (Translate * Ry * Rx * Rz * Scale), for scenes where most objects move every frame
+	// and its cache does not help. The SIMD paths evaluate sin and cos with their own polynomial, so results may
+	// differ from TransformComponent in the last bits. Angles should stay within a few thousand radians.
+	class LveTransformBatch {
+
+	public:
+		// widest batch the SIMD paths build, the arrays have this many entries past the end so any range can load it
+		static constexpr uint32_t LANE_COUNT = 8;
+
+		// sizes the arrays for count objects, which are then written by index
+		void resize(uint32_t count);
+		uint32_t size() const { return count; }
+
+		// different indices may be written from different threads
+		void set(uint32_t index, const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale)
+		{
+			translationX[index] = translation.x;
+			translationY[index] = translation.y;
+			translationZ[index] = translation.z;
+			rotationX[index] = rotation.x;
+			rotationY[index] = rotation.y;
+			rotationZ[index] = rotation.z;
+			scaleX[index] = scale.x;
+			scaleY[index] = scale.y;
+			scaleZ[index] = scale.z;
+		}
+
+		// writes the matrices of objects begin to end - 1 at the same indices of the outputs, either of which may be
+		// null. Disjoint ranges may be built from different threads.
+		void build(uint32_t begin, uint32_t end, glm::mat4* modelMatrices, glm::mat3* normalMatrices) const;
+
+		std::vector<float> translationX;
+		std::vector<float> translationY;
+		std::vector<float> translationZ;
+		std::vector<float> rotationX;
+		std::vector<float> rotationY;
+		std::vector<float> rotationZ;
+		std::vector<float> scaleX;
+		std::vector<float> scaleY;
+		std::vector<float> scaleZ;
+
+	private:
+		uint32_t count = 0;
+	};
+
+} // namespace lve
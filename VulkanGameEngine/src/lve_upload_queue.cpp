@@ -0,0 +1,217 @@
+#include "lve_upload_queue.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace lve {
+
+	// copies are split so a single large upload cannot occupy the whole ring
+	static constexpr uint32_t MAX_CHUNKS_PER_RING = 4;
+	static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	LveUploadQueue::LveUploadQueue(LveDevice& device, VkDeviceSize stagingSize)
+		: lveDevice{ device }, stagingSize{ stagingSize }
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = lveDevice.transferQueueFamily();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create upload command pool!");
+		}
+
+		stagingBuffer = std::make_unique<LveBuffer>(
+			lveDevice,
+			stagingSize,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		stagingBuffer->map();
+	}
+
+	LveUploadQueue::~LveUploadQueue()
+	{
+		waitIdle();
+
+		for (auto& batch : freeBatches)
+		{
+			vkDestroyFence(lveDevice.device(), batch.fence, nullptr);
+			vkFreeCommandBuffers(lveDevice.device(), commandPool, 1, &batch.commandBuffer);
+		}
+		vkDestroyCommandPool(lveDevice.device(), commandPool, nullptr);
+	}
+
+	void LveUploadQueue::beginBatch()
+	{
+		if (freeBatches.empty())
+		{
+			Batch batch{};
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate upload command buffer!");
+			}
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			if (vkCreateFence(lveDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create upload fence!");
+			}
+
+			freeBatches.push_back(batch);
+		}
+
+		currentBatch = freeBatches.back();
+		freeBatches.pop_back();
+		currentBatch.ticket = nextTicket;
+
+		vkResetCommandBuffer(currentBatch.commandBuffer, 0);
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(currentBatch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin upload command buffer!");
+		}
+		recording = true;
+	}
+
+	void LveUploadQueue::retireOldest(bool block)
+	{
+		assert(!batchesInFlight.empty() && "No upload batch in flight!");
+		Batch batch = batchesInFlight.front();
+
+		if (block) {
+			vkWaitForFences(lveDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		}
+		else if (vkGetFenceStatus(lveDevice.device(), batch.fence) != VK_SUCCESS) {
+			return;
+		}
+
+		vkResetFences(lveDevice.device(), 1, &batch.fence);
+		ringTail = batch.ringEnd;
+		completedTicket = batch.ticket;
+		batchesInFlight.pop_front();
+		freeBatches.push_back(batch);
+	}
+
+	VkDeviceSize LveUploadQueue::allocateStaging(VkDeviceSize size)
+	{
+		assert(size <= stagingSize && "Upload chunk larger than the staging ring!");
+
+		uint64_t start = (ringHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+		// skip the end of the ring if the chunk would wrap around
+		if (start % stagingSize + size > stagingSize) {
+			start += stagingSize - start % stagingSize;
+		}
+
+		while (start + size - ringTail > stagingSize)
+		{
+			if (batchesInFlight.empty())
+			{
+				// the ring is full of copies that were never submitted
+				submit();
+				if (batchesInFlight.empty()) {
+					throw std::runtime_error("Staging ring too small for upload!");
+				}
+			}
+			retireOldest(true);
+		}
+
+		ringHead = start + size;
+		return start % stagingSize;
+	}
+
+	LveUploadQueue::Ticket LveUploadQueue::uploadBuffer(
+		VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		VkDeviceSize maxChunk = stagingSize / MAX_CHUNKS_PER_RING;
+		const char* source = static_cast<const char*>(data);
+
+		for (VkDeviceSize copied = 0; copied < size;)
+		{
+			VkDeviceSize chunk = std::min(size - copied, maxChunk);
+			VkDeviceSize stagingOffset = allocateStaging(chunk);
+
+			// allocating may have submitted the batch we were recording into
+			if (!recording) {
+				beginBatch();
+			}
+
+			std::memcpy(static_cast<char*>(stagingBuffer->getMappedMemory()) + stagingOffset, source + copied, chunk);
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = stagingOffset;
+			copyRegion.dstOffset = dstOffset + copied;
+			copyRegion.size = chunk;
+			vkCmdCopyBuffer(currentBatch.commandBuffer, stagingBuffer->getBuffer(), dstBuffer, 1, &copyRegion);
+
+			copied += chunk;
+		}
+
+		return nextTicket;
+	}
+
+	void LveUploadQueue::submit()
+	{
+		if (!recording) {
+			return;
+		}
+
+		if (vkEndCommandBuffer(currentBatch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record upload command buffer!");
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &currentBatch.commandBuffer;
+
+		if (vkQueueSubmit(lveDevice.transferQueue(), 1, &submitInfo, currentBatch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit upload batch!");
+		}
+
+		currentBatch.ringEnd = ringHead;
+		batchesInFlight.push_back(currentBatch);
+		recording = false;
+		nextTicket++;
+	}
+
+	bool LveUploadQueue::isComplete(Ticket ticket)
+	{
+		while (!batchesInFlight.empty() && completedTicket < ticket)
+		{
+			Ticket oldest = batchesInFlight.front().ticket;
+			retireOldest(false);
+			if (completedTicket < oldest) break;
+		}
+		return completedTicket >= ticket;
+	}
+
+	void LveUploadQueue::wait(Ticket ticket)
+	{
+		if (recording && ticket >= currentBatch.ticket) {
+			submit();
+		}
+		while (!batchesInFlight.empty() && completedTicket < ticket) {
+			retireOldest(true);
+		}
+	}
+
+	void LveUploadQueue::waitIdle()
+	{
+		submit();
+		while (!batchesInFlight.empty()) {
+			retireOldest(true);
+		}
+	}
+
+} // namespace lve
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+
+namespace lve {
+
+	// Streams buffer uploads through a persistently mapped staging ring.
+	// Copies recorded between two submit() calls go out as one command buffer on the transfer queue,
+	// and fences report when they finished, so callers never stall the queue while loading.
+	class LveUploadQueue {
+
+	public:
+		using Ticket = uint64_t;
+
+		static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 32 * 1024 * 1024;
+
+		LveUploadQueue(LveDevice& device, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+		~LveUploadQueue();
+
+		LveUploadQueue(const LveUploadQueue&) = delete;
+		LveUploadQueue& operator=(const LveUploadQueue&) = delete;
+
+		// Copies data into the staging ring now and records the copy into dstBuffer for the next submit.
+		// Only blocks when the ring is full, waiting for the oldest batch in flight.
+		Ticket uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+		// Submits the copies recorded since the last call as one batch, without waiting for it
+		void submit();
+
+		bool isComplete(Ticket ticket);
+		void wait(Ticket ticket);
+		void waitIdle();
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			Ticket ticket = 0;
+			uint64_t ringEnd = 0;
+		};
+
+		VkDeviceSize allocateStaging(VkDeviceSize size);
+		void beginBatch();
+		void retireOldest(bool block);
+
+		LveDevice& lveDevice;
+		VkCommandPool commandPool;
+
+		std::unique_ptr<LveBuffer> stagingBuffer;
+		VkDeviceSize stagingSize;
+		// monotonic byte counters, the ring offset is counter % stagingSize
+		uint64_t ringHead = 0;
+		uint64_t ringTail = 0;
+
+		bool recording = false;
+		Batch currentBatch{};
+		std::deque<Batch> batchesInFlight;
+		std::vector<Batch> freeBatches;
+
+		Ticket nextTicket = 1;
+		Ticket completedTicket = 0;
+	};
+
+} // namespace lve
@@ -3,13 +3,22 @@
 
 // std
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 
-int main()
+int main(int argc, char** argv)
 {
-	lve::FirstApp app{};
+	// --deferred shades from a G-buffer instead of while drawing each object
+	lve::LveRenderPath renderPath = lve::LveRenderPath::Forward;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--deferred") == 0) {
+			renderPath = lve::LveRenderPath::Deferred;
+		}
+	}
+
+	lve::FirstApp app{ renderPath };
 
 	try {
 		app.run();
@@ -0,0 +1,107 @@
+#include "deferred_lighting_system.hpp"
+
+#include "lve_renderer.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+
+namespace lve {
+
+	DeferredLightingSystem::DeferredLightingSystem(
+		LveDevice& device,
+		VkRenderPass renderPass,
+		uint32_t subpass,
+		VkDescriptorSetLayout globalSetLayout,
+		VkDescriptorSetLayout gBufferSetLayout,
+		const LveLightingOptions& lighting)
+		: lveDevice{ device }
+	{
+		createPipelineLayout(globalSetLayout, gBufferSetLayout);
+		createPipeline(renderPass, subpass, lighting);
+	}
+
+	DeferredLightingSystem::~DeferredLightingSystem()
+	{
+		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+	}
+
+	void DeferredLightingSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout gBufferSetLayout)
+	{
+		std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{ globalSetLayout, gBufferSetLayout };
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create deferred lighting pipeline layout!");
+		}
+	}
+
+	void DeferredLightingSystem::createPipeline(VkRenderPass renderPass, uint32_t subpass, const LveLightingOptions& lighting)
+	{
+		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
+
+		PipelineConfigInfo pipelineConfig{};
+		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+
+		pipelineConfig.bindingDescriptions.clear();
+		pipelineConfig.attributeDescriptions.clear();
+
+		// depth is an input here, the triangle itself is neither tested nor culled
+		pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+
+		pipelineConfig.renderPass = renderPass;
+		pipelineConfig.subpass = subpass;
+		pipelineConfig.pipelineLayout = pipelineLayout;
+
+		for (uint32_t lightLoop = 0; lightLoop < LveLightingOptions::LIGHT_LOOP_VARIANT_COUNT; lightLoop++)
+		{
+			lighting.specialize(pipelineConfig, lightLoop);
+			lvePipelines[lightLoop] = std::make_unique<LvePipeline>(
+				lveDevice,
+				"shaders/deferred_lighting.vert.spv",
+				"shaders/deferred_lighting.frag.spv",
+				pipelineConfig,
+				true); // compiled in the background
+		}
+	}
+
+	void DeferredLightingSystem::render(FrameInfo& frameInfo)
+	{
+		assert(frameInfo.gBufferDescriptorSet != VK_NULL_HANDLE && "Deferred lighting needs the G-buffer descriptor set!");
+
+		LvePipeline& pipeline = *lvePipelines[LveLightingOptions::selectLightLoop(frameInfo)];
+		auto recordLighting = [&](VkCommandBuffer commandBuffer, uint32_t, uint32_t) {
+			pipeline.bind(commandBuffer);
+
+			std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.globalDescriptorSet, frameInfo.gBufferDescriptorSet };
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0,
+				static_cast<uint32_t>(descriptorSets.size()),
+				descriptorSets.data(),
+				0,
+				nullptr);
+
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		};
+
+		if (frameInfo.parallelRecorder != nullptr) {
+			frameInfo.parallelRecorder->recordSecondary(1, recordLighting);
+		}
+		else {
+			recordLighting(frameInfo.commandBuffer, 0, 1);
+		}
+	}
+
+} // namespace lve
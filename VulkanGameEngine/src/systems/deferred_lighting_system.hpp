@@ -0,0 +1,46 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_frame_info.hpp"
+#include "lve_light_clusters.hpp"
+
+// std
+#include <array>
+#include <memory>
+
+
+namespace lve {
+
+	// Lighting subpass of the deferred path: one fullscreen triangle reads albedo, normal and depth of its pixel from
+	// input attachments and applies the clustered point lights, so each pixel is lit once whatever was drawn on it.
+	class DeferredLightingSystem {
+
+	public:
+		DeferredLightingSystem(
+			LveDevice& device,
+			VkRenderPass renderPass,
+			uint32_t subpass,
+			VkDescriptorSetLayout globalSetLayout,
+			VkDescriptorSetLayout gBufferSetLayout,
+			const LveLightingOptions& lighting = LveLightingOptions{});
+		~DeferredLightingSystem();
+
+		DeferredLightingSystem(const DeferredLightingSystem&) = delete;
+		DeferredLightingSystem& operator=(const DeferredLightingSystem&) = delete;
+
+		// needs frameInfo.gBufferDescriptorSet
+		void render(FrameInfo& frameInfo);
+
+	private:
+		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout gBufferSetLayout);
+		void createPipeline(VkRenderPass renderPass, uint32_t subpass, const LveLightingOptions& lighting);
+
+		LveDevice& lveDevice;
+
+		// indexed by the light loop variant
+		std::array<std::unique_ptr<LvePipeline>, LveLightingOptions::LIGHT_LOOP_VARIANT_COUNT> lvePipelines;
+		VkPipelineLayout pipelineLayout;
+	};
+
+} // namespace lve
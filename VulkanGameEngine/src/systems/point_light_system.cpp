@@ -1,5 +1,9 @@
 #include "point_light_system.hpp"
 
+#include "lve_light_clusters.hpp"
+#include "lve_renderer.hpp"
+#include "lve_swap_chain.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -9,23 +13,26 @@
 // std
 #include <stdexcept>
 #include <array>
-#include <map>
+#include <vector>
 
 
 namespace lve {
 
-	struct PointLightPushConstants
+	static constexpr uint32_t INITIAL_INSTANCE_CAPACITY = 64;
+
+	// matches Instance in point_light.vert
+	struct PointLightInstance
 	{
-		glm::vec4 position{};
-		glm::vec4 color{};
-		float radius;
+		glm::vec4 position{}; // w is the billboard radius
+		glm::vec4 color{};    // w is intensity
 	};
 
-	PointLightSystem::PointLightSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+	PointLightSystem::PointLightSystem(LveDevice& device, VkRenderPass renderPass, uint32_t subpass, VkDescriptorSetLayout globalSetLayout)
 		: lveDevice{ device }
 	{
+		createInstanceBuffers();
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		createPipeline(renderPass, subpass);
 	}
 
 	PointLightSystem::~PointLightSystem()
@@ -33,27 +40,75 @@ namespace lve {
 		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
 	}
 
-	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void PointLightSystem::createInstanceBuffers()
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(PointLightPushConstants);
+		instanceSetLayout = LveDescriptorSetLayout::Builder(lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+
+		instancePool = LveDescriptorPool::Builder(lveDevice)
+			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		instanceBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		instanceDescriptorSets.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			reserveInstances(i, INITIAL_INSTANCE_CAPACITY);
+		}
+	}
+
+	void PointLightSystem::reserveInstances(int frameIndex, uint32_t instanceCount)
+	{
+		auto& buffer = instanceBuffers[frameIndex];
+		if (buffer != nullptr && buffer->getInstanceCount() >= instanceCount) {
+			return;
+		}
 
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+		uint32_t capacity = buffer != nullptr ? buffer->getInstanceCount() : INITIAL_INSTANCE_CAPACITY;
+		while (capacity < instanceCount) {
+			capacity *= 2;
+		}
+
+		// the frame that last used this buffer has finished, so it can be replaced
+		buffer = std::make_unique<LveBuffer>(
+			lveDevice,
+			sizeof(PointLightInstance),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		buffer->map();
+
+		VkDescriptorBufferInfo bufferInfo = buffer->descriptorInfo();
+		LveDescriptorWriter writer{ *instanceSetLayout, *instancePool };
+		writer.writeBuffer(0, &bufferInfo);
+		if (instanceDescriptorSets[frameIndex] == VK_NULL_HANDLE) {
+			writer.build(instanceDescriptorSets[frameIndex]);
+		}
+		else {
+			writer.overwrite(instanceDescriptorSets[frameIndex]);
+		}
+	}
+
+	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	{
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+			globalSetLayout,
+			instanceSetLayout->getDescriptorSetLayout() };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 		if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create pipeline layout!");
 		}
 	}
 
-	void PointLightSystem::createPipeline(VkRenderPass renderPass)
+	void PointLightSystem::createPipeline(VkRenderPass renderPass, uint32_t subpass)
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
 
@@ -64,16 +119,23 @@ namespace lve {
 		pipelineConfig.bindingDescriptions.clear();
 		pipelineConfig.attributeDescriptions.clear();
 
+		// depth is read only after the G-buffer subpass, the lights are still tested against it
+		if (subpass > 0) {
+			pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		}
+
 		pipelineConfig.renderPass = renderPass;
+		pipelineConfig.subpass = subpass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
 		lvePipeline = std::make_unique<LvePipeline>(
 			lveDevice,
 			"shaders/point_light.vert.spv",
 			"shaders/point_light.frag.spv",
-			pipelineConfig);
+			pipelineConfig,
+			true); // compiled in the background
 	};
 
-	void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo)
+	void PointLightSystem::update(FrameInfo& frameInfo)
 	{
 		auto rotateLight = glm::rotate(
 			glm::mat4(1.0f),
@@ -81,76 +143,87 @@ namespace lve {
 			{ 0.0f, -1.0f, 0.0f }
 		);
 
-		int lightIndex = 0;
-		for (auto& kv : frameInfo.gameObjects)
-		{
-			auto& obj = kv.second;
-			if (obj.pointLight == nullptr) continue;
-
-			assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified!");
-
-			// update light position
-			obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.0f));
+		frameInfo.entities.each<PointLightComponent, TransformComponent>(
+			[&](LveEntity, PointLightComponent&, TransformComponent& transform) {
+				// update light position
+				transform.translation = glm::vec3(rotateLight * glm::vec4(transform.translation, 1.0f));
+			});
+	}
 
-			// copy light to UBO
-			ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.0f);
-			ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			lightIndex += 1;
+	void PointLightSystem::addToClusters(FrameInfo& frameInfo)
+	{
+		if (frameInfo.lightClusters == nullptr) {
+			return;
 		}
-		ubo.numLights = lightIndex;
+
+		// copy light to the cluster pass
+		frameInfo.entities.each<PointLightComponent, TransformComponent>(
+			[&](LveEntity, PointLightComponent& pointLight, TransformComponent& transform) {
+				frameInfo.lightClusters->addLight(transform.translation, pointLight.color, pointLight.lightIntensity);
+			});
 	}
 
 	void PointLightSystem::render(FrameInfo& frameInfo)
 	{
-		// sort lights
-		std::map<float, LveGameObject::id_t> sorted;
-		for (auto& kv : frameInfo.gameObjects)
-		{
-			auto& obj = kv.second;
-			if (obj.pointLight == nullptr) continue;
-
-			// calculate distance
-			auto offset = frameInfo.camera.getPosition() - obj.transform.translation;
-			float disSquared = glm::dot(offset, offset);
-			sorted[disSquared] = obj.getId();
+		lightTransforms.clear();
+		lightComponents.clear();
+		sortKeys.clear();
+		sortOrder.clear();
+		glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+		frameInfo.entities.each<PointLightComponent, TransformComponent>(
+			[&](LveEntity, PointLightComponent& pointLight, TransformComponent& transform) {
+				// inverted so ascending keys go back to front, lights at the same distance are all kept
+				auto offset = cameraPosition - transform.translation;
+				sortKeys.push_back(~LveRadixSort::floatKey(glm::dot(offset, offset)));
+				sortOrder.push_back(static_cast<uint32_t>(lightTransforms.size()));
+				lightTransforms.push_back(&transform);
+				lightComponents.push_back(&pointLight);
+			});
+
+		uint32_t lightCount = static_cast<uint32_t>(lightTransforms.size());
+		if (lightCount == 0) {
+			return;
 		}
 
-		lvePipeline->bind(frameInfo.commandBuffer);
-
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0,
-			1,
-			&frameInfo.globalDescriptorSet,
-			0,
-			nullptr);
-
-		// iterate through sorted lights in reverse order
-		// for (auto& kv : frameInfo.gameObjects)
-		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+		radixSort.sort(sortKeys, sortOrder);
+
+		reserveInstances(frameInfo.frameIndex, lightCount);
+		LveBuffer& instanceBuffer = *instanceBuffers[frameInfo.frameIndex];
+		auto instances = static_cast<PointLightInstance*>(instanceBuffer.getMappedMemory());
+		for (uint32_t i = 0; i < lightCount; i++)
 		{
-			// use game obj id to find light object
-			// auto& obj = kv.second;
-			auto& obj = frameInfo.gameObjects.at(it->second);
-			// if (obj.pointLight == nullptr) continue;
-
-			PointLightPushConstants push{};
-			push.position = glm::vec4(obj.transform.translation, 1.0f);
-			push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			push.radius = obj.transform.scale.x;
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
+			const TransformComponent& transform = *lightTransforms[sortOrder[i]];
+			const PointLightComponent& pointLight = *lightComponents[sortOrder[i]];
+			instances[i].position = glm::vec4(transform.translation, transform.scale.x);
+			instances[i].color = glm::vec4(pointLight.color, pointLight.lightIntensity);
+		}
+		instanceBuffer.flush(lightCount * sizeof(PointLightInstance));
+
+		auto recordLights = [&](VkCommandBuffer commandBuffer, uint32_t, uint32_t) {
+			lvePipeline->bind(commandBuffer);
+
+			std::array<VkDescriptorSet, 2> descriptorSets{
+				frameInfo.globalDescriptorSet,
+				instanceDescriptorSets[frameInfo.frameIndex] };
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
 				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 				0,
-				sizeof(PointLightPushConstants),
-				&push
-			);
+				static_cast<uint32_t>(descriptorSets.size()),
+				descriptorSets.data(),
+				0,
+				nullptr);
 
-			vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+			// instances draw in order, which keeps the blending back to front
+			vkCmdDraw(commandBuffer, 6, lightCount, 0, 0);
+		};
+
+		if (frameInfo.parallelRecorder != nullptr) {
+			frameInfo.parallelRecorder->recordSecondary(1, recordLights);
+		}
+		else {
+			recordLights(frameInfo.commandBuffer, 0, 1);
 		}
 	}
 
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "lve_buffer.hpp"
 #include "lve_camera.hpp"
+#include "lve_descriptors.h"
 #include "lve_device.hpp"
 #include "lve_game_object.hpp"
 #include "lve_pipeline.hpp"
 #include "lve_frame_info.hpp"
+#include "lve_radix_sort.hpp"
 
 // std
 #include <memory>
@@ -16,23 +19,43 @@ namespace lve {
 	class PointLightSystem {
 
 	public:
-		PointLightSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		// subpass is the lighting subpass of the render pass, see LveSwapChain::getLightingSubpass
+		PointLightSystem(LveDevice& device, VkRenderPass renderPass, uint32_t subpass, VkDescriptorSetLayout globalSetLayout);
 		~PointLightSystem();
 
 		PointLightSystem(const PointLightSystem&) = delete;
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-		void update(FrameInfo& frameInfo, GlobalUbo& ubo);
+		// moves the lights by frameInfo.frameTime, a fixed simulation step
+		void update(FrameInfo& frameInfo);
+		// adds the lights where they are drawn this frame to frameInfo.lightClusters
+		void addToClusters(FrameInfo& frameInfo);
+		// all billboards in one instanced draw, sorted back to front for blending
 		void render(FrameInfo& frameInfo);
 
 	private:
+		void createInstanceBuffers();
+		void reserveInstances(int frameIndex, uint32_t instanceCount);
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(VkRenderPass renderPass, uint32_t subpass);
 
 		LveDevice& lveDevice;
 
 		std::unique_ptr<LvePipeline> lvePipeline;
 		VkPipelineLayout pipelineLayout;
+
+		// set 1, per frame in flight the billboards in draw order
+		std::unique_ptr<LveDescriptorSetLayout> instanceSetLayout;
+		std::unique_ptr<LveDescriptorPool> instancePool;
+		std::vector<VkDescriptorSet> instanceDescriptorSets;
+		std::vector<std::unique_ptr<LveBuffer>> instanceBuffers;
+
+		// the lights of the frame, in the order of their sort keys before sorting
+		std::vector<const TransformComponent*> lightTransforms;
+		std::vector<const PointLightComponent*> lightComponents;
+		std::vector<uint32_t> sortKeys;
+		std::vector<uint32_t> sortOrder;
+		LveRadixSort radixSort;
 	};
 
 } // namespace lve
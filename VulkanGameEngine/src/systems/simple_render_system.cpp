@@ -1,5 +1,9 @@
 #include "simple_render_system.hpp"
 
+#include "lve_renderer.hpp"
+#include "lve_swap_chain.hpp"
+#include "lve_thread_pool.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -7,22 +11,45 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
+#include <numeric>
 #include <stdexcept>
 #include <array>
+#include <tuple>
 
 
 namespace lve {
 
-	struct SimplePushConstantData {
-		glm::mat4 modelMatrix{ 1.0f };
-		glm::mat4 normalMatrix{ 1.0f };
-	};
+	static constexpr uint32_t INITIAL_INSTANCE_CAPACITY = 1024;
+	// below these counts the work stays on the calling thread
+	static constexpr uint32_t PARALLEL_MIN_OBJECTS = 1024;
+	static constexpr uint32_t PARALLEL_MIN_BATCHES = 64;
+
+	// what is bound between draws, sorting by it gives the fewest pipeline and geometry arena switches
+	static std::tuple<LveModel::VertexFormat, uint32_t, uint32_t> drawStateKey(const LveModel& model)
+	{
+		const LveGeometryAllocation& geometry = model.getGeometry();
+		return std::make_tuple(model.getVertexFormat(), geometry.vertexArena, geometry.indexArena);
+	}
 
-	SimpleRenderSystem::SimpleRenderSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+	static float maxAxisScale(const glm::mat4& modelMatrix)
+	{
+		return glm::max(
+			glm::length(glm::vec3{ modelMatrix[0] }),
+			glm::max(glm::length(glm::vec3{ modelMatrix[1] }), glm::length(glm::vec3{ modelMatrix[2] })));
+	}
+
+	SimpleRenderSystem::SimpleRenderSystem(
+		LveDevice& device,
+		VkRenderPass renderPass,
+		VkDescriptorSetLayout globalSetLayout,
+		LveRenderPath renderPath,
+		const LveLightingOptions& lighting)
 		: lveDevice{ device }
 	{
+		createInstanceBuffers();
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		createPipeline(renderPass, renderPath, lighting);
 	}
 
 	SimpleRenderSystem::~SimpleRenderSystem()
@@ -30,76 +57,567 @@ namespace lve {
 		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
 	}
 
-	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void SimpleRenderSystem::createInstanceBuffers()
+	{
+		instanceSetLayout = LveDescriptorSetLayout::Builder(lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+
+		instancePool = LveDescriptorPool::Builder(lveDevice)
+			.setMaxSets(2 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		instanceBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		instanceIndexBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		instanceDescriptorSets.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		gpuInstanceDescriptorSets.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		gpuInstanceSetGenerations.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		gpuCandidateCounts.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+		for (int i = 0; i < LveSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			reserveInstances(i, INITIAL_INSTANCE_CAPACITY);
+		}
+	}
+
+	void SimpleRenderSystem::reserveInstances(int frameIndex, uint32_t instanceCount)
+	{
+		auto& buffer = instanceBuffers[frameIndex];
+		auto& indexBuffer = instanceIndexBuffers[frameIndex];
+		if (buffer != nullptr && buffer->getInstanceCount() >= instanceCount) {
+			return;
+		}
+
+		uint32_t capacity = buffer != nullptr ? buffer->getInstanceCount() : INITIAL_INSTANCE_CAPACITY;
+		while (capacity < instanceCount) {
+			capacity *= 2;
+		}
+
+		// the frame that last used these buffers has finished, so they can be replaced
+		buffer = std::make_unique<LveBuffer>(
+			lveDevice,
+			sizeof(LveInstanceData),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		buffer->map();
+
+		indexBuffer = std::make_unique<LveBuffer>(
+			lveDevice,
+			sizeof(uint32_t),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		indexBuffer->map();
+
+		VkDescriptorBufferInfo bufferInfo = buffer->descriptorInfo();
+		VkDescriptorBufferInfo indexBufferInfo = indexBuffer->descriptorInfo();
+		LveDescriptorWriter writer{ *instanceSetLayout, *instancePool };
+		writer.writeBuffer(0, &bufferInfo);
+		writer.writeBuffer(1, &indexBufferInfo);
+		if (instanceDescriptorSets[frameIndex] == VK_NULL_HANDLE) {
+			writer.build(instanceDescriptorSets[frameIndex]);
+		}
+		else {
+			writer.overwrite(instanceDescriptorSets[frameIndex]);
+		}
+	}
+
+	void SimpleRenderSystem::writeGpuInstanceDescriptorSet(int frameIndex)
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
+		LveBuffer& buffer = gpuInstances->getBuffer();
+		LveBuffer& indexBuffer = gpuCuller->getInstanceIndexBuffer();
+		std::array<uint32_t, 2> generations{ gpuInstances->getGeneration(), gpuCuller->getInstanceIndexGeneration() };
+		if (gpuInstanceDescriptorSets[frameIndex] != VK_NULL_HANDLE && generations == gpuInstanceSetGenerations[frameIndex]) {
+			return;
+		}
+		gpuInstanceSetGenerations[frameIndex] = generations;
+
+		VkDescriptorBufferInfo bufferInfo = buffer.descriptorInfo();
+		VkDescriptorBufferInfo indexBufferInfo = indexBuffer.descriptorInfo();
+		LveDescriptorWriter writer{ *instanceSetLayout, *instancePool };
+		writer.writeBuffer(0, &bufferInfo);
+		writer.writeBuffer(1, &indexBufferInfo);
+		if (gpuInstanceDescriptorSets[frameIndex] == VK_NULL_HANDLE) {
+			writer.build(gpuInstanceDescriptorSets[frameIndex]);
+		}
+		else {
+			writer.overwrite(gpuInstanceDescriptorSets[frameIndex]);
+		}
+	}
 
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	{
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+			globalSetLayout,
+			instanceSetLayout->getDescriptorSetLayout() };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 		if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create pipeline layout!");
 		}
 	}
 
-	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass)
+	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass, LveRenderPath renderPath, const LveLightingOptions& lighting)
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout!");
 
-		PipelineConfigInfo pipelineConfig{};
-		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		lvePipeline = std::make_unique<LvePipeline>(
-			lveDevice,
-			"shaders/simple_shader.vert.spv",
-			"shaders/simple_shader.frag.spv",
-			pipelineConfig);
+		for (uint32_t i = 0; i < LveModel::VERTEX_FORMAT_COUNT; i++)
+		{
+			auto vertexFormat = static_cast<LveModel::VertexFormat>(i);
+
+			for (uint32_t lightLoop = 0; lightLoop < LveLightingOptions::LIGHT_LOOP_VARIANT_COUNT; lightLoop++)
+			{
+				PipelineConfigInfo pipelineConfig{};
+				LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+				pipelineConfig.bindingDescriptions = LveModel::getBindingDescriptions(vertexFormat);
+				pipelineConfig.attributeDescriptions = LveModel::getAttributeDescriptions(vertexFormat);
+				pipelineConfig.renderPass = renderPass;
+				pipelineConfig.pipelineLayout = pipelineLayout;
+
+				// the G-buffer subpass writes albedo and normal instead of a lit color, its light loop variants are
+				// the same config and share one pipeline
+				bool deferred = renderPath == LveRenderPath::Deferred;
+				if (deferred) {
+					pipelineConfig.colorAttachmentCount = 2;
+				}
+				else {
+					lighting.specialize(pipelineConfig, lightLoop);
+				}
+
+				lvePipelines[i][lightLoop] = std::make_unique<LvePipeline>(
+					lveDevice,
+					vertexFormat == LveModel::VertexFormat::Float
+						? "shaders/simple_shader.vert.spv"
+						: "shaders/simple_shader_packed.vert.spv",
+					deferred ? "shaders/gbuffer.frag.spv" : "shaders/simple_shader.frag.spv",
+					pipelineConfig,
+					true); // compiled in the background
+			}
+		}
 	};
 
-	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo)
+	void SimpleRenderSystem::gatherCandidates(FrameInfo& frameInfo)
+	{
+		candidateTransforms.clear();
+		candidateWorlds.clear();
+		candidateModels.clear();
+		LveComponentPool<WorldTransformComponent>& worlds = frameInfo.entities.pool<WorldTransformComponent>();
+		frameInfo.entities.each<ModelComponent, TransformComponent>(
+			[&](LveEntity entity, ModelComponent& model, TransformComponent& transform) {
+				if (model.model != nullptr && model.model->isReady())
+				{
+					candidateTransforms.push_back(&transform);
+					candidateWorlds.push_back(worlds.tryGet(entity.index));
+					candidateModels.push_back(&model);
+				}
+			});
+	}
+
+	const glm::mat4& SimpleRenderSystem::candidateMatrix(uint32_t i)
+	{
+		return candidateWorlds[i] != nullptr ? candidateWorlds[i]->matrix : candidateTransforms[i]->mat4();
+	}
+
+	const glm::mat3& SimpleRenderSystem::candidateNormalMatrix(uint32_t i)
+	{
+		return candidateWorlds[i] != nullptr ? candidateWorlds[i]->normalMatrix : candidateTransforms[i]->normalMatrix();
+	}
+
+	uint32_t SimpleRenderSystem::gatherChangedObjects(FrameInfo& frameInfo)
+	{
+		candidateTransforms.clear();
+		candidateWorlds.clear();
+		candidateModels.clear();
+		changedObjects.clear();
+
+		// a comparison per object, objects keep their index while the entities stay in the same order
+		LveComponentPool<WorldTransformComponent>& worlds = frameInfo.entities.pool<WorldTransformComponent>();
+		uint32_t objectCount = 0;
+		frameInfo.entities.each<ModelComponent, TransformComponent>(
+			[&](LveEntity entity, ModelComponent& model, TransformComponent& transform) {
+				if (model.model == nullptr || !model.model->isReady()) {
+					return;
+				}
+
+				const WorldTransformComponent* world = worlds.tryGet(entity.index);
+				GpuObject current{};
+				current.entity = entity;
+				current.model = model.model.get();
+				current.color = model.color;
+				current.world = world != nullptr;
+				current.revision = world != nullptr ? world->revision : transform.getRevision();
+
+				uint32_t index = objectCount++;
+				if (index == gpuObjects.size()) {
+					gpuObjects.emplace_back();
+				}
+				GpuObject& uploaded = gpuObjects[index];
+				if (uploaded.matches(current)) {
+					return;
+				}
+
+				if (uploaded.model == current.model) {
+					current.modelIndex = uploaded.modelIndex;
+				}
+				else
+				{
+					current.modelIndex = acquireGpuModel(current.model);
+					if (uploaded.model != nullptr) {
+						releaseGpuModel(uploaded.modelIndex);
+					}
+				}
+				uploaded = current;
+
+				changedObjects.push_back(index);
+				candidateTransforms.push_back(&transform);
+				candidateWorlds.push_back(world);
+				candidateModels.push_back(&model);
+			});
+
+		for (uint32_t i = objectCount; i < gpuObjects.size(); i++) {
+			releaseGpuModel(gpuObjects[i].modelIndex);
+		}
+		gpuObjects.resize(objectCount);
+		return objectCount;
+	}
+
+	uint32_t SimpleRenderSystem::acquireGpuModel(const LveModel* model)
+	{
+		auto [entry, inserted] = gpuModelIndices.try_emplace(model, 0);
+		if (inserted)
+		{
+			if (freeGpuModels.empty())
+			{
+				entry->second = static_cast<uint32_t>(gpuModels.size());
+				gpuModels.push_back({ model, 0 });
+			}
+			else
+			{
+				entry->second = freeGpuModels.back();
+				freeGpuModels.pop_back();
+				gpuModels[entry->second] = { model, 0 };
+			}
+		}
+		gpuModels[entry->second].objectCount++;
+		return entry->second;
+	}
+
+	void SimpleRenderSystem::releaseGpuModel(uint32_t modelIndex)
+	{
+		GpuModel& gpuModel = gpuModels[modelIndex];
+		if (--gpuModel.objectCount == 0)
+		{
+			// the model may be destroyed now, and another one created at its address
+			gpuModelIndices.erase(gpuModel.model);
+			gpuModel.model = nullptr;
+			freeGpuModels.push_back(modelIndex);
+		}
+	}
+
+	void SimpleRenderSystem::cullGameObjects(FrameInfo& frameInfo)
+	{
+		gpuCulledFrame = false;
+		if (frameInfo.depthPyramid == nullptr || !LveGpuCuller::isSupported(lveDevice)) {
+			return;
+		}
+		if (gpuCuller == nullptr)
+		{
+			gpuCuller = std::make_unique<LveGpuCuller>(lveDevice);
+			gpuInstances = std::make_unique<LvePersistentBuffer>(
+				lveDevice, sizeof(LveInstanceData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		}
+
+		uint32_t objectCount = gatherChangedObjects(frameInfo);
+		gpuCuller->begin(frameInfo.frameIndex, objectCount);
+		gpuInstances->begin(frameInfo.frameIndex, objectCount);
+		// the visible count just read back belongs to the candidates of that frame
+		visibleCount = gpuCuller->getVisibleCount();
+		culledCount = gpuCandidateCounts[frameInfo.frameIndex] - visibleCount;
+		gpuCandidateCounts[frameInfo.frameIndex] = objectCount;
+
+		// slots are laid out per model, every object of a model is a candidate for every level, the pass picks one
+		gpuModelOrder.clear();
+		for (uint32_t i = 0; i < gpuModels.size(); i++) {
+			if (gpuModels[i].objectCount > 0) {
+				gpuModelOrder.push_back(i);
+			}
+		}
+		std::sort(gpuModelOrder.begin(), gpuModelOrder.end(), [&](uint32_t a, uint32_t b) {
+			return drawStateKey(*gpuModels[a].model) < drawStateKey(*gpuModels[b].model);
+		});
+
+		// a group is drawn with one indirect call, so it can only span models with the same bindings
+		gpuGroupModels.clear();
+		for (uint32_t i : gpuModelOrder)
+		{
+			const LveModel& model = *gpuModels[i].model;
+			if (gpuGroupModels.empty() || drawStateKey(*gpuGroupModels.back()) != drawStateKey(model))
+			{
+				gpuCuller->addGroup();
+				gpuGroupModels.push_back(&model);
+			}
+			gpuCuller->addModel(i, model, gpuModels[i].objectCount);
+		}
+
+		uint32_t uploadCount = static_cast<uint32_t>(changedObjects.size());
+		if (uploadCount > 0)
+		{
+			auto instances = static_cast<LveInstanceData*>(gpuInstances->stage(changedObjects));
+			LveGpuCullObject* objects = gpuCuller->stageObjects(changedObjects);
+
+			// candidate i is object changedObjects[i]
+			LveThreadPool::shared().parallelFor(uploadCount, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++)
+				{
+					const LveModel& model = *candidateModels[i]->model;
+					const glm::vec3& color = candidateModels[i]->color;
+					glm::mat4 modelMatrix = candidateMatrix(i);
+					float scale = maxAxisScale(modelMatrix);
+
+					LveInstanceData& instance = instances[i];
+					instance.modelMatrix = modelMatrix * model.getPositionDecode();
+					instance.normalMatrix = candidateNormalMatrix(i);
+					instance.color = glm::vec4(color, color == glm::vec3{ 0.0f } ? 0.0f : 1.0f);
+
+					LveGpuCullObject& object = objects[i];
+					object.sphere = glm::vec4(
+						glm::vec3{ modelMatrix * glm::vec4{ model.getBoundingCenter(), 1.0f } },
+						model.getBoundingRadius() * scale);
+					object.model = gpuObjects[changedObjects[i]].modelIndex;
+					object.scale = scale;
+				}
+			}, PARALLEL_MIN_OBJECTS);
+		}
+
+		gpuInstances->record(frameInfo.commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		gpuCuller->record(frameInfo.commandBuffer, frameInfo.camera, *frameInfo.depthPyramid, lodErrorThreshold);
+		if (objectCount == 0) {
+			// nothing was recorded, the regular path draws the empty frame
+			return;
+		}
+		writeGpuInstanceDescriptorSet(frameInfo.frameIndex);
+		gpuCulledFrame = true;
+	}
+
+	void SimpleRenderSystem::drawGpuCulled(FrameInfo& frameInfo)
 	{
-		lvePipeline->bind(frameInfo.commandBuffer);
+		// the matrices were all evaluated by cullGameObjects
+		transformRebuildCount = TransformComponent::takeRebuildCount();
 
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0,
-			1,
-			&frameInfo.globalDescriptorSet,
-			0,
-			nullptr);
+		VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, gpuInstanceDescriptorSets[frameInfo.frameIndex] };
+		uint32_t lightLoop = LveLightingOptions::selectLightLoop(frameInfo);
+
+		auto recordGroups = [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0,
+				2,
+				descriptorSets,
+				0,
+				nullptr);
+
+			LvePipeline* boundPipeline = nullptr;
+			for (uint32_t group = begin; group < end; group++)
+			{
+				const LveModel& model = *gpuGroupModels[group];
+
+				LvePipeline* pipeline = lvePipelines[static_cast<uint32_t>(model.getVertexFormat())][lightLoop].get();
+				if (pipeline != boundPipeline)
+				{
+					pipeline->bind(commandBuffer);
+					boundPipeline = pipeline;
+				}
+
+				// groups differ in at least one of these, so they are bound for each
+				const LveGeometryAllocation& geometry = model.getGeometry();
+				lveDevice.geometry().bindVertexArena(commandBuffer, geometry.vertexArena);
+				lveDevice.geometry().bindIndexArena(commandBuffer, geometry.indexArena);
+
+				gpuCuller->drawGroup(commandBuffer, group);
+			}
+		};
+
+		uint32_t groupCount = gpuCuller->getGroupCount();
+		if (frameInfo.parallelRecorder != nullptr) {
+			frameInfo.parallelRecorder->recordSecondary(groupCount, recordGroups, PARALLEL_MIN_BATCHES);
+		}
+		else {
+			recordGroups(frameInfo.commandBuffer, 0, groupCount);
+		}
+		drawCount = gpuCuller->getSlotCount();
+	}
 
-		for (auto& kv : frameInfo.gameObjects)
+	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo)
+	{
+		if (gpuCulledFrame)
 		{
-			auto& obj = kv.second;
+			gpuCulledFrame = false;
+			drawGpuCulled(frameInfo);
+			return;
+		}
+
+		gatherCandidates(frameInfo);
+
+		uint32_t candidateCount = static_cast<uint32_t>(candidateTransforms.size());
+		culler.setFrustum(frameInfo.camera.getProjection(), frameInfo.camera.getView());
+		culler.resize(candidateCount);
+		candidateMatrices.resize(candidateCount);
+
+		// model matrices are kept for the visible objects' instances
+		LveThreadPool::shared().parallelFor(candidateCount, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const LveModel& model = *candidateModels[i]->model;
+				const glm::mat4& modelMatrix = candidateMatrices[i] = candidateMatrix(i);
+
+				float scale = maxAxisScale(modelMatrix);
+				culler.setSphere(
+					i,
+					glm::vec3{ modelMatrix * glm::vec4{ model.getBoundingCenter(), 1.0f } },
+					model.getBoundingRadius() * scale);
+			}
+		}, PARALLEL_MIN_OBJECTS);
+
+		transformRebuildCount = TransformComponent::takeRebuildCount();
+
+		const std::vector<uint32_t>& visible = culler.cull();
+		visibleCount = culler.getVisibleCount();
+		culledCount = culler.getCulledCount();
+
+		drawCount = 0;
+		if (visible.empty()) {
+			return;
+		}
+
+		uint32_t objectCount = static_cast<uint32_t>(visible.size());
+		reserveInstances(frameInfo.frameIndex, objectCount);
+		LveBuffer& instanceBuffer = *instanceBuffers[frameInfo.frameIndex];
+		LveBuffer& instanceIndexBuffer = *instanceIndexBuffers[frameInfo.frameIndex];
+		auto instances = static_cast<LveInstanceData*>(instanceBuffer.getMappedMemory());
+		visibleModels.resize(objectCount);
+		objectLods.resize(objectCount);
+
+		// level of detail is independent per object, instance i belongs to visibleModels[i]
+		LveThreadPool::shared().parallelFor(objectCount, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++)
+			{
+				LveModel& model = *candidateModels[visible[i]]->model;
+				const glm::vec3& color = candidateModels[visible[i]]->color;
+				const glm::mat4& modelMatrix = candidateMatrices[visible[i]];
+				visibleModels[i] = &model;
+
+				uint32_t lod = 0;
+				if (model.getLodCount() > 1) {
+					lod = model.selectLod(maxLodError(frameInfo.camera, modelMatrix, model));
+				}
+				objectLods[i] = lod;
+
+				LveInstanceData& instance = instances[i];
+				instance.modelMatrix = modelMatrix * model.getPositionDecode();
+				instance.normalMatrix = candidateNormalMatrix(visible[i]);
+				// objects without a color keep their vertex colors
+				instance.color = glm::vec4(color, color == glm::vec3{ 0.0f } ? 0.0f : 1.0f);
+			}
+		}, PARALLEL_MIN_OBJECTS);
 
-			if (obj.model == nullptr) continue;
+		batcher.clear();
+		for (uint32_t i = 0; i < objectCount; i++) {
+			batcher.add(visibleModels[i], objectLods[i]);
+		}
+
+		std::vector<LveDrawBatch>& batches = batcher.build(static_cast<uint32_t*>(instanceIndexBuffer.getMappedMemory()));
+		instanceBuffer.flush(objectCount * sizeof(LveInstanceData));
+		instanceIndexBuffer.flush(objectCount * sizeof(uint32_t));
+
+		std::sort(batches.begin(), batches.end(), [](const LveDrawBatch& a, const LveDrawBatch& b) {
+			return drawStateKey(*a.model) < drawStateKey(*b.model);
+		});
 
-			SimplePushConstantData push{};
-			push.modelMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
+		VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, instanceDescriptorSets[frameInfo.frameIndex] };
+		uint32_t lightLoop = LveLightingOptions::selectLightLoop(frameInfo);
 
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
+		auto recordBatches = [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+			// all pipelines share the layout, so the descriptor sets stay bound across switches
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
 				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 				0,
-				sizeof(SimplePushConstantData),
-				&push);
+				2,
+				descriptorSets,
+				0,
+				nullptr);
+
+			LvePipeline* boundPipeline = nullptr;
+			// models are sub-ranges of the shared geometry arenas, which usually stay bound for the whole frame
+			uint32_t boundVertexArena = LveGeometryBuffer::NO_ARENA;
+			uint32_t boundIndexArena = LveGeometryBuffer::NO_ARENA;
+
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const LveDrawBatch& batch = batches[i];
+
+				LvePipeline* pipeline = lvePipelines[static_cast<uint32_t>(batch.model->getVertexFormat())][lightLoop].get();
+				if (pipeline != boundPipeline)
+				{
+					pipeline->bind(commandBuffer);
+					boundPipeline = pipeline;
+				}
+
+				const LveGeometryAllocation& geometry = batch.model->getGeometry();
+				if (geometry.vertexArena != boundVertexArena)
+				{
+					lveDevice.geometry().bindVertexArena(commandBuffer, geometry.vertexArena);
+					boundVertexArena = geometry.vertexArena;
+				}
+				if (geometry.hasIndices() && geometry.indexArena != boundIndexArena)
+				{
+					lveDevice.geometry().bindIndexArena(commandBuffer, geometry.indexArena);
+					boundIndexArena = geometry.indexArena;
+				}
+
+				batch.model->draw(commandBuffer, batch.lod, batch.instanceCount, batch.firstInstance);
+			}
+		};
 
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
+		if (frameInfo.parallelRecorder != nullptr) {
+			frameInfo.parallelRecorder->recordSecondary(static_cast<uint32_t>(batches.size()), recordBatches, PARALLEL_MIN_BATCHES);
 		}
+		else {
+			recordBatches(frameInfo.commandBuffer, 0, static_cast<uint32_t>(batches.size()));
+		}
+		drawCount = static_cast<uint32_t>(batches.size());
+	}
+
+	float SimpleRenderSystem::maxLodError(const LveCamera& camera, const glm::mat4& modelMatrix, const LveModel& model) const
+	{
+		float scale = maxAxisScale(modelMatrix);
+		glm::vec3 center{ modelMatrix * glm::vec4{ model.getBoundingCenter(), 1.0f } };
+		float radius = model.getBoundingRadius() * scale;
+
+		// the screen height spans 2 units in clip space
+		const glm::mat4& projection = camera.getProjection();
+		float screenPerWorld = glm::abs(projection[1][1]) * 0.5f;
+		if (projection[2][3] != 0.0f)
+		{
+			// perspective, measured at the closest point of the bounding sphere
+			float distance = glm::length(center - camera.getPosition()) - radius;
+			if (distance <= 0.0f) {
+				return 0.0f;
+			}
+			screenPerWorld /= distance;
+		}
+
+		return lodErrorThreshold / (screenPerWorld * scale);
 	}
 
 } // namespace lve
@@ -1,13 +1,23 @@
 #pragma once
 
+#include "lve_buffer.hpp"
 #include "lve_camera.hpp"
+#include "lve_descriptors.h"
 #include "lve_device.hpp"
+#include "lve_frustum_culler.hpp"
 #include "lve_game_object.hpp"
+#include "lve_gpu_culler.hpp"
+#include "lve_instance_batcher.hpp"
+#include "lve_light_clusters.hpp"
+#include "lve_persistent_buffer.hpp"
 #include "lve_pipeline.hpp"
 #include "lve_frame_info.hpp"
+#include "lve_swap_chain.hpp"
 
 // std
+#include <array>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 
@@ -16,22 +26,136 @@ namespace lve {
 	class SimpleRenderSystem {
 
 	public:
-		SimpleRenderSystem(LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		// on the deferred path objects are drawn into the G-buffer, subpass 0, and lit later, so lighting is unused
+		SimpleRenderSystem(
+			LveDevice& device,
+			VkRenderPass renderPass,
+			VkDescriptorSetLayout globalSetLayout,
+			LveRenderPath renderPath = LveRenderPath::Forward,
+			const LveLightingOptions& lighting = LveLightingOptions{});
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+		// culls the objects and builds their draws on the GPU, against the frustum and the depth of the previous frame.
+		// Records compute work so call it before the render pass, renderGameObjects then draws the result. Does
+		// nothing without frameInfo.depthPyramid or when the device lacks drawIndirectFirstInstance.
+		// The objects stay on the GPU, only those whose transform, model or color changed are uploaded again.
+		void cullGameObjects(FrameInfo& frameInfo);
+
+		// objects outside the camera frustum are skipped, the rest sharing a model and level of detail are drawn
+		// as one instanced draw. The per frame instance buffer is rewritten so call this once per frame.
+		// Instances are computed on the shared thread pool, and the draws are recorded into secondary
+		// command buffers when frameInfo.parallelRecorder is set.
 		void renderGameObjects(FrameInfo& frameInfo);
 
+		// with GPU culling the indirect draw slots, some of which may draw nothing
+		uint32_t getDrawCount() const { return drawCount; }
+		// objects with a model in the last frame that were drawn and culled, a few frames late with GPU culling
+		uint32_t getVisibleCount() const { return visibleCount; }
+		uint32_t getCulledCount() const { return culledCount; }
+		// transform matrices rebuilt in the last frame, objects that did not move reuse theirs
+		uint32_t getTransformRebuildCount() const { return transformRebuildCount; }
+
+		// largest LOD error allowed on screen, as a fraction of the screen height
+		float lodErrorThreshold = 0.001f;
+
 	private:
+		// model space error of obj that projects to lodErrorThreshold of the screen height
+		float maxLodError(const LveCamera& camera, const glm::mat4& modelMatrix, const LveModel& model) const;
+
+		void gatherCandidates(FrameInfo& frameInfo);
+		// lists the objects that differ from what the GPU holds at their index as candidates, returns the object count
+		uint32_t gatherChangedObjects(FrameInfo& frameInfo);
+		uint32_t acquireGpuModel(const LveModel* model);
+		void releaseGpuModel(uint32_t modelIndex);
+		// world matrices of candidate i, thread safe for different candidates
+		const glm::mat4& candidateMatrix(uint32_t i);
+		const glm::mat3& candidateNormalMatrix(uint32_t i);
+		void drawGpuCulled(FrameInfo& frameInfo);
+
+		void createInstanceBuffers();
+		void reserveInstances(int frameIndex, uint32_t instanceCount);
+		void writeGpuInstanceDescriptorSet(int frameIndex);
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(VkRenderPass renderPass, LveRenderPath renderPath, const LveLightingOptions& lighting);
 
 		LveDevice& lveDevice;
 
-		std::unique_ptr<LvePipeline> lvePipeline;
+		// one pipeline per vertex format and light loop, indexed by LveModel::VertexFormat then the light loop variant
+		std::array<
+			std::array<std::unique_ptr<LvePipeline>, LveLightingOptions::LIGHT_LOOP_VARIANT_COUNT>,
+			LveModel::VERTEX_FORMAT_COUNT> lvePipelines;
 		VkPipelineLayout pipelineLayout;
+
+		// set 1, per frame in flight the instances in object order and their indices grouped by batch
+		std::unique_ptr<LveDescriptorSetLayout> instanceSetLayout;
+		std::unique_ptr<LveDescriptorPool> instancePool;
+		std::vector<VkDescriptorSet> instanceDescriptorSets;
+		std::vector<std::unique_ptr<LveBuffer>> instanceBuffers;
+		std::vector<std::unique_ptr<LveBuffer>> instanceIndexBuffers;
+
+		LveFrustumCuller culler;
+		// entities with a model ready to draw, the world transform is null outside of a scene graph
+		std::vector<TransformComponent*> candidateTransforms;
+		std::vector<const WorldTransformComponent*> candidateWorlds;
+		std::vector<const ModelComponent*> candidateModels;
+		std::vector<glm::mat4> candidateMatrices;
+
+		LveInstanceBatcher batcher;
+		std::vector<LveModel*> visibleModels;
+		std::vector<uint32_t> objectLods;
+		uint32_t drawCount = 0;
+		uint32_t visibleCount = 0;
+		uint32_t culledCount = 0;
+		uint32_t transformRebuildCount = 0;
+
+		// what the GPU holds for an object, by object index
+		struct GpuObject
+		{
+			LveEntity entity{};
+			const LveModel* model = nullptr;
+			glm::vec3 color{};
+			// of the WorldTransformComponent in a scene graph, of the TransformComponent otherwise
+			bool world = false;
+			uint32_t revision = 0;
+			// into gpuModels
+			uint32_t modelIndex = 0;
+
+			bool matches(const GpuObject& other) const
+			{
+				return entity == other.entity && model == other.model && color == other.color
+					&& world == other.world && revision == other.revision;
+			}
+		};
+
+		struct GpuModel
+		{
+			const LveModel* model;
+			uint32_t objectCount;
+		};
+
+		// created on the first cullGameObjects, set 1 then reads the culler's instance indices instead
+		std::unique_ptr<LveGpuCuller> gpuCuller;
+		std::unique_ptr<LvePersistentBuffer> gpuInstances;
+		bool gpuCulledFrame = false;
+		std::vector<VkDescriptorSet> gpuInstanceDescriptorSets;
+		// generations of the instance and instance index buffers each set was written with, a reallocated buffer
+		// can come back with the handle of the one it replaced
+		std::vector<std::array<uint32_t, 2>> gpuInstanceSetGenerations;
+		// candidates of each frame in flight, the culler's visible count is from the same frame index
+		std::vector<uint32_t> gpuCandidateCounts;
+		std::vector<GpuObject> gpuObjects;
+		// indices of the objects listed in the candidate arrays
+		std::vector<uint32_t> changedObjects;
+		// models drawn with GPU culling, an index is reused once no object uses its model
+		std::vector<GpuModel> gpuModels;
+		std::unordered_map<const LveModel*, uint32_t> gpuModelIndices;
+		std::vector<uint32_t> freeGpuModels;
+		std::vector<uint32_t> gpuModelOrder;
+		// the model whose pipeline and arenas are bound for each culler group
+		std::vector<const LveModel*> gpuGroupModels;
 	};
 
 } // namespace lve
@@ -0,0 +1,885 @@
+#include "lve_bvh.hpp"
+#include "lve_descriptors.h"
+#include "lve_device.hpp"
+#include "lve_entity_registry.hpp"
+#include "lve_game_object.hpp"
+#include "lve_instance_batcher.hpp"
+#include "lve_model.hpp"
+#include "lve_pipeline_cache.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_radix_sort.hpp"
+#include "lve_range_allocator.hpp"
+#include "lve_renderer.hpp"
+#include "lve_scene_graph.hpp"
+#include "lve_task_graph.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_transform_batch.hpp"
+#include "lve_window.hpp"
+#include "systems/point_light_system.hpp"
+#include "systems/simple_render_system.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+
+// CPU microbenchmarks for engine subsystems, run from the build directory like the app. pipeline_cache opens a
+// window and creates a Vulkan device.
+//
+// usage: lve_bench [benchmark name...]
+namespace {
+
+	// best of several runs, in milliseconds
+	float timeBest(int runs, const std::function<void()>& fn)
+	{
+		float best = 1e30f;
+		for (int i = 0; i < runs; i++)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			fn();
+			best = std::min(best, std::chrono::duration<float, std::chrono::milliseconds::period>(
+				std::chrono::high_resolution_clock::now() - startTime).count());
+		}
+		return best;
+	}
+
+	void benchObjLoad()
+	{
+		std::vector<uint32_t> threadCounts{ 1, 2, 4, 8 };
+		uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		if (std::find(threadCounts.begin(), threadCounts.end(), hardwareThreads) == threadCounts.end()) {
+			threadCounts.push_back(hardwareThreads);
+		}
+
+		for (const char* model : { "models/flat_vase.obj", "models/smooth_vase.obj" })
+		{
+			std::string path = std::string{ ENGINE_DIR } + model;
+			std::cout << path << std::endl;
+
+			lve::LveModel::Builder reference{};
+			float serialTime = timeBest(5, [&] { reference.loadObjFile(path, 1); });
+			std::cout << "  serial unordered_map: " << std::setw(8) << serialTime << " ms" << std::endl;
+
+			for (uint32_t threads : threadCounts)
+			{
+				if (threads == 1) continue;
+
+				lve::LveModel::Builder builder{};
+				float time = timeBest(5, [&] { builder.loadObjFile(path, threads); });
+
+				bool identical = builder.vertices == reference.vertices && builder.indices == reference.indices;
+				std::cout << "  sharded, " << std::setw(2) << threads << " threads: " << std::setw(8) << time
+					<< " ms (x" << serialTime / time << ")" << (identical ? "" : " OUTPUT MISMATCH") << std::endl;
+			}
+		}
+	}
+
+	// random buffer sized allocations and frees against one 256 MB block
+	void benchRangeAllocator()
+	{
+		constexpr uint64_t BLOCK_SIZE = 256ull * 1024 * 1024;
+		constexpr int OPERATIONS = 1000000;
+
+		struct Live { uint64_t size; lve::LveRangeAllocator::Handle handle; };
+		lve::LveRangeAllocator allocator{ BLOCK_SIZE };
+		std::vector<Live> live{};
+		std::mt19937 rng{ 42 };
+		int failed = 0;
+
+		float time = timeBest(1, [&] {
+			for (int i = 0; i < OPERATIONS; i++)
+			{
+				// keep about half the block in use so frees and allocations interleave
+				bool allocate = live.empty() || (allocator.getUsedSize() < BLOCK_SIZE / 2 && rng() % 4 != 0);
+				if (allocate)
+				{
+					uint64_t size = 256 + rng() % (rng() % 16 == 0 ? 4 * 1024 * 1024 : 64 * 1024);
+					uint64_t alignment = uint64_t{ 16 } << (rng() % 9);
+					uint64_t offset;
+					lve::LveRangeAllocator::Handle handle;
+					if (allocator.allocate(size, alignment, offset, handle)) {
+						live.push_back({ size, handle });
+					}
+					else {
+						failed++;
+					}
+				}
+				else
+				{
+					size_t index = rng() % live.size();
+					allocator.free(live[index].handle);
+					live[index] = live.back();
+					live.pop_back();
+				}
+			}
+		});
+
+		uint64_t freeBytes = allocator.getSize() - allocator.getUsedSize();
+		uint64_t requestedBytes = 0;
+		for (const auto& allocation : live) {
+			requestedBytes += allocation.size;
+		}
+
+		std::cout << "  " << OPERATIONS << " operations: " << time << " ms ("
+			<< time * 1e6f / OPERATIONS << " ns per operation), " << failed << " failed" << std::endl;
+		std::cout << "  " << allocator.getAllocationCount() << " live allocations, "
+			<< 100.0 * requestedBytes / allocator.getUsedSize() << "% of the used bytes requested, "
+			<< allocator.getFreeRangeCount() << " free ranges, fragmentation "
+			<< 100.0 * (1.0 - double(allocator.getLargestFreeRange()) / freeBytes) << "%" << std::endl;
+	}
+
+	// CPU side of recording a frame: one push constant + draw per object against one instanced draw per model,
+	// with a 40x40 grid of a single model (the gravity vector field) plus a crowd of a few LOD'd models
+	void benchInstancing()
+	{
+		constexpr int FRAMES = 20;
+		constexpr uint32_t MODEL_COUNT = 8;
+		constexpr uint32_t LOD_COUNT = 3;
+
+		// the batcher only uses models as keys
+		int modelKeys[MODEL_COUNT + 1]{};
+		auto modelKey = [&](uint32_t i) { return reinterpret_cast<lve::LveModel*>(&modelKeys[i]); };
+
+		for (int crowdSize : { 0, 10000, 100000 })
+		{
+			std::vector<lve::TransformComponent> transforms{};
+			std::vector<std::pair<lve::LveModel*, uint32_t>> draws{};
+			std::mt19937 rng{ 7 };
+
+			for (int i = 0; i < 40 * 40; i++)
+			{
+				lve::TransformComponent transform{};
+				transform.translation = { -1.0f + (i % 40 + 0.5f) / 20.0f, -1.0f + (i / 40 + 0.5f) / 20.0f, 0.0f };
+				transform.scale = glm::vec3{ 0.005f };
+				transforms.push_back(transform);
+				draws.push_back({ modelKey(MODEL_COUNT), 0 });
+			}
+			for (int i = 0; i < crowdSize; i++)
+			{
+				lve::TransformComponent transform{};
+				transform.translation = { rng() % 1000 * 0.1f, 0.0f, rng() % 1000 * 0.1f };
+				transform.rotation.y = rng() % 628 * 0.01f;
+				transforms.push_back(transform);
+				draws.push_back({ modelKey(rng() % MODEL_COUNT), static_cast<uint32_t>(rng() % LOD_COUNT) });
+			}
+
+			// stands in for vkCmdPushConstants copying the constants into the command buffer
+			struct PushConstants { glm::mat4 modelMatrix; glm::mat4 normalMatrix; };
+			std::vector<PushConstants> commandStream(transforms.size());
+
+			float perObjectTime = timeBest(FRAMES, [&] {
+				for (size_t i = 0; i < transforms.size(); i++)
+				{
+					PushConstants push{ transforms[i].mat4(), glm::mat4{ transforms[i].normalMatrix() } };
+					std::memcpy(&commandStream[i], &push, sizeof(push));
+				}
+			});
+
+			// stand in for the mapped instance and instance index buffers
+			lve::LveInstanceBatcher batcher{};
+			std::vector<lve::LveInstanceData> instanceBuffer(transforms.size());
+			std::vector<uint32_t> instanceIndexBuffer(transforms.size());
+
+			float batchedTime = timeBest(FRAMES, [&] {
+				batcher.clear();
+				for (size_t i = 0; i < transforms.size(); i++)
+				{
+					lve::LveInstanceData& instance = instanceBuffer[batcher.add(draws[i].first, draws[i].second)];
+					instance.modelMatrix = transforms[i].mat4();
+					instance.normalMatrix = transforms[i].normalMatrix();
+				}
+				batcher.build(instanceIndexBuffer.data());
+			});
+
+			std::cout << "  " << std::setw(6) << transforms.size() << " objects: per object " << std::setw(6)
+				<< transforms.size() << " draws " << std::setw(8) << perObjectTime << " ms, instanced " << std::setw(3)
+				<< batcher.getBatchCount() << " draws " << std::setw(8) << batchedTime << " ms" << std::endl;
+		}
+		std::cout << "  (driver cost per vkCmdDrawIndexed and vkCmdPushConstants is not included)" << std::endl;
+	}
+
+	// model and normal matrices of 100000 transforms per frame, with a share of them moving every frame
+	void benchTransforms()
+	{
+		constexpr int FRAMES = 20;
+		constexpr int OBJECT_COUNT = 100000;
+
+		for (int movingPercent : { 0, 10, 100 })
+		{
+			std::vector<lve::TransformComponent> transforms(OBJECT_COUNT);
+			std::mt19937 rng{ 3 };
+			for (auto& transform : transforms)
+			{
+				transform.translation = { rng() % 1000 * 0.1f, 0.0f, rng() % 1000 * 0.1f };
+				transform.rotation.y = rng() % 628 * 0.01f;
+			}
+
+			int movingCount = OBJECT_COUNT * movingPercent / 100;
+			std::vector<glm::mat4> modelMatrices(transforms.size());
+			std::vector<glm::mat3> normalMatrices(transforms.size());
+			auto frame = [&] {
+				for (int i = 0; i < movingCount; i++) {
+					transforms[i].rotation.y += 0.01f;
+				}
+				for (size_t i = 0; i < transforms.size(); i++)
+				{
+					modelMatrices[i] = transforms[i].mat4();
+					normalMatrices[i] = transforms[i].normalMatrix();
+				}
+			};
+
+			// the first evaluation builds every matrix
+			frame();
+			lve::TransformComponent::takeRebuildCount();
+
+			float time = timeBest(FRAMES, frame);
+			uint32_t rebuilds = lve::TransformComponent::takeRebuildCount() / FRAMES;
+			std::cout << "  " << std::setw(3) << movingPercent << "% moving: " << std::setw(8) << time << " ms, "
+				<< std::setw(6) << rebuilds << " rebuilds per frame" << std::endl;
+		}
+	}
+
+	// every transform of an animated scene changing each frame: TransformComponent one at a time against the SIMD
+	// batch kernel over the same values
+	void benchTransformBatch()
+	{
+		constexpr int FRAMES = 20;
+
+		for (int objectCount : { 1000, 100000 })
+		{
+			std::vector<lve::TransformComponent> transforms(objectCount);
+			lve::LveTransformBatch batch{};
+			batch.resize(objectCount);
+			std::mt19937 rng{ 5 };
+			std::uniform_real_distribution<float> angle{ -glm::pi<float>(), glm::pi<float>() };
+			for (int i = 0; i < objectCount; i++)
+			{
+				auto& transform = transforms[i];
+				transform.translation = { rng() % 1000 * 0.1f, 0.0f, rng() % 1000 * 0.1f };
+				transform.rotation = { angle(rng), angle(rng), angle(rng) };
+				transform.scale = glm::vec3{ 0.5f + rng() % 100 * 0.01f };
+				batch.set(i, transform.translation, transform.rotation, transform.scale);
+			}
+
+			std::vector<glm::mat4> modelMatrices(objectCount);
+			std::vector<glm::mat3> normalMatrices(objectCount);
+			float componentTime = timeBest(FRAMES, [&] {
+				for (int i = 0; i < objectCount; i++)
+				{
+					// keeps the cache from hiding the rebuild
+					transforms[i].rotation.y = -transforms[i].rotation.y;
+					modelMatrices[i] = transforms[i].mat4();
+					normalMatrices[i] = transforms[i].normalMatrix();
+				}
+			});
+
+			std::vector<glm::mat4> batchModelMatrices(objectCount);
+			std::vector<glm::mat3> batchNormalMatrices(objectCount);
+			float batchTime = timeBest(FRAMES, [&] {
+				for (int i = 0; i < objectCount; i++) {
+					batch.rotationY[i] = -batch.rotationY[i];
+				}
+				batch.build(0, objectCount, batchModelMatrices.data(), batchNormalMatrices.data());
+			});
+
+			// both ran an even number of frames, so they end on the same rotations
+			float maxError = 0.0f;
+			for (int i = 0; i < objectCount; i++)
+			{
+				for (int column = 0; column < 3; column++) {
+					maxError = std::max(maxError, glm::length(batchModelMatrices[i][column] - modelMatrices[i][column]));
+					maxError = std::max(maxError, glm::length(batchNormalMatrices[i][column] - normalMatrices[i][column]));
+				}
+			}
+
+			std::cout << "  " << std::setw(6) << objectCount << " objects: TransformComponent " << std::setw(8)
+				<< componentTime << " ms, batch " << std::setw(8) << batchTime << " ms (x" << componentTime / batchTime
+				<< "), max difference " << maxError << std::endl;
+		}
+	}
+
+	// back to front order of point light billboards: the map keyed by distance the lights were sorted with before,
+	// which also drops lights at equal distances, against the radix sort
+	void benchLightSort()
+	{
+		constexpr int FRAMES = 20;
+
+		for (int lightCount : { 1000, 100000 })
+		{
+			std::mt19937 rng{ 9 };
+			std::uniform_real_distribution<float> coordinate{ -50.0f, 50.0f };
+			std::vector<float> distances(lightCount);
+			for (float& distance : distances)
+			{
+				glm::vec3 offset{ coordinate(rng), coordinate(rng), coordinate(rng) };
+				distance = glm::dot(offset, offset);
+			}
+
+			size_t mapSize = 0;
+			float mapTime = timeBest(FRAMES, [&] {
+				std::map<float, uint32_t> sorted;
+				for (int i = 0; i < lightCount; i++) {
+					sorted[distances[i]] = i;
+				}
+				mapSize = sorted.size();
+			});
+
+			lve::LveRadixSort radixSort{};
+			std::vector<uint32_t> keys;
+			std::vector<uint32_t> order;
+			float radixTime = timeBest(FRAMES, [&] {
+				keys.clear();
+				order.clear();
+				for (int i = 0; i < lightCount; i++)
+				{
+					keys.push_back(~lve::LveRadixSort::floatKey(distances[i]));
+					order.push_back(i);
+				}
+				radixSort.sort(keys, order);
+			});
+
+			bool backToFront = true;
+			for (size_t i = 1; i < order.size(); i++) {
+				backToFront = backToFront && distances[order[i - 1]] >= distances[order[i]];
+			}
+
+			std::cout << "  " << std::setw(6) << lightCount << " lights: map " << std::setw(8) << mapTime << " ms ("
+				<< lightCount - mapSize << " dropped), radix " << std::setw(8) << radixTime << " ms (x"
+				<< mapTime / radixTime << ")" << (backToFront ? "" : ", OUT OF ORDER") << std::endl;
+		}
+	}
+
+	// a game object as scenes kept them before the entity registry: every component inline or behind a pointer,
+	// one unordered_map entry per object
+	struct MapGameObject
+	{
+		glm::vec3 color{};
+		lve::TransformComponent transform{};
+		lve::RigidBody2dComponent rigidBody2d{};
+		std::shared_ptr<lve::LveModel> model{};
+		std::unique_ptr<lve::PointLightComponent> pointLight = nullptr;
+	};
+
+	// the queries of PointLightSystem and SimpleRenderSystem over a scene where every object has a transform, half
+	// of them a model and one in 16 a light: the map walks every object for each, the registry only the smallest
+	// pool of the query. Lookup finds the transform of random objects by id or handle.
+	void benchEntities()
+	{
+		constexpr int FRAMES = 10;
+		constexpr int LOOKUPS = 100000;
+
+		for (int entityCount : { 10000, 100000, 1000000 })
+		{
+			std::mt19937 rng{ 13 };
+			std::vector<uint32_t> lookups(LOOKUPS);
+			for (uint32_t& lookup : lookups) {
+				lookup = rng() % entityCount;
+			}
+
+			// models are only compared against null here, any non-null pointer will do
+			auto model = std::shared_ptr<lve::LveModel>(reinterpret_cast<lve::LveModel*>(alignof(lve::LveModel)), [](lve::LveModel*) {});
+
+			glm::vec3 mapLightSum{ 0.0f };
+			glm::vec3 mapModelSum{ 0.0f };
+			float mapLightTime;
+			float mapModelTime;
+			float mapLookupTime;
+			{
+				std::unordered_map<uint32_t, MapGameObject> objects;
+				for (int i = 0; i < entityCount; i++)
+				{
+					MapGameObject& obj = objects[i];
+					obj.transform.translation = glm::vec3{ static_cast<float>(i % 100) };
+					if (i % 2 == 0) {
+						obj.model = model;
+					}
+					if (i % 16 == 0) {
+						obj.pointLight = std::make_unique<lve::PointLightComponent>();
+					}
+				}
+
+				mapLightTime = timeBest(FRAMES, [&] {
+					mapLightSum = glm::vec3{ 0.0f };
+					for (auto& kv : objects)
+					{
+						auto& obj = kv.second;
+						if (obj.pointLight == nullptr) continue;
+						mapLightSum += obj.transform.translation * obj.pointLight->lightIntensity;
+					}
+				});
+				mapModelTime = timeBest(FRAMES, [&] {
+					mapModelSum = glm::vec3{ 0.0f };
+					for (auto& kv : objects)
+					{
+						auto& obj = kv.second;
+						if (obj.model == nullptr) continue;
+						mapModelSum += obj.transform.translation + obj.color;
+					}
+				});
+				mapLookupTime = timeBest(FRAMES, [&] {
+					for (uint32_t id : lookups) {
+						objects.find(id)->second.transform.translation.y += 1.0f;
+					}
+				});
+			}
+
+			glm::vec3 registryLightSum{ 0.0f };
+			glm::vec3 registryModelSum{ 0.0f };
+			float registryLightTime;
+			float registryModelTime;
+			float registryLookupTime;
+			{
+				lve::LveEntityRegistry registry{};
+				std::vector<lve::LveEntity> entities(entityCount);
+				for (int i = 0; i < entityCount; i++)
+				{
+					lve::LveEntity entity = entities[i] = registry.create();
+					registry.add<lve::TransformComponent>(entity).translation = glm::vec3{ static_cast<float>(i % 100) };
+					if (i % 2 == 0) {
+						registry.add<lve::ModelComponent>(entity, model);
+					}
+					if (i % 16 == 0) {
+						registry.add<lve::PointLightComponent>(entity);
+					}
+				}
+
+				registryLightTime = timeBest(FRAMES, [&] {
+					registryLightSum = glm::vec3{ 0.0f };
+					registry.each<lve::PointLightComponent, lve::TransformComponent>(
+						[&](lve::LveEntity, lve::PointLightComponent& pointLight, lve::TransformComponent& transform) {
+							registryLightSum += transform.translation * pointLight.lightIntensity;
+						});
+				});
+				registryModelTime = timeBest(FRAMES, [&] {
+					registryModelSum = glm::vec3{ 0.0f };
+					registry.each<lve::ModelComponent, lve::TransformComponent>(
+						[&](lve::LveEntity, lve::ModelComponent& model, lve::TransformComponent& transform) {
+							registryModelSum += transform.translation + model.color;
+						});
+				});
+				registryLookupTime = timeBest(FRAMES, [&] {
+					for (uint32_t index : lookups) {
+						registry.get<lve::TransformComponent>(entities[index]).translation.y += 1.0f;
+					}
+				});
+			}
+
+			// sums are in a different order, so they only match closely
+			bool matching = glm::length(mapLightSum - registryLightSum) <= 1e-3f * glm::length(mapLightSum)
+				&& glm::length(mapModelSum - registryModelSum) <= 1e-3f * glm::length(mapModelSum);
+
+			std::cout << "  " << std::setw(7) << entityCount << " entities:" << (matching ? "" : " RESULT MISMATCH") << std::endl;
+			std::cout << "    lights: map " << std::setw(8) << mapLightTime << " ms, registry " << std::setw(8)
+				<< registryLightTime << " ms (x" << mapLightTime / registryLightTime << ")" << std::endl;
+			std::cout << "    models: map " << std::setw(8) << mapModelTime << " ms, registry " << std::setw(8)
+				<< registryModelTime << " ms (x" << mapModelTime / registryModelTime << ")" << std::endl;
+			std::cout << "    lookup: map " << std::setw(8) << mapLookupTime << " ms, registry " << std::setw(8)
+				<< registryLookupTime << " ms (x" << mapLookupTime / registryLookupTime << ")" << std::endl;
+		}
+	}
+
+	// a hierarchy of 1000 roots with 10 children of 10 children each. Moving one child has to recompute only its
+	// branch, leave every other world matrix as it was, and match the matrices composed from scratch along each
+	// node's parent chain. Times that update, one after every root moved and the flat recompute.
+	void benchSceneGraph()
+	{
+		constexpr int FRAMES = 20;
+		constexpr uint32_t ROOT_COUNT = 1000;
+		constexpr uint32_t FANOUT = 10;
+
+		lve::LveEntityRegistry registry{};
+		lve::LveSceneGraph sceneGraph{ registry };
+		std::mt19937 rng{ 23 };
+		std::uniform_real_distribution<float> offset{ -1.0f, 1.0f };
+
+		// every node in creation order, and the children of the roots
+		std::vector<lve::LveEntity> nodes;
+		std::vector<lve::LveEntity> roots;
+		std::vector<lve::LveEntity> branches;
+		auto createNode = [&](lve::LveEntity parent) {
+			lve::LveEntity entity = registry.create();
+			lve::TransformComponent& transform = registry.add<lve::TransformComponent>(entity);
+			transform.translation = { offset(rng), offset(rng), offset(rng) };
+			transform.rotation = { offset(rng), offset(rng), offset(rng) };
+			transform.scale = glm::vec3{ 1.0f + 0.1f * offset(rng) };
+			sceneGraph.attach(entity, parent);
+			nodes.push_back(entity);
+			return entity;
+		};
+		for (uint32_t r = 0; r < ROOT_COUNT; r++)
+		{
+			lve::LveEntity root = createNode(lve::LveEntity{});
+			roots.push_back(root);
+			for (uint32_t b = 0; b < FANOUT; b++)
+			{
+				lve::LveEntity branch = createNode(root);
+				branches.push_back(branch);
+				for (uint32_t leaf = 0; leaf < FANOUT; leaf++) {
+					createNode(branch);
+				}
+			}
+		}
+
+		// the first update lays out the nodes and computes every matrix
+		float firstTime = timeBest(1, [&] { sceneGraph.update(); });
+
+		// each node's chain multiplied from its root down, in the same order as the graph does
+		std::vector<glm::mat4> flatMatrices(nodes.size());
+		std::vector<lve::LveEntity> chain;
+		auto flatRecompute = [&] {
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				chain.clear();
+				for (lve::LveEntity entity = nodes[i]; !entity.isNull(); entity = sceneGraph.getParent(entity)) {
+					chain.push_back(entity);
+				}
+				glm::mat4 matrix = registry.get<lve::TransformComponent>(chain.back()).mat4();
+				for (size_t j = chain.size() - 1; j-- > 0;) {
+					matrix = matrix * registry.get<lve::TransformComponent>(chain[j]).mat4();
+				}
+				flatMatrices[i] = matrix;
+			}
+		};
+
+		std::vector<glm::mat4> before(nodes.size());
+		for (size_t i = 0; i < nodes.size(); i++) {
+			before[i] = registry.get<lve::WorldTransformComponent>(nodes[i]).matrix;
+		}
+
+		lve::LveEntity moved = branches[branches.size() / 2];
+		registry.get<lve::TransformComponent>(moved).translation.y += 0.5f;
+		sceneGraph.update();
+		uint32_t recomputed = sceneGraph.getUpdatedCount();
+		flatRecompute();
+
+		uint32_t changedInBranch = 0;
+		uint32_t changedElsewhere = 0;
+		float maxError = 0.0f;
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const glm::mat4& world = registry.get<lve::WorldTransformComponent>(nodes[i]).matrix;
+			bool inBranch = nodes[i] == moved || sceneGraph.getParent(nodes[i]) == moved;
+			if (world != before[i]) {
+				(inBranch ? changedInBranch : changedElsewhere)++;
+			}
+			for (int column = 0; column < 4; column++) {
+				maxError = std::max(maxError, glm::length(world[column] - flatMatrices[i][column]));
+			}
+		}
+		bool branchOnly = recomputed == FANOUT + 1 && changedInBranch == FANOUT + 1 && changedElsewhere == 0;
+
+		lve::TransformComponent& movedTransform = registry.get<lve::TransformComponent>(moved);
+		float branchTime = timeBest(FRAMES, [&] {
+			movedTransform.translation.y += 0.001f;
+			sceneGraph.update();
+		});
+		float allRootsTime = timeBest(FRAMES, [&] {
+			for (lve::LveEntity root : roots) {
+				registry.get<lve::TransformComponent>(root).translation.y += 0.001f;
+			}
+			sceneGraph.update();
+		});
+		float flatTime = timeBest(FRAMES, flatRecompute);
+
+		std::cout << "  " << nodes.size() << " nodes: first update " << std::setw(8) << firstTime << " ms, flat recompute "
+			<< std::setw(8) << flatTime << " ms, every root moved " << std::setw(8) << allRootsTime << " ms" << std::endl;
+		std::cout << "  one branch moved " << std::setw(8) << branchTime << " ms, " << recomputed << " recomputed, "
+			<< changedInBranch << " changed in the branch and " << changedElsewhere << " elsewhere"
+			<< (branchOnly ? "" : ", NOT ONLY THE BRANCH") << ", max difference to flat " << maxError
+			<< (maxError <= 1e-5f ? "" : ", RESULT MISMATCH") << std::endl;
+	}
+
+	// scene queries over 100k objects in a wide, flat world: the BVH, with the exact test callers run on its
+	// results, against testing every object. Also times building the tree and a frame moving a tenth of the objects.
+	void benchBvh()
+	{
+		constexpr int FRAMES = 10;
+		constexpr int OBJECT_COUNT = 100000;
+		constexpr int QUERY_COUNT = 1000;
+
+		std::mt19937 rng{ 17 };
+		std::uniform_real_distribution<float> horizontal{ -500.0f, 500.0f };
+		std::uniform_real_distribution<float> vertical{ -50.0f, 50.0f };
+		std::uniform_real_distribution<float> size{ 0.5f, 3.0f };
+		std::uniform_real_distribution<float> step{ -1.0f, 1.0f };
+
+		std::vector<glm::vec3> centers(OBJECT_COUNT);
+		std::vector<float> radii(OBJECT_COUNT);
+		std::vector<lve::LveAabb> bounds(OBJECT_COUNT);
+		for (int i = 0; i < OBJECT_COUNT; i++)
+		{
+			centers[i] = { horizontal(rng), vertical(rng), horizontal(rng) };
+			radii[i] = size(rng);
+			bounds[i] = lve::LveAabb::fromSphere(centers[i], radii[i]);
+		}
+
+		lve::LveBvh bvh{ 0.5f };
+		std::vector<uint32_t> proxies(OBJECT_COUNT);
+		float buildTime = timeBest(1, [&] {
+			for (int i = 0; i < OBJECT_COUNT; i++) {
+				proxies[i] = bvh.insert(bounds[i], i);
+			}
+		});
+
+		uint32_t reinserted = 0;
+		float moveTime = timeBest(FRAMES, [&] {
+			reinserted = 0;
+			for (int i = 0; i < OBJECT_COUNT; i += 10)
+			{
+				centers[i] += glm::vec3{ step(rng), 0.0f, step(rng) };
+				bounds[i] = lve::LveAabb::fromSphere(centers[i], radii[i]);
+				reinserted += bvh.move(proxies[i], bounds[i]) ? 1 : 0;
+			}
+		});
+		std::cout << "  " << OBJECT_COUNT << " objects: build " << std::setw(8) << buildTime << " ms, height "
+			<< bvh.getHeight() << ", moving a tenth " << std::setw(8) << moveTime << " ms (" << reinserted
+			<< " reinserted)" << std::endl;
+
+		std::vector<lve::LveAabb> boxes(QUERY_COUNT);
+		std::vector<glm::vec4> spheres(QUERY_COUNT);
+		std::vector<std::pair<glm::vec3, glm::vec3>> rays(QUERY_COUNT);
+		for (int i = 0; i < QUERY_COUNT; i++)
+		{
+			glm::vec3 center{ horizontal(rng), vertical(rng), horizontal(rng) };
+			boxes[i] = lve::LveAabb::fromSphere(center, 10.0f);
+			spheres[i] = glm::vec4{ center, 10.0f };
+			rays[i] = { center, glm::normalize(glm::vec3{ step(rng), step(rng) * 0.1f, step(rng) }) };
+		}
+		constexpr float RAY_LENGTH = 200.0f;
+		glm::mat4 projection = glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3{ 0.0f, 5.0f, 0.0f }, glm::vec3{ 1.0f, 0.0f, 1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		lve::LveFrustum frustum = lve::LveFrustum::fromMatrix(projection * view);
+
+		auto inFrustum = [&](const lve::LveAabb& box) {
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				glm::vec3 normal{ plane };
+				glm::vec3 positive = glm::mix(box.min, box.max, glm::greaterThanEqual(normal, glm::vec3{ 0.0f }));
+				if (glm::dot(normal, positive) + plane.w < 0.0f) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// runs a query kind both ways, counting hits that pass the exact test
+		auto compare = [&](const char* name, int queryCount,
+			const std::function<void(int, std::vector<uint32_t>&)>& treeQuery,
+			const std::function<bool(int, const lve::LveAabb&)>& exactTest) {
+			std::vector<uint32_t> candidates;
+			size_t treeHits = 0;
+			float treeTime = timeBest(FRAMES, [&] {
+				treeHits = 0;
+				for (int q = 0; q < queryCount; q++)
+				{
+					candidates.clear();
+					treeQuery(q, candidates);
+					for (uint32_t object : candidates) {
+						treeHits += exactTest(q, bounds[object]) ? 1 : 0;
+					}
+				}
+			});
+
+			size_t bruteHits = 0;
+			float bruteTime = timeBest(FRAMES, [&] {
+				bruteHits = 0;
+				for (int q = 0; q < queryCount; q++)
+				{
+					for (const lve::LveAabb& box : bounds) {
+						bruteHits += exactTest(q, box) ? 1 : 0;
+					}
+				}
+			});
+
+			std::cout << "  " << std::setw(4) << queryCount << " " << std::left << std::setw(8) << name << std::right
+				<< " brute force " << std::setw(8) << bruteTime << " ms, bvh " << std::setw(8) << treeTime << " ms (x"
+				<< bruteTime / treeTime << "), " << bruteHits << " hits" << (treeHits == bruteHits ? "" : " RESULT MISMATCH")
+				<< std::endl;
+		};
+
+		compare("aabb", QUERY_COUNT,
+			[&](int q, std::vector<uint32_t>& results) { bvh.queryAabb(boxes[q], results); },
+			[&](int q, const lve::LveAabb& box) { return boxes[q].intersects(box); });
+		compare("sphere", QUERY_COUNT,
+			[&](int q, std::vector<uint32_t>& results) { bvh.querySphere(glm::vec3{ spheres[q] }, spheres[q].w, results); },
+			[&](int q, const lve::LveAabb& box) { return box.intersectsSphere(glm::vec3{ spheres[q] }, spheres[q].w); });
+		compare("ray", QUERY_COUNT,
+			[&](int q, std::vector<uint32_t>& results) { bvh.queryRay(rays[q].first, rays[q].second, RAY_LENGTH, results); },
+			[&](int q, const lve::LveAabb& box) { return box.intersectsRay(rays[q].first, 1.0f / rays[q].second, RAY_LENGTH); });
+		compare("frustum", 1,
+			[&](int, std::vector<uint32_t>& results) { bvh.queryFrustum(frustum, results); },
+			[&](int, const lve::LveAabb& box) { return inFrustum(box); });
+	}
+
+	// a frame of FirstApp's shape: camera control on the main thread, a serial light update writing transforms, a
+	// parallel world matrix update reading them and an independent animation system, run one after another against
+	// the task graph, which overlaps the systems not sharing data. Prints the graph's task timings of the last run.
+	void benchTaskGraph()
+	{
+		constexpr int FRAMES = 50;
+		constexpr uint32_t LIGHT_COUNT = 50000;
+		constexpr uint32_t OBJECT_COUNT = 200000;
+		constexpr uint32_t ANIMATED_COUNT = 50000;
+
+		std::vector<glm::vec3> lights(LIGHT_COUNT, glm::vec3{ 1.0f, 0.0f, 0.0f });
+		std::vector<glm::vec3> translations(OBJECT_COUNT, glm::vec3{ 0.0f });
+		std::vector<glm::mat4> worlds(OBJECT_COUNT);
+		std::vector<glm::vec3> rotations(ANIMATED_COUNT, glm::vec3{ 0.0f });
+		glm::mat4 camera{ 1.0f };
+		float time = 0.0f;
+
+		auto cameraControl = [&] {
+			for (int i = 0; i < 20000; i++) {
+				camera = glm::rotate(camera, 0.0001f, glm::vec3{ 0.0f, 1.0f, 0.0f });
+			}
+		};
+		auto updateLights = [&] {
+			glm::mat4 rotateLight = glm::rotate(glm::mat4{ 1.0f }, 0.01f, glm::vec3{ 0.0f, -1.0f, 0.0f });
+			for (uint32_t i = 0; i < LIGHT_COUNT; i++)
+			{
+				lights[i] = glm::vec3(rotateLight * glm::vec4(lights[i], 1.0f));
+				translations[i] = lights[i];
+			}
+		};
+		auto updateWorlds = [&] {
+			lve::LveThreadPool::shared().parallelFor(OBJECT_COUNT, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					worlds[i] = glm::translate(glm::mat4{ 1.0f }, translations[i]);
+				}
+			}, 1024);
+		};
+		auto animate = [&] {
+			time += 0.016f;
+			for (uint32_t i = 0; i < ANIMATED_COUNT; i++) {
+				rotations[i] = glm::vec3{ glm::sin(time + i), glm::cos(time + i), 0.0f };
+			}
+		};
+
+		float serialTime = timeBest(FRAMES, [&] {
+			cameraControl();
+			updateLights();
+			updateWorlds();
+			animate();
+		});
+		glm::mat4 serialWorld = worlds[LIGHT_COUNT - 1];
+
+		std::fill(lights.begin(), lights.end(), glm::vec3{ 1.0f, 0.0f, 0.0f });
+		lve::LveTaskGraph graph{};
+		graph.addMainThreadTask("camera control", cameraControl, {}, { &camera });
+		graph.addTask("lights", updateLights, {}, { &lights, &translations });
+		graph.addTask("world matrices", updateWorlds, { &translations }, { &worlds });
+		graph.addTask("animation", animate, {}, { &rotations, &time });
+		float graphTime = timeBest(FRAMES, [&] { graph.run(); });
+		bool identical = worlds[LIGHT_COUNT - 1] == serialWorld;
+
+		std::cout << "  " << lve::LveThreadPool::shared().getThreadCount() << " threads: one after another "
+			<< std::setw(8) << serialTime << " ms, task graph " << std::setw(8) << graphTime << " ms (x"
+			<< serialTime / graphTime << ")" << (identical ? "" : ", RESULT MISMATCH") << std::endl;
+
+		graph.setTimingCallback([](const lve::LveTaskGraph::TaskTiming& timing) {
+			std::cout << "    " << std::left << std::setw(16) << *timing.name << std::right << " thread "
+				<< std::setw(2) << timing.threadIndex << ", start " << std::setw(8) << timing.start << " ms, took "
+				<< std::setw(8) << timing.duration << " ms" << std::endl;
+		});
+		graph.run();
+	}
+
+	// creates FirstApp's pipelines on a new device twice, first without a pipeline cache file and then with the one
+	// the first device saved when it was destroyed
+	void benchPipelineCache()
+	{
+		std::filesystem::remove(std::string{ ENGINE_DIR } + "pipeline_cache.bin");
+
+		for (const char* run : { "cache deleted", "cache present" })
+		{
+			lve::LveWindow window{ 640, 360, "lve_bench" };
+			lve::LveDevice device{ window };
+			lve::LveRenderer renderer{ window, device };
+
+			std::unique_ptr<lve::LveDescriptorSetLayout> globalSetLayout =
+				lve::LveDescriptorSetLayout::Builder(device)
+				.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+				.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+				.build();
+
+			float time = timeBest(1, [&] {
+				lve::SimpleRenderSystem simpleRenderSystem{
+					device,
+					renderer.getSwapChainRenderPass(),
+					globalSetLayout->getDescriptorSetLayout() };
+				lve::PointLightSystem pointLightSystem{
+					device,
+					renderer.getSwapChainRenderPass(),
+					renderer.getLightingSubpass(),
+					globalSetLayout->getDescriptorSetLayout() };
+				device.pipelines().waitIdle();
+			});
+
+			std::cout << "  " << std::left << std::setw(14) << run << std::right << std::setw(8) << time << " ms, "
+				<< (device.pipelineCache().isWarm() ? "warm" : "cold") << " cache, "
+				<< device.pipelines().getCompileCount() << " compiled, "
+				<< device.pipelines().getReuseCount() << " reused" << std::endl;
+		}
+	}
+
+	const std::vector<std::pair<std::string, std::function<void()>>> benchmarks{
+		{ "obj_load", benchObjLoad },
+		{ "range_allocator", benchRangeAllocator },
+		{ "instancing", benchInstancing },
+		{ "transforms", benchTransforms },
+		{ "transform_batch", benchTransformBatch },
+		{ "light_sort", benchLightSort },
+		{ "entities", benchEntities },
+		{ "scene_graph", benchSceneGraph },
+		{ "bvh", benchBvh },
+		{ "task_graph", benchTaskGraph },
+		{ "pipeline_cache", benchPipelineCache },
+	};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	try {
+		for (const auto& benchmark : benchmarks)
+		{
+			bool selected = argc < 2;
+			for (int i = 1; i < argc; i++) {
+				selected = selected || benchmark.first == argv[i];
+			}
+			if (!selected) continue;
+
+			std::cout << "== " << benchmark.first << std::endl;
+			benchmark.second();
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#include "lve_mesh_optimizer.hpp"
+#include "lve_model.hpp"
+
+// std
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+
+// Offline converter from .obj to the binary .lvemesh cache format loaded by LveModel::Builder
+//
+// usage: lvemesh_converter <input.obj> [output.lvemesh]
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::cerr << "usage: " << argv[0] << " <input.obj> [output.lvemesh]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string inputPath = argv[1];
+	std::string outputPath = argc == 3 ? argv[2] : lve::LveModel::Builder::meshCachePath(inputPath);
+
+	try {
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		lve::LveModel::Builder builder{};
+		builder.loadObjFile(inputPath);
+		lve::LveVertexCacheStats before = lve::analyzeVertexCache(builder.indices, builder.vertices.size());
+		builder.optimize();
+		lve::LveVertexCacheStats after = lve::analyzeVertexCache(builder.indices, builder.vertices.size());
+		builder.generateLods();
+		builder.writeMeshCache(outputPath);
+
+		float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+
+		std::cout << inputPath << " -> " << outputPath << ": "
+			<< builder.vertexCount() << " vertices, "
+			<< builder.indexCount() << " indices in "
+			<< builder.lods.size() << " LODs ("
+			<< milliseconds << " ms)" << std::endl;
+		std::cout << "ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}